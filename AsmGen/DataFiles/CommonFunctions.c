@@ -50,6 +50,16 @@ void printResultFloatArr(float* arr, uint32_t *xCounts, uint32_t xLen, uint32_t
     }
 }
 
+// splitmix64, so patterns aren't limited by RAND_MAX
+uint64_t patternRngState = 1;
+uint64_t PatternRngNext() {
+    uint64_t z = (patternRngState += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Sattolo's algorithm, with unbiased j in [0, iter)
 void FillPatternArr(uint32_t* pattern_arr, uint32_t list_size, uint32_t byte_increment) {
     uint32_t increment = byte_increment / sizeof(uint32_t);
     uint32_t element_count = list_size / increment;
@@ -57,10 +67,12 @@ void FillPatternArr(uint32_t* pattern_arr, uint32_t list_size, uint32_t byte_inc
         pattern_arr[i * increment] = i * increment;
     }
 
-    int iter = element_count;
+    uint32_t iter = element_count;
     while (iter > 1) {
         iter -= 1;
-        int j = iter - 1 == 0 ? 0 : rand() % (iter - 1);
+        uint64_t threshold = (0 - (uint64_t)iter) % iter, r;
+        do r = PatternRngNext(); while (r < threshold);
+        uint32_t j = r % iter;
         uint32_t tmp = pattern_arr[iter * increment];
         pattern_arr[iter * increment] = pattern_arr[j * increment];
         pattern_arr[j * increment] = tmp;
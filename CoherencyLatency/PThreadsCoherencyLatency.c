@@ -12,6 +12,10 @@
 #include <sched.h>
 #include <pthread.h>
 
+#include "../Common/timing.h"
+#include "../Common/results.h"
+#include "../Common/topology.h"
+
 #define ITERATIONS 10000000;
 
 // kidding right?
@@ -43,6 +47,12 @@ int main(int argc, char *argv[]) {
     int numProcs, offsets = 1, parallelismFactor = 1;
     uint64_t iter = ITERATIONS;
     uint64_t *bouncyArr;
+    int timingBackend = TIMING_AUTO;
+    int outputFormat = RESULTS_FORMAT_DEFAULT;
+    const char *testName = "lock";
+    int pairMode = TOPOLOGY_PAIRS_ALL;
+    struct cpu_topology topo;
+    char *selectedPairs;
 
     numProcs = get_nprocs();
     fprintf(stderr, "Number of CPUs: %u\n", numProcs);
@@ -58,6 +68,7 @@ int main(int argc, char *argv[]) {
             else if (strncmp(arg, "nolock", 6) == 0) {
                 fprintf(stderr, "No locks, plain loads and stores\n");
                 testFunc = NoLockLatencyTestThread;
+                testName = "nolock";
             }
             else if (strncmp(arg, "offset", 6) == 0) {
                 argIdx++;
@@ -69,9 +80,39 @@ int main(int argc, char *argv[]) {
                 parallelismFactor = atoi(argv[argIdx]);
                 fprintf(stderr, "Will go for %d runs in parallel\n", parallelismFactor);
             }
+            else if (strncmp(arg, "timer", 5) == 0) {
+                argIdx++;
+                timingBackend = timing_parse_backend(argv[argIdx]);
+            }
+            else if (strncmp(arg, "format", 6) == 0) {
+                argIdx++;
+                outputFormat = results_parse_format(argv[argIdx]);
+            }
+            else if (strncmp(arg, "pairs", 5) == 0) {
+                argIdx++;
+                pairMode = topology_parse_pairs(argv[argIdx]);
+                if (pairMode == TOPOLOGY_INVALID) return 0;
+            }
+            else if (strncmp(arg, "topology", 8) == 0) {
+                topology_init(&topo);
+                topology_print(&topo);
+                topology_free(&topo);
+                return 0;
+            }
         }
     }
 
+    timing_init(timingBackend);
+    results_init("CoherencyLatency", outputFormat, timing_backend_name());
+
+    // topology is indexed by configured cpus, which can exceed get_nprocs() with offline cpus
+    topology_init(&topo);
+    if (topo.cpuCount > numProcs) numProcs = topo.cpuCount;
+    selectedPairs = (char *)malloc(numProcs * numProcs);
+    memset(selectedPairs, 0, numProcs * numProcs);
+    int selectedPairCount = topology_select_pairs(&topo, pairMode, selectedPairs);
+    if (pairMode != TOPOLOGY_PAIRS_ALL) fprintf(stderr, "Testing %d of %d core pairs\n", selectedPairCount, numProcs * (numProcs - 1));
+
     latencies = (float **)malloc(sizeof(float *) * offsets);
     parallelTestState = (int *)malloc(sizeof(int) * numProcs * numProcs);
     memset(latencies, 0, sizeof(float) * offsets);
@@ -87,6 +128,14 @@ int main(int argc, char *argv[]) {
         memset(parallelTestState, 0, sizeof(int) * numProcs * numProcs);
         float *latenciesPtr = latencies[offsetIdx];
 
+        // pairs left out by topology selection are marked done, with a negative latency so output can skip them
+        for (int pairIdx = 0; pairIdx < numProcs * numProcs; pairIdx++) {
+            if (!selectedPairs[pairIdx]) {
+                parallelTestState[pairIdx] = 2;
+                latenciesPtr[pairIdx] = -1.0f;
+            }
+        }
+
         while (1) {
             // select parallelismFactor threads
             int selectedParallelTestCount = 0;
@@ -152,11 +201,32 @@ int main(int argc, char *argv[]) {
 
       for (int offsetIdx = 0; offsetIdx < offsets; offsetIdx++) {
         float *latenciesPtr = latencies[offsetIdx];
+        if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+            // one record per ordered pair, cpus = "from,to"
+            for (int i = 0; i < numProcs; i++) {
+                for (int j = 0; j < numProcs; j++) {
+                    if (i == j || !selectedPairs[j + i * numProcs]) continue;
+                    char cpuPair[32];
+                    struct result_record record;
+                    snprintf(cpuPair, sizeof(cpuPair), "%d,%d", i, j);
+                    results_new_record(&record, testName, "latency_ns", latenciesPtr[j + i * numProcs] / 2);
+                    record.threads = 2;
+                    record.cpus = cpuPair;
+                    results_add_param(&record, "offset", offsetIdx);
+                    results_emit(&record);
+                }
+            }
+
+            free(latenciesPtr);
+            continue;
+        }
+
         printf("Cache line offset: %d\n", offsetIdx);
         for (int i = 0;i < numProcs; i++) {
             for (int j = 0;j < numProcs; j++) {
                 if (j != 0) printf(",");
                 if (j == i) printf("x");
+                else if (!selectedPairs[j + i * numProcs]) continue;
                 // to maintain consistency, divide by 2 (see justification in windows version)
                 else printf("%f", latenciesPtr[j + i * numProcs] / 2);
             }
@@ -167,6 +237,8 @@ int main(int argc, char *argv[]) {
     }
 
     free(parallelTestState);
+    free(selectedPairs);
+    topology_free(&topo);
     free(pairRunData);
     free(latencies);
     free(bouncyArr);
@@ -180,13 +252,12 @@ float TimeThreads(unsigned int proc1,
                   LatencyData *lat1,
                   LatencyData *lat2,
                   void *(*threadFunc)(void *)) {
-    struct timeval startTv, endTv;
-    struct timezone startTz, endTz;
+    uint64_t startTicks;
     pthread_t testThreads[2];
     int t1rc, t2rc;
     void *res1, *res2;
 
-    gettimeofday(&startTv, &startTz);
+    start_timing_ns(&startTicks);
     t1rc = pthread_create(&testThreads[0], NULL, threadFunc, (void *)lat1);
     t2rc = pthread_create(&testThreads[1], NULL, threadFunc, (void *)lat2);
     if (t1rc != 0 || t2rc != 0) {
@@ -196,10 +267,8 @@ float TimeThreads(unsigned int proc1,
 
     pthread_join(testThreads[0], &res1);
     pthread_join(testThreads[1], &res2);
-    gettimeofday(&endTv, &endTz);
-
-    uint64_t time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
-    float latency = 1e6 * (float)time_diff_ms / (float)iter;
+    uint64_t time_diff_ns = end_timing_ns(&startTicks);
+    float latency = (float)time_diff_ns / (float)iter;
     return latency;
 }
 
@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chain.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <pthread.h>
+#define CHAIN_THREADS 1
+#endif
+
+// below this many nodes, building on one thread is faster than starting threads
+#define CHAIN_PARALLEL_THRESHOLD (1ULL << 20)
+#define CHAIN_MAX_THREADS 64
+
+// Rao-Sandelius shuffle: scatter nodes into random buckets, then Fisher-Yates each bucket.
+// Block and bucket counts only depend on node count, which keeps output independent of thread count
+#define CHAIN_TARGET_BLOCK_SIZE (1ULL << 16)
+#define CHAIN_MAX_BLOCKS 256
+#define CHAIN_MAX_BUCKETS 4096
+#define CHAIN_PREFETCH_DISTANCE 16
+
+static uint64_t chain_seed = 1;
+static uint64_t chain_fill_count = 0;
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(const uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+void chain_rng_seed(struct chain_rng *rng, uint64_t seed, uint64_t stream) {
+    uint64_t state = seed ^ splitmix64(&stream);
+    for (int i = 0; i < 4; i++) rng->s[i] = splitmix64(&state);
+}
+
+uint64_t chain_rng_next(struct chain_rng *rng) {
+    uint64_t *s = rng->s;
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// unbiased integer in [0, bound), Lemire's multiply and reject
+uint64_t chain_rng_bounded(struct chain_rng *rng, uint64_t bound) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t m = (__uint128_t)chain_rng_next(rng) * bound;
+    uint64_t low = (uint64_t)m;
+    if (low < bound) {
+        uint64_t threshold = (0 - bound) % bound;
+        while (low < threshold) {
+            m = (__uint128_t)chain_rng_next(rng) * bound;
+            low = (uint64_t)m;
+        }
+    }
+
+    return (uint64_t)(m >> 64);
+#else
+    uint64_t threshold = (0 - bound) % bound, r;
+    do r = chain_rng_next(rng); while (r < threshold);
+    return r % bound;
+#endif
+}
+
+void chain_set_seed(uint64_t seed) {
+    chain_seed = seed;
+    chain_fill_count = 0;
+}
+
+struct chain_order_ctx {
+    uint64_t *order;
+    uint64_t count;
+    uint64_t seed;
+    uint64_t blockCount, blockSize, bucketCount;
+    uint64_t *bucketPos; // blockCount * bucketCount
+    uint64_t *bucketStart; // bucketCount + 1
+};
+
+typedef void (*chain_task_func)(void *ctx, uint64_t task);
+
+struct chain_parallel_ctx {
+    chain_task_func func;
+    void *ctx;
+    uint64_t taskCount;
+    volatile uint64_t nextTask;
+};
+
+#ifdef CHAIN_THREADS
+static void *chain_parallel_worker(void *param) {
+    struct chain_parallel_ctx *parallelCtx = (struct chain_parallel_ctx *)param;
+    uint64_t task;
+    while ((task = __sync_fetch_and_add(&parallelCtx->nextTask, 1)) < parallelCtx->taskCount)
+        parallelCtx->func(parallelCtx->ctx, task);
+    return NULL;
+}
+#endif
+
+// runs func over [0, taskCount) on up to one thread per online cpu, in no particular order
+static void chain_parallel(chain_task_func func, void *ctx, uint64_t taskCount, uint64_t nodeCount) {
+    struct chain_parallel_ctx parallelCtx = { func, ctx, taskCount, 0 };
+#ifdef CHAIN_THREADS
+    long threadCount = nodeCount < CHAIN_PARALLEL_THRESHOLD ? 1 : sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadCount > CHAIN_MAX_THREADS) threadCount = CHAIN_MAX_THREADS;
+    if (threadCount > (long)taskCount) threadCount = taskCount;
+    if (threadCount > 1) {
+        pthread_t threads[CHAIN_MAX_THREADS];
+        int created = 0;
+        for (long i = 1; i < threadCount; i++) {
+            if (pthread_create(threads + created, NULL, chain_parallel_worker, &parallelCtx) == 0) created++;
+        }
+
+        chain_parallel_worker(&parallelCtx);
+        for (int i = 0; i < created; i++) pthread_join(threads[i], NULL);
+        return;
+    }
+#endif
+    for (uint64_t task = 0; task < taskCount; task++) func(ctx, task);
+}
+
+static void chain_count_block(void *param, uint64_t block) {
+    struct chain_order_ctx *ctx = (struct chain_order_ctx *)param;
+    struct chain_rng rng;
+    uint64_t *counts = ctx->bucketPos + block * ctx->bucketCount;
+    uint64_t end = (block + 1) * ctx->blockSize;
+    if (end > ctx->count) end = ctx->count;
+    chain_rng_seed(&rng, ctx->seed, block);
+    for (uint64_t i = block * ctx->blockSize; i < end; i++) counts[chain_rng_bounded(&rng, ctx->bucketCount)]++;
+}
+
+// replays the same draws as chain_count_block, this time placing each node
+static void chain_scatter_block(void *param, uint64_t block) {
+    struct chain_order_ctx *ctx = (struct chain_order_ctx *)param;
+    struct chain_rng rng;
+    uint64_t *pos = ctx->bucketPos + block * ctx->bucketCount;
+    uint64_t end = (block + 1) * ctx->blockSize;
+    if (end > ctx->count) end = ctx->count;
+    chain_rng_seed(&rng, ctx->seed, block);
+    for (uint64_t i = block * ctx->blockSize; i < end; i++) ctx->order[pos[chain_rng_bounded(&rng, ctx->bucketCount)]++] = i;
+}
+
+static void chain_shuffle_bucket(void *param, uint64_t bucket) {
+    struct chain_order_ctx *ctx = (struct chain_order_ctx *)param;
+    struct chain_rng rng;
+    uint64_t *bucketOrder = ctx->order + ctx->bucketStart[bucket];
+    uint64_t bucketSize = ctx->bucketStart[bucket + 1] - ctx->bucketStart[bucket];
+    chain_rng_seed(&rng, ctx->seed, ctx->blockCount + bucket);
+    for (uint64_t i = bucketSize; i > 1; i--) {
+        uint64_t j = chain_rng_bounded(&rng, i);
+        uint64_t tmp = bucketOrder[i - 1];
+        bucketOrder[i - 1] = bucketOrder[j];
+        bucketOrder[j] = tmp;
+    }
+}
+
+int chain_random_order(uint64_t *order, uint64_t count, uint64_t seed) {
+    struct chain_order_ctx ctx;
+    ctx.order = order;
+    ctx.count = count;
+    ctx.seed = seed;
+    ctx.bucketCount = (count + CHAIN_TARGET_BLOCK_SIZE - 1) / CHAIN_TARGET_BLOCK_SIZE;
+    if (ctx.bucketCount > CHAIN_MAX_BUCKETS) ctx.bucketCount = CHAIN_MAX_BUCKETS;
+    if (ctx.bucketCount < 1) ctx.bucketCount = 1;
+    ctx.blockCount = ctx.bucketCount > CHAIN_MAX_BLOCKS ? CHAIN_MAX_BLOCKS : ctx.bucketCount;
+    ctx.blockSize = (count + ctx.blockCount - 1) / ctx.blockCount;
+    ctx.bucketPos = (uint64_t *)calloc(ctx.blockCount * ctx.bucketCount, sizeof(uint64_t));
+    ctx.bucketStart = (uint64_t *)malloc((ctx.bucketCount + 1) * sizeof(uint64_t));
+    if (ctx.bucketPos == NULL || ctx.bucketStart == NULL) {
+        free(ctx.bucketPos);
+        free(ctx.bucketStart);
+        return -1;
+    }
+
+    chain_parallel(chain_count_block, &ctx, ctx.blockCount, count);
+
+    // turn counts into write positions, bucket major so each bucket ends up contiguous
+    uint64_t pos = 0;
+    for (uint64_t bucket = 0; bucket < ctx.bucketCount; bucket++) {
+        ctx.bucketStart[bucket] = pos;
+        for (uint64_t block = 0; block < ctx.blockCount; block++) {
+            uint64_t blockCount = ctx.bucketPos[block * ctx.bucketCount + bucket];
+            ctx.bucketPos[block * ctx.bucketCount + bucket] = pos;
+            pos += blockCount;
+        }
+    }
+
+    ctx.bucketStart[ctx.bucketCount] = pos;
+    chain_parallel(chain_scatter_block, &ctx, ctx.blockCount, count);
+    chain_parallel(chain_shuffle_bucket, &ctx, ctx.bucketCount, count);
+    free(ctx.bucketPos);
+    free(ctx.bucketStart);
+    return 0;
+}
+
+struct chain_link_ctx {
+    uint64_t *order;
+    uint64_t count, stride, offset, chunkSize;
+    void *arr;
+    int wide;
+};
+
+// a random permutation read as a sequence, wrapped around, is a uniformly random single cycle
+static void chain_link_chunk(void *param, uint64_t chunk) {
+    struct chain_link_ctx *ctx = (struct chain_link_ctx *)param;
+    uint64_t end = (chunk + 1) * ctx->chunkSize;
+    if (end > ctx->count) end = ctx->count;
+    for (uint64_t i = chunk * ctx->chunkSize; i < end; i++) {
+        uint64_t current = ctx->order[i] * ctx->stride + ctx->offset;
+#ifdef __GNUC__
+        // targets are known well ahead, so keep plenty of the random writes in flight
+        if (i + CHAIN_PREFETCH_DISTANCE < ctx->count) {
+            uint64_t ahead = ctx->order[i + CHAIN_PREFETCH_DISTANCE] * ctx->stride + ctx->offset;
+            if (ctx->wide) __builtin_prefetch((uint64_t *)ctx->arr + ahead, 1);
+            else __builtin_prefetch((uint32_t *)ctx->arr + ahead, 1);
+        }
+#endif
+        uint64_t next = ctx->order[i + 1 == ctx->count ? 0 : i + 1] * ctx->stride + ctx->offset;
+        if (ctx->wide) ((uint64_t *)ctx->arr)[current] = next;
+        else ((uint32_t *)ctx->arr)[current] = (uint32_t)next;
+    }
+}
+
+// atomic so concurrent callers still get distinct streams. call from one thread if the
+// assignment of streams to callers has to be reproducible
+uint64_t chain_next_seed() {
+    uint64_t seedState = chain_seed + __atomic_fetch_add(&chain_fill_count, 1, __ATOMIC_RELAXED);
+    return splitmix64(&seedState);
+}
+
+static void chain_link(void *arr, int wide, const uint64_t *order, uint64_t count, uint64_t stride, uint64_t offset, int serial) {
+    struct chain_link_ctx ctx;
+    ctx.order = (uint64_t *)order;
+    ctx.count = count;
+    ctx.stride = stride;
+    ctx.offset = offset;
+    ctx.chunkSize = CHAIN_TARGET_BLOCK_SIZE;
+    ctx.arr = arr;
+    ctx.wide = wide;
+    uint64_t chunkCount = (count + ctx.chunkSize - 1) / ctx.chunkSize;
+    if (serial) {
+        for (uint64_t chunk = 0; chunk < chunkCount; chunk++) chain_link_chunk(&ctx, chunk);
+    } else chain_parallel(chain_link_chunk, &ctx, chunkCount, count);
+}
+
+void chain_link32(uint32_t *arr, const uint64_t *order, uint64_t count, uint64_t stride, uint64_t offset) {
+    if (count > 0) chain_link(arr, 0, order, count, stride, offset, 0);
+}
+
+void chain_link64(uint64_t *arr, const uint64_t *order, uint64_t count, uint64_t stride, uint64_t offset) {
+    if (count > 0) chain_link(arr, 1, order, count, stride, offset, 0);
+}
+
+void chain_link64_serial(uint64_t *arr, const uint64_t *order, uint64_t count, uint64_t stride, uint64_t offset) {
+    if (count > 0) chain_link(arr, 1, order, count, stride, offset, 1);
+}
+
+static int chain_fill(void *arr, int wide, uint64_t count, uint64_t stride, uint64_t offset) {
+    if (count == 0) return 0;
+    uint64_t *order = (uint64_t *)malloc(count * sizeof(uint64_t));
+    if (order == NULL || chain_random_order(order, count, chain_next_seed()) != 0) {
+        fprintf(stderr, "Could not allocate scratch memory for %llu node pointer chasing list\n", (unsigned long long)count);
+        free(order);
+        return -1;
+    }
+
+    chain_link(arr, wide, order, count, stride, offset, 0);
+    free(order);
+    return 0;
+}
+
+int chain_fill32(uint32_t *arr, uint64_t count, uint64_t stride, uint64_t offset) {
+    return chain_fill(arr, 0, count, stride, offset);
+}
+
+int chain_fill64(uint64_t *arr, uint64_t count, uint64_t stride, uint64_t offset) {
+    return chain_fill(arr, 1, count, stride, offset);
+}
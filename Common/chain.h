@@ -0,0 +1,41 @@
+#ifndef chainincluded
+#define chainincluded
+#include <stdint.h>
+
+// Pointer chasing list construction. Builds a single random cycle through count nodes,
+// seedable so runs are reproducible, and multithreaded so multi-GB lists don't dominate setup.
+// The cycle only depends on the seed and node count, not on how many threads built it
+
+// xoshiro256**, seeded through splitmix64
+struct chain_rng {
+    uint64_t s[4];
+};
+
+void chain_rng_seed(struct chain_rng *rng, uint64_t seed, uint64_t stream);
+uint64_t chain_rng_next(struct chain_rng *rng);
+uint64_t chain_rng_bounded(struct chain_rng *rng, uint64_t bound);
+
+// Resets the seed. Each fill call after this gets its own stream derived from the seed,
+// so repeated fills (page by page, per GPU wave) don't all produce the same pattern
+void chain_set_seed(uint64_t seed);
+
+// Next stream seed derived from the chain_set_seed seed, for anything else that wants reproducible randomness
+uint64_t chain_next_seed();
+
+// Uniform random permutation of 0..count-1
+int chain_random_order(uint64_t *order, uint64_t count, uint64_t seed);
+
+// Links nodes into a cycle in the given visiting order, laid out like chain_fill32/chain_fill64 below
+void chain_link32(uint32_t *arr, const uint64_t *order, uint64_t count, uint64_t stride, uint64_t offset);
+void chain_link64(uint64_t *arr, const uint64_t *order, uint64_t count, uint64_t stride, uint64_t offset);
+
+// chain_link64 on the calling thread only, for pinned threads building their own array.
+// helper threads would inherit the caller's affinity and just queue up on its core
+void chain_link64_serial(uint64_t *arr, const uint64_t *order, uint64_t count, uint64_t stride, uint64_t offset);
+
+// Links count nodes into one random cycle. Node n lives at arr[n * stride + offset],
+// and holds the index of the next node's slot, (next * stride + offset).
+// returns 0 on success, -1 if scratch memory couldn't be allocated
+int chain_fill32(uint32_t *arr, uint64_t count, uint64_t stride, uint64_t offset);
+int chain_fill64(uint64_t *arr, uint64_t count, uint64_t stride, uint64_t offset);
+#endif
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pages.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#endif
+
+#define PAGES_2M (1ULL << 21)
+#define PAGES_1G (1ULL << 30)
+
+const char *page_policy_names[] = { "default", "4k", "thp", "2m", "1g" };
+
+int pages_parse_policy(const char *name) {
+    for (int policy = 0; policy < PAGES_POLICY_COUNT; policy++) {
+        if (strcmp(name, page_policy_names[policy]) == 0) return policy;
+    }
+
+    fprintf(stderr, "Unrecognized page size policy %s. Valid options: default, 4k, thp, 2m, 1g\n", name);
+    return PAGES_INVALID;
+}
+
+const char *pages_policy_name(int policy) {
+    if (policy < 0 || policy >= PAGES_POLICY_COUNT) return "unknown";
+    return page_policy_names[policy];
+}
+
+static void *pages_aligned_alloc(uint64_t bytes) {
+    void *ptr;
+#ifdef _WIN32
+    ptr = _aligned_malloc(bytes, 64);
+#else
+    if (0 != posix_memalign(&ptr, 64, bytes)) ptr = NULL;
+#endif
+    return ptr;
+}
+
+#ifdef __linux__
+static uint64_t pages_mapped_size(uint64_t bytes, int policy) {
+    uint64_t pageSize = 4096;
+    if (policy == PAGES_THP || policy == PAGES_HUGETLB_2M) pageSize = PAGES_2M;
+    else if (policy == PAGES_HUGETLB_1G) pageSize = PAGES_1G;
+    return (bytes + pageSize - 1) / pageSize * pageSize;
+}
+#endif
+
+void *pages_map(uint64_t bytes, int policy) {
+#ifdef __linux__
+    uint64_t mapped = pages_mapped_size(bytes, policy);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    char *ptr;
+    if (policy == PAGES_HUGETLB_2M) flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+    else if (policy == PAGES_HUGETLB_1G) flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+
+    if (policy == PAGES_THP) {
+        // over-allocate and trim so the range starts on a 2 MB boundary, otherwise the first and last
+        // partial 2 MB regions stay on 4K pages
+        char *base = mmap(NULL, mapped + PAGES_2M, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (base == MAP_FAILED) return NULL;
+        ptr = (char *)(((uintptr_t)base + PAGES_2M - 1) & ~(uintptr_t)(PAGES_2M - 1));
+        if (ptr != base) munmap(base, ptr - base);
+        if (ptr + mapped != base + mapped + PAGES_2M) munmap(ptr + mapped, base + mapped + PAGES_2M - (ptr + mapped));
+        madvise(ptr, mapped, MADV_HUGEPAGE);
+    } else {
+        ptr = mmap(NULL, mapped, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (ptr == MAP_FAILED) {
+            if (policy == PAGES_HUGETLB_2M || policy == PAGES_HUGETLB_1G)
+                fprintf(stderr, "Could not map %llu bytes with %s pages. Are enough hugetlb pages reserved?\n", (unsigned long long)mapped, pages_policy_name(policy));
+            return NULL;
+        }
+
+        if (policy == PAGES_4K) madvise(ptr, mapped, MADV_NOHUGEPAGE);
+    }
+
+    return ptr;
+#else
+    return NULL;
+#endif
+}
+
+void pages_unmap(void *ptr, uint64_t bytes, int policy) {
+#ifdef __linux__
+    if (ptr != NULL) munmap(ptr, pages_mapped_size(bytes, policy));
+#endif
+}
+
+void *pages_alloc(uint64_t bytes, int policy) {
+#ifdef __linux__
+    if (policy == PAGES_DEFAULT) return pages_aligned_alloc(bytes);
+    char *ptr = pages_map(bytes, policy);
+    if (ptr != NULL) memset(ptr, 0, pages_mapped_size(bytes, policy));
+    return ptr;
+#else
+    if (policy != PAGES_DEFAULT) fprintf(stderr, "Page size policies are only supported on Linux, using default allocation\n");
+    return pages_aligned_alloc(bytes);
+#endif
+}
+
+void pages_free(void *ptr, uint64_t bytes, int policy) {
+    if (ptr == NULL) return;
+#ifdef __linux__
+    if (policy != PAGES_DEFAULT) {
+        pages_unmap(ptr, bytes, policy);
+        return;
+    }
+#endif
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+int pages_verify(void *ptr, struct page_report *report) {
+    memset(report, 0, sizeof(struct page_report));
+#ifdef __linux__
+    char line[512];
+    int inMapping = 0, found = 0;
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (smaps == NULL) return -1;
+    while (fgets(line, sizeof(line), smaps) != NULL) {
+        unsigned long long start, end, value;
+        char key[64];
+
+        // mapping header lines start with the address range, field lines with a key
+        if (sscanf(line, "%llx-%llx ", &start, &end) == 2) {
+            if (inMapping) break;
+            inMapping = (uintptr_t)ptr >= start && (uintptr_t)ptr < end;
+            found |= inMapping;
+            continue;
+        }
+
+        if (!inMapping || sscanf(line, "%63[^:]: %llu", key, &value) != 2) continue;
+        if (strcmp(key, "Rss") == 0) report->rssKb = value;
+        else if (strcmp(key, "AnonHugePages") == 0) report->anonHugeKb = value;
+        else if (strcmp(key, "Private_Hugetlb") == 0 || strcmp(key, "Shared_Hugetlb") == 0) report->hugetlbKb += value;
+        else if (strcmp(key, "KernelPageSize") == 0) report->kernelPageKb = value;
+    }
+
+    fclose(smaps);
+    return found ? 0 : -1;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,36 @@
+#ifndef pagesincluded
+#define pagesincluded
+#include <stdint.h>
+
+// Page size policies for test arrays
+#define PAGES_DEFAULT 0     // posix_memalign, whatever the system gives
+#define PAGES_4K 1          // mmap with transparent hugepages disabled for the range (MADV_NOHUGEPAGE)
+#define PAGES_THP 2         // 2 MB aligned mmap with MADV_HUGEPAGE
+#define PAGES_HUGETLB_2M 3  // MAP_HUGETLB | MAP_HUGE_2MB, needs pages reserved in /proc/sys/vm/nr_hugepages
+#define PAGES_HUGETLB_1G 4  // MAP_HUGETLB | MAP_HUGE_1GB, needs 1 GB pages reserved (hugepagesz=1G hugepages=N at boot)
+#define PAGES_POLICY_COUNT 5
+#define PAGES_INVALID -1
+
+// what the kernel actually backed a range with, from /proc/self/smaps
+struct page_report {
+    uint64_t rssKb;
+    uint64_t anonHugeKb;     // AnonHugePages, THP backed
+    uint64_t hugetlbKb;      // Private_Hugetlb + Shared_Hugetlb
+    uint64_t kernelPageKb;   // KernelPageSize of the mapping
+};
+
+int pages_parse_policy(const char *name);
+const char *pages_policy_name(int policy);
+
+// Returns NULL on failure. Anything other than PAGES_DEFAULT is faulted in before returning, so it can be verified
+void *pages_alloc(uint64_t bytes, int policy);
+void pages_free(void *ptr, uint64_t bytes, int policy);
+
+// Maps without faulting anything in, so callers can set a memory policy (mbind) before first touch.
+// PAGES_DEFAULT gives a plain mmap. Linux only, returns NULL elsewhere. Free with pages_unmap
+void *pages_map(uint64_t bytes, int policy);
+void pages_unmap(void *ptr, uint64_t bytes, int policy);
+
+// Fills in report for the mapping holding ptr. Returns 0 on success, -1 if smaps isn't available
+int pages_verify(void *ptr, struct page_report *report);
+#endif
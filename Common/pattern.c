@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pattern.h"
+#include "chain.h"
+
+#define PATTERN_PAGE_SIZE 4096
+
+void pattern_default(struct access_pattern *pattern) {
+    pattern->type = PATTERN_RANDOM;
+    pattern->stride = 1;
+    pattern->pages = 8;
+    pattern->streams = 4;
+    pattern->zipfS = 0.99;
+    pattern->hotFraction = 0.1;
+    pattern->hotAccessFraction = 0.9;
+}
+
+int pattern_parse(const char *spec, struct access_pattern *pattern) {
+    const char *arg = strchr(spec, ':');
+    pattern_default(pattern);
+    if (strncmp(spec, "random", 6) == 0) pattern->type = PATTERN_RANDOM;
+    else if (strncmp(spec, "stride", 6) == 0) {
+        pattern->type = PATTERN_STRIDE;
+        if (arg) pattern->stride = strtoull(arg + 1, NULL, 0);
+    } else if (strncmp(spec, "reverse", 7) == 0) {
+        pattern->type = PATTERN_REVERSE;
+        if (arg) pattern->stride = strtoull(arg + 1, NULL, 0);
+    } else if (strncmp(spec, "pages", 5) == 0) {
+        pattern->type = PATTERN_PAGES;
+        if (arg) pattern->pages = strtoull(arg + 1, NULL, 0);
+    } else if (strncmp(spec, "streams", 7) == 0) {
+        pattern->type = PATTERN_STREAMS;
+        if (arg) pattern->streams = strtoull(arg + 1, NULL, 0);
+    } else if (strncmp(spec, "zipf", 4) == 0) {
+        pattern->type = PATTERN_ZIPF;
+        if (arg) pattern->zipfS = atof(arg + 1);
+    } else if (strncmp(spec, "hotcold", 7) == 0) {
+        pattern->type = PATTERN_HOTCOLD;
+        if (arg) {
+            pattern->hotFraction = atof(arg + 1);
+            arg = strchr(arg + 1, ':');
+            if (arg) pattern->hotAccessFraction = atof(arg + 1);
+        }
+    } else {
+        fprintf(stderr, "Unrecognized pattern %s. Valid options: random, stride[:lines], reverse[:lines], pages[:count], streams[:count], zipf[:s], hotcold[:hot fraction[:hot access fraction]]\n", spec);
+        return PATTERN_INVALID;
+    }
+
+    if (pattern->stride < 1) pattern->stride = 1;
+    if (pattern->pages < 1) pattern->pages = 1;
+    if (pattern->streams < 1) pattern->streams = 1;
+    if (pattern->zipfS <= 0) pattern->zipfS = 0.99;
+    if (pattern->hotFraction <= 0 || pattern->hotFraction > 1) pattern->hotFraction = 0.1;
+    if (pattern->hotAccessFraction < 0 || pattern->hotAccessFraction > 1) pattern->hotAccessFraction = 0.9;
+    return pattern->type;
+}
+
+void pattern_describe(struct access_pattern *pattern, char *buf, int len) {
+    switch (pattern->type) {
+        case PATTERN_STRIDE: snprintf(buf, len, "stride:%llu", (unsigned long long)pattern->stride); break;
+        case PATTERN_REVERSE: snprintf(buf, len, "reverse:%llu", (unsigned long long)pattern->stride); break;
+        case PATTERN_PAGES: snprintf(buf, len, "pages:%llu", (unsigned long long)pattern->pages); break;
+        case PATTERN_STREAMS: snprintf(buf, len, "streams:%llu", (unsigned long long)pattern->streams); break;
+        case PATTERN_ZIPF: snprintf(buf, len, "zipf:%g", pattern->zipfS); break;
+        case PATTERN_HOTCOLD: snprintf(buf, len, "hotcold:%g:%g", pattern->hotFraction, pattern->hotAccessFraction); break;
+        default: snprintf(buf, len, "random"); break;
+    }
+}
+
+int pattern_is_sequence(struct access_pattern *pattern) {
+    return pattern->type == PATTERN_ZIPF || pattern->type == PATTERN_HOTCOLD;
+}
+
+static void pattern_shuffle(uint64_t *arr, uint64_t count, struct chain_rng *rng) {
+    for (uint64_t i = count; i > 1; i--) {
+        uint64_t j = chain_rng_bounded(rng, i);
+        uint64_t tmp = arr[i - 1];
+        arr[i - 1] = arr[j];
+        arr[j] = tmp;
+    }
+}
+
+int pattern_order(struct access_pattern *pattern, uint64_t *order, uint64_t count, uint64_t nodeBytes) {
+    uint64_t seed = chain_next_seed(), idx = 0;
+    if (pattern->type == PATTERN_STRIDE || pattern->type == PATTERN_REVERSE) {
+        uint64_t stride = pattern->stride < count ? pattern->stride : 1;
+        for (uint64_t start = 0; start < stride; start++) {
+            for (uint64_t node = start; node < count; node += stride) order[idx++] = node;
+        }
+
+        if (pattern->type == PATTERN_REVERSE) {
+            for (uint64_t i = 0; i < count / 2; i++) {
+                uint64_t tmp = order[i];
+                order[i] = order[count - 1 - i];
+                order[count - 1 - i] = tmp;
+            }
+        }
+
+        return 0;
+    } else if (pattern->type == PATTERN_STREAMS) {
+        uint64_t streams = pattern->streams < count ? pattern->streams : count;
+        uint64_t streamNodes = (count + streams - 1) / streams;
+        for (uint64_t pos = 0; pos < streamNodes; pos++) {
+            for (uint64_t stream = 0; stream < streams; stream++) {
+                uint64_t node = stream * streamNodes + pos;
+                if (node < count) order[idx++] = node;
+            }
+        }
+
+        return 0;
+    } else if (pattern->type == PATTERN_PAGES) {
+        struct chain_rng rng;
+        uint64_t nodesPerPage = nodeBytes < PATTERN_PAGE_SIZE ? PATTERN_PAGE_SIZE / nodeBytes : 1;
+        uint64_t windowNodes = nodesPerPage * pattern->pages;
+        uint64_t windowCount = (count + windowNodes - 1) / windowNodes;
+        uint64_t *windowOrder = (uint64_t *)malloc(windowCount * sizeof(uint64_t));
+        if (windowOrder == NULL || chain_random_order(windowOrder, windowCount, seed) != 0) {
+            free(windowOrder);
+            return -1;
+        }
+
+        chain_rng_seed(&rng, seed, windowCount);
+        for (uint64_t window = 0; window < windowCount; window++) {
+            uint64_t first = windowOrder[window] * windowNodes, windowStart = idx;
+            uint64_t last = first + windowNodes < count ? first + windowNodes : count;
+            for (uint64_t node = first; node < last; node++) order[idx++] = node;
+            pattern_shuffle(order + windowStart, idx - windowStart, &rng);
+        }
+
+        free(windowOrder);
+        return 0;
+    }
+
+    return chain_random_order(order, count, seed);
+}
+
+static int pattern_fill(struct access_pattern *pattern, void *arr, int wide, uint64_t count, uint64_t stride, uint64_t offset, uint64_t nodeBytes) {
+    if (count == 0) return 0;
+    if (pattern->type == PATTERN_RANDOM || pattern_is_sequence(pattern)) {
+        return wide ? chain_fill64((uint64_t *)arr, count, stride, offset) : chain_fill32((uint32_t *)arr, count, stride, offset);
+    }
+
+    uint64_t *order = (uint64_t *)malloc(count * sizeof(uint64_t));
+    if (order == NULL || pattern_order(pattern, order, count, nodeBytes) != 0) {
+        fprintf(stderr, "Could not allocate scratch memory for %llu node pattern\n", (unsigned long long)count);
+        free(order);
+        return -1;
+    }
+
+    if (wide) chain_link64((uint64_t *)arr, order, count, stride, offset);
+    else chain_link32((uint32_t *)arr, order, count, stride, offset);
+    free(order);
+    return 0;
+}
+
+int pattern_fill32(struct access_pattern *pattern, uint32_t *arr, uint64_t count, uint64_t stride, uint64_t offset, uint64_t nodeBytes) {
+    return pattern_fill(pattern, arr, 0, count, stride, offset, nodeBytes);
+}
+
+int pattern_fill64(struct access_pattern *pattern, uint64_t *arr, uint64_t count, uint64_t stride, uint64_t offset, uint64_t nodeBytes) {
+    return pattern_fill(pattern, arr, 1, count, stride, offset, nodeBytes);
+}
+
+static double chain_rng_double(struct chain_rng *rng) {
+    return (chain_rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+// Rejection-inversion zipf sampling (Hormann and Derflinger), O(1) per sample for any node count
+struct zipf_sampler {
+    double s;
+    uint64_t n;
+    double hIntegralX1, hIntegralN, threshold;
+};
+
+static double zipf_helper1(double x) {
+    return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+static double zipf_helper2(double x) {
+    return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0 / 3.0) * (1 + 0.25 * x));
+}
+
+static double zipf_h(struct zipf_sampler *zipf, double x) {
+    return exp(-zipf->s * log(x));
+}
+
+static double zipf_h_integral(struct zipf_sampler *zipf, double x) {
+    double logX = log(x);
+    return zipf_helper2((1 - zipf->s) * logX) * logX;
+}
+
+static double zipf_h_integral_inverse(struct zipf_sampler *zipf, double x) {
+    double t = x * (1 - zipf->s);
+    if (t < -1) t = -1;
+    return exp(zipf_helper1(t) * x);
+}
+
+static void zipf_init(struct zipf_sampler *zipf, uint64_t n, double s) {
+    zipf->s = s;
+    zipf->n = n;
+    zipf->hIntegralX1 = zipf_h_integral(zipf, 1.5) - 1;
+    zipf->hIntegralN = zipf_h_integral(zipf, n + 0.5);
+    zipf->threshold = 2 - zipf_h_integral_inverse(zipf, zipf_h_integral(zipf, 2.5) - zipf_h(zipf, 2));
+}
+
+// rank in [1, n]
+static uint64_t zipf_sample(struct zipf_sampler *zipf, struct chain_rng *rng) {
+    while (1) {
+        double u = zipf->hIntegralN + chain_rng_double(rng) * (zipf->hIntegralX1 - zipf->hIntegralN);
+        double x = zipf_h_integral_inverse(zipf, u);
+        uint64_t k = (uint64_t)(x + 0.5);
+        if (k < 1) k = 1;
+        else if (k > zipf->n) k = zipf->n;
+        if (k - x <= zipf->threshold || u >= zipf_h_integral(zipf, k + 0.5) - zipf_h(zipf, k)) return k;
+    }
+}
+
+uint64_t *pattern_sequence(struct access_pattern *pattern, uint64_t count, uint64_t length) {
+    struct chain_rng rng;
+    uint64_t seed = chain_next_seed();
+    uint64_t *sequence = (uint64_t *)malloc(length * sizeof(uint64_t));
+
+    // scatter ranks (zipf) or pick the hot set (hotcold) with a random permutation, so popular nodes
+    // aren't next to each other
+    uint64_t *nodes = (uint64_t *)malloc(count * sizeof(uint64_t));
+    if (sequence == NULL || nodes == NULL || chain_random_order(nodes, count, seed) != 0) {
+        fprintf(stderr, "Could not allocate memory for %llu entry access sequence\n", (unsigned long long)length);
+        free(sequence);
+        free(nodes);
+        return NULL;
+    }
+
+    chain_rng_seed(&rng, seed, count);
+    if (pattern->type == PATTERN_ZIPF) {
+        struct zipf_sampler zipf;
+        zipf_init(&zipf, count, pattern->zipfS);
+        for (uint64_t i = 0; i < length; i++) sequence[i] = nodes[zipf_sample(&zipf, &rng) - 1];
+    } else {
+        uint64_t hotCount = count * pattern->hotFraction;
+        if (hotCount < 1) hotCount = 1;
+        uint64_t coldCount = count - hotCount;
+        for (uint64_t i = 0; i < length; i++) {
+            if (coldCount == 0 || chain_rng_double(&rng) < pattern->hotAccessFraction)
+                sequence[i] = nodes[chain_rng_bounded(&rng, hotCount)];
+            else sequence[i] = nodes[hotCount + chain_rng_bounded(&rng, coldCount)];
+        }
+    }
+
+    free(nodes);
+    return sequence;
+}
@@ -0,0 +1,44 @@
+#ifndef patternincluded
+#define patternincluded
+#include <stdint.h>
+
+// Access patterns for latency tests, beyond a uniform random chase.
+// Cycle patterns are a visiting order over every node, linked into one pointer chasing cycle.
+// Skewed patterns (zipf, hotcold) revisit some nodes far more than others, which a cycle can't do since
+// each node only has one successor. Those come out as a sequence of node indices instead, for a
+// dependent load loop that adds each loaded value to the next sequence entry
+#define PATTERN_RANDOM 0   // uniform random single cycle
+#define PATTERN_STRIDE 1   // every (stride)th node, wrapping around to cover all of them
+#define PATTERN_REVERSE 2  // same, walking down
+#define PATTERN_PAGES 3    // random within windows of (pages) pages, windows in random order
+#define PATTERN_ZIPF 4     // zipf(s) over nodes, ranks scattered randomly through the array
+#define PATTERN_HOTCOLD 5  // hotAccessFraction of accesses to a random hotFraction of nodes, rest uniform over the others
+#define PATTERN_STREAMS 6  // (streams) sequential streams through equal parts of the array, interleaved round robin
+#define PATTERN_INVALID -1
+
+struct access_pattern {
+    int type;
+    uint64_t stride;
+    uint64_t pages;
+    uint64_t streams;
+    double zipfS;
+    double hotFraction;
+    double hotAccessFraction;
+};
+
+// random, stride[:lines], reverse[:lines], pages[:count], streams[:count], zipf[:s], hotcold[:hot fraction[:hot access fraction]]
+int pattern_parse(const char *spec, struct access_pattern *pattern);
+void pattern_default(struct access_pattern *pattern);
+void pattern_describe(struct access_pattern *pattern, char *buf, int len);
+int pattern_is_sequence(struct access_pattern *pattern);
+
+// Visiting order over count nodes of nodeBytes each, for cycle patterns. returns 0 on success
+int pattern_order(struct access_pattern *pattern, uint64_t *order, uint64_t count, uint64_t nodeBytes);
+
+// Cycle patterns into a pointer chasing array, laid out like chain_fill32/chain_fill64
+int pattern_fill32(struct access_pattern *pattern, uint32_t *arr, uint64_t count, uint64_t stride, uint64_t offset, uint64_t nodeBytes);
+int pattern_fill64(struct access_pattern *pattern, uint64_t *arr, uint64_t count, uint64_t stride, uint64_t offset, uint64_t nodeBytes);
+
+// Sequence of length node indices drawn from a skewed pattern over count nodes. caller frees
+uint64_t *pattern_sequence(struct access_pattern *pattern, uint64_t count, uint64_t length);
+#endif
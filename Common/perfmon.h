@@ -1,4 +1,20 @@
 // Stuff that only works on Linux. Should be #ifdef-ed out for mingw cross compilation
+#ifndef perfmonincluded
+#define perfmonincluded
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <linux/perf_event.h>
+
 uint64_t readmsr(uint32_t coreindex, uint32_t msrindex) {
     char buf[256];
     memset(buf, 0, 256);
@@ -10,42 +26,111 @@ uint64_t readmsr(uint32_t coreindex, uint32_t msrindex) {
         fprintf(stderr, "Could not open msr\n");
         return 0;
     }
-    
+
     lseek(fd, msrindex, SEEK_SET);
     read(fd, &msrvalue, 8);
     close(fd);
     return msrvalue;
 }
 
-#define PERF_NUM_EVENTS 4
+// Event lists are comma separated. Each event can be:
+// - a generic name from perf_generic_events below, like instructions or llc_miss
+// - a raw code, like r412e
+// - a sysfs PMU event, like cpu/event=0x2e,umask=0x41/ or cpu/cache-misses/
+//   terms are looked up in /sys/bus/event_source/devices/<pmu>/format and events
+#define PERF_MAX_EVENTS 32
+
+// events are opened in groups of this size. A group is only counted when all of its events fit
+// on the PMU at once, so bigger groups risk never being scheduled. Groups get multiplexed when
+// there are more than the PMU can handle, and values are scaled by time enabled / time running
+#define PERF_GROUP_SIZE 4
+#define PERF_DEFAULT_EVENTS "instructions,cycles,llc_ref,llc_miss"
+#define PERF_SYSFS_PATH "/sys/bus/event_source/devices"
+
 struct perf_read_data {
     uint64_t nr;
+    uint64_t time_enabled;
+    uint64_t time_running;
     struct {
         uint64_t value;
         uint64_t id;
-    } values[PERF_NUM_EVENTS];
+    } values[PERF_GROUP_SIZE];
 };
 
 struct perf_select_data {
     uint64_t id;   // id used to identify the event when it comes back in a group
-    int fd;        // file descriptor
+    int fd;        // file descriptor, -1 if the event couldn't be opened
+    int leader;    // index of group leader within the set
     struct perf_event_attr attr;
-    uint64_t value;
-    const char *description;
+    uint64_t value;        // scaled if the group was multiplexed
+    uint64_t time_enabled;
+    uint64_t time_running;
+    char description[64];
 };
 
-struct perf_select_data perf_selected_events[PERF_NUM_EVENTS];
-struct perf_read_data perfReadData;
+// a set of counters attached to one thread. tid 0 = calling thread
+struct perf_counter_set {
+    int eventCount;
+    pid_t tid;
+    struct perf_select_data events[PERF_MAX_EVENTS];
+};
+
+struct perf_generic_event {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+};
+
+#define PERF_CACHE_EVENT(cache, op, result) ((cache) | ((op) << 8) | ((result) << 16))
+static const struct perf_generic_event perf_generic_events[] = {
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "ref-cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES },
+    { "branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+    { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+    { "cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "stalled-cycles-frontend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND },
+    { "stalled-cycles-backend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND },
+    // kernel maps these to 0x4F2E/0x412E on Intel, and to something sensible on other vendors
+    { "llc_ref", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+    { "llc_miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "l1d-loads", PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS) },
+    { "l1d-load-misses", PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "llc-loads", PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS) },
+    { "llc-load-misses", PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "dtlb-load-misses", PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "itlb-load-misses", PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_ITLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+};
+
+// Core PMUs, found by looking for PMUs with a cpus file. Hybrid x86 has cpu_core and cpu_atom,
+// big.LITTLE arm has one armv8_pmuv3_* or armv8_cortex_* per core type. Plain "cpu" doesn't have one
+#define PERF_MAX_PMUS 8
+#define PERF_MAX_CPUS 1024
+#define PERF_PMU_TYPE_SHIFT 32
+struct perf_pmu {
+    char name[64];
+    uint32_t type;
+    uint64_t cpus[PERF_MAX_CPUS / 64];
+};
+
+struct perf_pmu perf_pmus[PERF_MAX_PMUS];
+int perf_pmu_count = -1; // -1 = not enumerated yet
+
+const char *perf_event_list = PERF_DEFAULT_EVENTS;  // set from -pmonevents
+struct perf_counter_set perf_default_set;           // calling thread, plus threads it creates afterward
+struct perf_counter_set *perf_thread_sets = NULL;   // threads that already existed, see perf_attach_threads
+int perf_thread_set_count = 0;
 struct timeval perf_startTv, perf_endTv;
 uint64_t perf_time_ms;
 
 // populates basic properties
 void initialize_hw_event(struct perf_event_attr *attr, uint64_t cfg, uint32_t hwid) {
     memset(attr, 0, sizeof(struct perf_event_attr));
-    
+
     // low 32 bits of config = hardware event id
-    // high 32 bits = PMU id (atom/core). Get from /sys/devices/<the thing>/type
-    // on Arrow Lake, atom = 10, core = 4 
+    // high 32 bits = PMU type (atom/core), from /sys/bus/event_source/devices/<pmu>/type
+    // perf_open_set fills this in from the thread's affinity, see perf_pmu_for_thread
     attr->config = cfg | ((uint64_t)hwid << 32);
     attr->type = PERF_TYPE_HARDWARE;
     attr->size = sizeof(struct perf_event_attr);
@@ -53,83 +138,381 @@ void initialize_hw_event(struct perf_event_attr *attr, uint64_t cfg, uint32_t hw
     attr->exclude_kernel = 1;
     attr->exclude_hv = 1;
     attr->inherit = 1; // include child threads
-    attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+    attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+}
+
+// reads a small sysfs file into buf, stripping the trailing newline. returns 0 on failure
+int perf_read_sysfs(const char *path, char *buf, int len) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return 0;
+    if (fgets(buf, len, f) == NULL) buf[0] = '\0';
+    fclose(f);
+    int end = strlen(buf);
+    while (end > 0 && isspace((unsigned char)buf[end - 1])) buf[--end] = '\0';
+    return 1;
 }
 
-void set_hw_event(struct perf_select_data *evt, int groupfd) {
-    evt->fd = syscall(__NR_perf_event_open, &(evt->attr), 0, -1, groupfd, 0);
+// parses a cpu list like "0-7,16-23" into a bitmap
+void perf_parse_cpulist(const char *list, uint64_t *cpus) {
+    memset(cpus, 0, PERF_MAX_CPUS / 8);
+    while (*list) {
+        char *end;
+        int lo = strtol(list, &end, 10), hi = lo;
+        if (end == list) break;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (int cpu = lo; cpu <= hi && cpu < PERF_MAX_CPUS; cpu++) cpus[cpu / 64] |= 1ULL << (cpu % 64);
+        if (*end != ',') break;
+        list = end + 1;
+    }
+}
+
+void perf_enumerate_pmus() {
+    char path[512], contents[1024];
+    perf_pmu_count = 0;
+    DIR *pmuDir = opendir(PERF_SYSFS_PATH);
+    if (pmuDir == NULL) return;
+    struct dirent *entry;
+    while ((entry = readdir(pmuDir)) != NULL && perf_pmu_count < PERF_MAX_PMUS) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), PERF_SYSFS_PATH "/%s/cpus", entry->d_name);
+        if (!perf_read_sysfs(path, contents, sizeof(contents))) continue;
+        struct perf_pmu *pmu = perf_pmus + perf_pmu_count;
+        perf_parse_cpulist(contents, pmu->cpus);
+        snprintf(path, sizeof(path), PERF_SYSFS_PATH "/%s/type", entry->d_name);
+        if (!perf_read_sysfs(path, contents, sizeof(contents))) continue;
+        pmu->type = atoi(contents);
+        strncpy(pmu->name, entry->d_name, sizeof(pmu->name) - 1);
+        pmu->name[sizeof(pmu->name) - 1] = '\0';
+        perf_pmu_count++;
+    }
+
+    closedir(pmuDir);
+}
+
+// returns the core PMU covering every cpu the thread can run on, or -1 if there's only one
+// core type or the thread isn't pinned to a single type
+int perf_pmu_for_thread(pid_t tid) {
+    uint64_t affinity[PERF_MAX_CPUS / 64];
+    if (perf_pmu_count < 0) perf_enumerate_pmus();
+    if (perf_pmu_count < 2) return -1;
+
+    memset(affinity, 0, sizeof(affinity));
+    if (syscall(SYS_sched_getaffinity, tid, sizeof(affinity), affinity) < 0) return -1;
+    int match = -1;
+    for (int pmuIdx = 0; pmuIdx < perf_pmu_count; pmuIdx++) {
+        int overlaps = 0, covers = 1;
+        for (int i = 0; i < PERF_MAX_CPUS / 64; i++) {
+            if (affinity[i] & perf_pmus[pmuIdx].cpus[i]) overlaps = 1;
+            if (affinity[i] & ~perf_pmus[pmuIdx].cpus[i]) covers = 0;
+        }
+
+        if (covers) return pmuIdx;
+        if (overlaps) match = match == -1 ? pmuIdx : -2;
+    }
+
+    if (match == -2) fprintf(stderr, "Thread %d can run on more than one core type. Pin it to get counts from all of them\n", tid);
+    return match < 0 ? -1 : match;
+}
+
+// point generic and raw events at a specific core PMU. sysfs events already name their PMU
+void perf_apply_pmu(struct perf_event_attr *attr, int pmuIdx) {
+    if (pmuIdx < 0) return;
+    if (attr->type == PERF_TYPE_HARDWARE || attr->type == PERF_TYPE_HW_CACHE)
+        attr->config |= (uint64_t)perf_pmus[pmuIdx].type << PERF_PMU_TYPE_SHIFT;
+    else if (attr->type == PERF_TYPE_RAW) attr->type = perf_pmus[pmuIdx].type;
+}
+
+// deposit value into the bits described by a format file, like "config:0-7,21" or "config1:0-15"
+int perf_apply_format(struct perf_event_attr *attr, const char *format, uint64_t value) {
+    __u64 *field;
+    const char *bits = strchr(format, ':');
+    if (bits == NULL) return 0;
+    if (strncmp(format, "config:", 7) == 0) field = &(attr->config);
+    else if (strncmp(format, "config1:", 8) == 0) field = &(attr->config1);
+    else if (strncmp(format, "config2:", 8) == 0) field = &(attr->config2);
+    else return 0;
+
+    bits++;
+    while (*bits) {
+        char *end;
+        int lo = strtol(bits, &end, 10), hi = lo;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (int bit = lo; bit <= hi; bit++) {
+            if (value & 1) *field |= 1ULL << bit;
+            else *field &= ~(1ULL << bit);
+            value >>= 1;
+        }
+
+        if (*end != ',') break;
+        bits = end + 1;
+    }
+
+    return 1;
+}
+
+// terms = "event=0x2e,umask=0x41", or event aliases from the PMU's events directory
+int perf_apply_terms(struct perf_event_attr *attr, const char *pmu, const char *terms, int depth) {
+    char termBuf[256], path[512], contents[256];
+    strncpy(termBuf, terms, 255);
+    termBuf[255] = '\0';
+    char *savePtr = NULL;
+    for (char *term = strtok_r(termBuf, ",", &savePtr); term != NULL; term = strtok_r(NULL, ",", &savePtr)) {
+        char *eq = strchr(term, '=');
+        uint64_t value = 1;
+        if (eq != NULL) {
+            *eq = '\0';
+            value = strtoull(eq + 1, NULL, 0);
+        } else if (depth == 0) {
+            snprintf(path, sizeof(path), PERF_SYSFS_PATH "/%s/events/%s", pmu, term);
+            if (perf_read_sysfs(path, contents, sizeof(contents))) {
+                if (!perf_apply_terms(attr, pmu, contents, depth + 1)) return 0;
+                continue;
+            }
+        }
+
+        snprintf(path, sizeof(path), PERF_SYSFS_PATH "/%s/format/%s", pmu, term);
+        if (!perf_read_sysfs(path, contents, sizeof(contents)) || !perf_apply_format(attr, contents, value)) {
+            fprintf(stderr, "Unknown term %s for PMU %s\n", term, pmu);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// fills in attr type and config for one event name. returns 0 if it couldn't be parsed
+int perf_parse_event(const char *name, struct perf_event_attr *attr) {
+    for (size_t i = 0; i < sizeof(perf_generic_events) / sizeof(struct perf_generic_event); i++) {
+        if (strcmp(name, perf_generic_events[i].name) == 0) {
+            attr->type = perf_generic_events[i].type;
+            attr->config = perf_generic_events[i].config;
+            return 1;
+        }
+    }
+
+    const char *slash = strchr(name, '/');
+    if (slash != NULL) {
+        char pmu[64], terms[256], path[512], contents[64];
+        size_t pmuLen = slash - name;
+        if (pmuLen >= sizeof(pmu)) pmuLen = sizeof(pmu) - 1;
+        memcpy(pmu, name, pmuLen);
+        pmu[pmuLen] = '\0';
+        strncpy(terms, slash + 1, 255);
+        terms[255] = '\0';
+        char *closingSlash = strchr(terms, '/');
+        if (closingSlash != NULL) *closingSlash = '\0';
+
+        snprintf(path, sizeof(path), PERF_SYSFS_PATH "/%s/type", pmu);
+        if (!perf_read_sysfs(path, contents, sizeof(contents))) {
+            fprintf(stderr, "Could not find PMU %s\n", pmu);
+            return 0;
+        }
+
+        attr->type = atoi(contents);
+        attr->config = 0;
+        return perf_apply_terms(attr, pmu, terms, 0);
+    }
+
+    if (name[0] == 'r' && name[1] != '\0') {
+        char *end;
+        uint64_t code = strtoull(name + 1, &end, 16);
+        if (*end == '\0') {
+            attr->type = PERF_TYPE_RAW;
+            attr->config = code;
+            return 1;
+        }
+    }
+
+    fprintf(stderr, "Unrecognized event %s\n", name);
+    return 0;
+}
+
+// splits an event list on commas outside of pmu/.../ terms. returns number of events
+int perf_parse_event_list(const char *list, struct perf_select_data *events, int maxEvents) {
+    int eventCount = 0, inTerms = 0;
+    size_t nameLen = 0;
+    char name[256];
+    for (const char *c = list; ; c++) {
+        if (*c == '\0' || (*c == ',' && !inTerms)) {
+            name[nameLen] = '\0';
+            if (nameLen > 0 && eventCount < maxEvents) {
+                struct perf_select_data *evt = events + eventCount;
+                initialize_hw_event(&(evt->attr), 0, 0);
+                if (perf_parse_event(name, &(evt->attr))) {
+                    strncpy(evt->description, name, sizeof(evt->description) - 1);
+                    evt->description[sizeof(evt->description) - 1] = '\0';
+                    eventCount++;
+                }
+            } else if (nameLen > 0) fprintf(stderr, "Too many events, ignoring %s\n", name);
+
+            nameLen = 0;
+            if (*c == '\0') break;
+            continue;
+        }
+
+        if (*c == '/') inTerms = !inTerms;
+        if (nameLen < sizeof(name) - 1) name[nameLen++] = *c;
+    }
+
+    return eventCount;
+}
+
+void set_hw_event(struct perf_select_data *evt, pid_t tid, int groupfd, int pmuIdx) {
+    struct perf_event_attr genericAttr = evt->attr;
+    perf_apply_pmu(&(evt->attr), pmuIdx);
+    evt->fd = syscall(__NR_perf_event_open, &(evt->attr), tid, -1, groupfd, 0);
+    if (evt->fd < 0 && pmuIdx >= 0) {
+        // kernels before 6.0 don't take a PMU type in the high bits of config
+        evt->attr = genericAttr;
+        evt->fd = syscall(__NR_perf_event_open, &(evt->attr), tid, -1, groupfd, 0);
+    }
+
+    if (evt->fd < 0) {
+        fprintf(stderr, "Could not open event %s\n", evt->description);
+        return;
+    }
+
     ioctl(evt->fd, PERF_EVENT_IOC_ID, &(evt->id));
 }
 
-void open_perf_monitoring() {
-    int groupLeaderFd = -1;
-    memset(perf_selected_events, 0, sizeof(struct perf_select_data) * PERF_NUM_EVENTS);
-    
-    perf_selected_events[0].description = "instructions";
-    initialize_hw_event(&(perf_selected_events[0].attr), PERF_COUNT_HW_INSTRUCTIONS, 0);
-    set_hw_event(perf_selected_events, -1);
-    groupLeaderFd = perf_selected_events[0].fd;
+// open perf_event_list against a thread. inherit = also count threads it creates later
+int perf_open_set(struct perf_counter_set *set, pid_t tid, int inherit) {
+    int leader = -1, groupSize = 0;
+    int pmuIdx = perf_pmu_for_thread(tid);
+    memset(set, 0, sizeof(struct perf_counter_set));
+    set->tid = tid;
+    if (pmuIdx >= 0) fprintf(stderr, "Counting on %s for thread %d\n", perf_pmus[pmuIdx].name, tid);
+    set->eventCount = perf_parse_event_list(perf_event_list, set->events, PERF_MAX_EVENTS);
+    for (int evt_idx = 0; evt_idx < set->eventCount; evt_idx++) {
+        struct perf_select_data *evt = set->events + evt_idx;
+        evt->attr.inherit = inherit;
+        if (leader < 0 || groupSize == PERF_GROUP_SIZE) {
+            set_hw_event(evt, tid, -1, pmuIdx);
+            if (evt->fd >= 0) {
+                leader = evt_idx;
+                groupSize = 1;
+            }
+        } else {
+            set_hw_event(evt, tid, set->events[leader].fd, pmuIdx);
+            if (evt->fd >= 0) groupSize++;
+        }
+
+        evt->leader = evt->fd >= 0 ? leader : -1;
+    }
 
-    perf_selected_events[1].description = "cycles";
-    initialize_hw_event(&(perf_selected_events[1].attr), PERF_COUNT_HW_CPU_CYCLES, 0);
-    set_hw_event(perf_selected_events + 1, groupLeaderFd);
+    return set->eventCount;
+}
 
-    perf_selected_events[2].description = "llc_ref";
-    initialize_hw_event(&(perf_selected_events[2].attr), 0x4F2E, 0);
-    perf_selected_events[2].attr.type = PERF_TYPE_RAW;
-    set_hw_event(perf_selected_events + 2, groupLeaderFd);
+void perf_start_set(struct perf_counter_set *set) {
+    for (int evt_idx = 0; evt_idx < set->eventCount; evt_idx++) {
+        if (set->events[evt_idx].leader != evt_idx) continue;
+        ioctl(set->events[evt_idx].fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(set->events[evt_idx].fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
 
-    perf_selected_events[3].description = "llc_miss";
-    initialize_hw_event(&(perf_selected_events[3].attr), 0x412E, 0);
-    perf_selected_events[3].attr.type = PERF_TYPE_RAW;
-    set_hw_event(perf_selected_events + 3, groupLeaderFd);
+void perf_stop_set(struct perf_counter_set *set) {
+    struct perf_read_data readData;
+    for (int evt_idx = 0; evt_idx < set->eventCount; evt_idx++) {
+        if (set->events[evt_idx].leader != evt_idx) continue;
+        int groupLeaderFd = set->events[evt_idx].fd;
+        ioctl(groupLeaderFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        memset(&readData, 0, sizeof(struct perf_read_data));
+        if (read(groupLeaderFd, &readData, sizeof(struct perf_read_data)) <= 0) continue;
+        for (uint64_t i = 0; i < readData.nr && i < PERF_GROUP_SIZE; i++) {
+            for (int member_idx = evt_idx; member_idx < set->eventCount; member_idx++) {
+                struct perf_select_data *selected_evt = set->events + member_idx;
+                if (selected_evt->leader != evt_idx || selected_evt->id != readData.values[i].id) continue;
+                selected_evt->time_enabled = readData.time_enabled;
+                selected_evt->time_running = readData.time_running;
+                if (readData.time_running == 0) selected_evt->value = 0;
+                else if (readData.time_running < readData.time_enabled)
+                    selected_evt->value = (uint64_t)((double)readData.values[i].value * readData.time_enabled / readData.time_running);
+                else selected_evt->value = readData.values[i].value;
+            }
+        }
+    }
+}
+
+void perf_close_set(struct perf_counter_set *set) {
+    for (int evt_idx = 0; evt_idx < set->eventCount; evt_idx++) {
+        if (set->events[evt_idx].fd >= 0) close(set->events[evt_idx].fd);
+    }
+
+    set->eventCount = 0;
+}
+
+void open_perf_monitoring() {
+    perf_open_set(&perf_default_set, 0, 1);
+}
+
+// per-thread counters for threads that already exist, like pool workers.
+// start/stop_perf_monitoring handle them too, and values get summed into the default set
+void perf_attach_threads(pid_t *tids, int count) {
+    perf_thread_sets = (struct perf_counter_set *)malloc(sizeof(struct perf_counter_set) * count);
+    perf_thread_set_count = count;
+    for (int i = 0; i < count; i++) perf_open_set(perf_thread_sets + i, tids[i], 0);
 }
 
 void start_perf_monitoring() {
     gettimeofday(&perf_startTv, NULL);
-    int groupLeaderFd = perf_selected_events[0].fd;
-    ioctl(groupLeaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
-    ioctl(groupLeaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP); 
+    for (int i = 0; i < perf_thread_set_count; i++) perf_start_set(perf_thread_sets + i);
+    perf_start_set(&perf_default_set);
 }
 
-uint64_t instrs, cycles, llcRef, llcMiss;
 void stop_perf_monitoring() {
-    int readbytes = 0;
-    int groupLeaderFd = perf_selected_events[0].fd;
-    ioctl(groupLeaderFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
-    // fprintf(stderr, "read %d bytes\n", sizeof(struct perf_read_data));
-    readbytes = read(groupLeaderFd, &perfReadData, sizeof(struct perf_read_data));
-    //fprintf(stderr, "Read %d bytes into perf_read_data. nr = %lu\n", readbytes, perfReadData.nr);
-    for (int i = 0; i < perfReadData.nr; i++) {
-        for (int evt_idx = 0; evt_idx < PERF_NUM_EVENTS; evt_idx++) {
-            if (perf_selected_events[evt_idx].id == perfReadData.values[i].id) {
-                struct perf_select_data *selected_evt = perf_selected_events + evt_idx;
-                selected_evt->value = perfReadData.values[i].value;
-                // fprintf(stderr, "%s: %lu\n", selected_evt->description, selected_evt->value);
-            }
+    perf_stop_set(&perf_default_set);
+    for (int i = 0; i < perf_thread_set_count; i++) {
+        perf_stop_set(perf_thread_sets + i);
+        for (int evt_idx = 0; evt_idx < perf_default_set.eventCount && evt_idx < perf_thread_sets[i].eventCount; evt_idx++) {
+            perf_default_set.events[evt_idx].value += perf_thread_sets[i].events[evt_idx].value;
         }
     }
 
     gettimeofday(&perf_endTv, NULL);
-    perf_time_ms = ((perf_endTv.tv_sec - perf_startTv.tv_sec) * 1000 + (perf_endTv.tv_usec - perf_startTv.tv_usec) / 1000); 
+    perf_time_ms = ((perf_endTv.tv_sec - perf_startTv.tv_sec) * 1000 + (perf_endTv.tv_usec - perf_startTv.tv_usec) / 1000);
 }
 
 void close_perf_monitoring() {
-    for (int evt_idx = 0; evt_idx < PERF_NUM_EVENTS; evt_idx++) close(perf_selected_events[evt_idx].fd);
+    perf_close_set(&perf_default_set);
+    for (int i = 0; i < perf_thread_set_count; i++) perf_close_set(perf_thread_sets + i);
+    free(perf_thread_sets);
+    perf_thread_sets = NULL;
+    perf_thread_set_count = 0;
+}
+
+uint64_t get_perf_value(const char *description) {
+    for (int evt_idx = 0; evt_idx < perf_default_set.eventCount; evt_idx++) {
+        if (strcmp(perf_default_set.events[evt_idx].description, description) == 0) return perf_default_set.events[evt_idx].value;
+    }
+
+    return 0;
 }
 
 void append_perf_header() {
-    for (int evt_idx = 0; evt_idx < PERF_NUM_EVENTS; evt_idx++) {
-        printf(",%s", perf_selected_events[evt_idx].description);
+    for (int evt_idx = 0; evt_idx < perf_default_set.eventCount; evt_idx++) {
+        printf(",%s", perf_default_set.events[evt_idx].description);
     }
 
     printf(",Time (ms)");
 }
 
 void append_perf_values() {
-    for (int evt_idx = 0; evt_idx < PERF_NUM_EVENTS; evt_idx++) {
-        printf(",%lu", perf_selected_events[evt_idx].value);
+    for (int evt_idx = 0; evt_idx < perf_default_set.eventCount; evt_idx++) {
+        printf(",%lu", perf_default_set.events[evt_idx].value);
     }
-    
+
     printf(",%lu", perf_time_ms);
 }
+
+// one line summary for tools that don't print csv
+void print_perf_summary(FILE *f) {
+    uint64_t instrs = get_perf_value("instructions"), cycles = get_perf_value("cycles");
+    for (int evt_idx = 0; evt_idx < perf_default_set.eventCount; evt_idx++) {
+        fprintf(f, "%s%s: %lu", evt_idx ? ", " : "", perf_default_set.events[evt_idx].description, perf_default_set.events[evt_idx].value);
+    }
+
+    if (instrs && cycles) fprintf(f, ", IPC: %.2f", (float)instrs / cycles);
+    fprintf(f, "\n");
+}
+#endif
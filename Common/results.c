@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/utsname.h>
+#endif
+#include "results.h"
+
+int resultsFormat = RESULTS_FORMAT_DEFAULT;
+
+const char *resultsTool = "unknown";
+int resultsHeaderPrinted = 0;
+char hostName[256], hostKernel[256], hostCpu[256];
+const char *hostTimer = NULL;
+long hostCpuCount = 0;
+
+int results_parse_format(const char *name) {
+    if (strncmp(name, "json", 4) == 0) return RESULTS_FORMAT_JSON;
+    if (strncmp(name, "csv", 3) == 0) return RESULTS_FORMAT_CSV;
+    if (strncmp(name, "default", 7) != 0) fprintf(stderr, "Unrecognized format %s, using default output\n", name);
+    return RESULTS_FORMAT_DEFAULT;
+}
+
+// first "model name" (x86) or "CPU part" (arm) line in /proc/cpuinfo
+void read_cpu_model(char *model, int len) {
+    char line[512];
+    strncpy(model, "unknown", len);
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (cpuinfo == NULL) return;
+    while (fgets(line, sizeof(line), cpuinfo) != NULL) {
+        if (strncmp(line, "model name", 10) == 0 || strncmp(line, "CPU part", 8) == 0) {
+            char *value = strchr(line, ':');
+            if (value == NULL) continue;
+            value++;
+            while (*value == ' ' || *value == '\t') value++;
+            value[strcspn(value, "\n")] = '\0';
+            strncpy(model, value, len - 1);
+            model[len - 1] = '\0';
+            break;
+        }
+    }
+
+    fclose(cpuinfo);
+}
+
+void results_init(const char *tool, int format, const char *timer) {
+    resultsTool = tool;
+    hostTimer = timer;
+    resultsFormat = format;
+    strcpy(hostName, "unknown");
+    strcpy(hostKernel, "unknown");
+#ifndef _WIN32
+    struct utsname uts;
+    gethostname(hostName, sizeof(hostName) - 1);
+    if (uname(&uts) == 0) snprintf(hostKernel, sizeof(hostKernel), "%s %s %s", uts.sysname, uts.release, uts.machine);
+    hostCpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    if (getenv("COMPUTERNAME")) strncpy(hostName, getenv("COMPUTERNAME"), sizeof(hostName) - 1);
+    strcpy(hostKernel, "Windows");
+    if (getenv("NUMBER_OF_PROCESSORS")) hostCpuCount = atol(getenv("NUMBER_OF_PROCESSORS"));
+#endif
+    read_cpu_model(hostCpu, sizeof(hostCpu));
+}
+
+void results_new_record(struct result_record *record, const char *test, const char *metric, double value) {
+    memset(record, 0, sizeof(struct result_record));
+    record->test = test;
+    record->metric = metric;
+    record->value = value;
+    record->threads = 1;
+}
+
+void results_add_param(struct result_record *record, const char *name, double value) {
+    if (record->paramCount == RESULTS_MAX_PARAMS) return;
+    record->paramNames[record->paramCount] = name;
+    record->paramValues[record->paramCount] = value;
+    record->paramCount++;
+}
+
+void results_add_counter(struct result_record *record, const char *name, uint64_t value) {
+    if (record->counterCount == RESULTS_MAX_COUNTERS) return;
+    record->counterNames[record->counterCount] = name;
+    record->counterValues[record->counterCount] = value;
+    record->counterCount++;
+}
+
+void print_json_string(const char *str) {
+    if (str == NULL) {
+        printf("null");
+        return;
+    }
+
+    putchar('"');
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') printf("\\%c", *c);
+        else if ((unsigned char)*c < 0x20) printf("\\u%04x", *c);
+        else putchar(*c);
+    }
+
+    putchar('"');
+}
+
+// csv fields get quoted if they could break the row
+void print_csv_string(const char *str) {
+    if (str == NULL) return;
+    if (strpbrk(str, ",\"\n") == NULL) {
+        printf("%s", str);
+        return;
+    }
+
+    putchar('"');
+    for (const char *c = str; *c; c++) {
+        if (*c == '"') putchar('"');
+        putchar(*c);
+    }
+
+    putchar('"');
+}
+
+// nan and inf aren't valid JSON, so failed points and empty ratios come out as null
+void print_json_float(double value) {
+    if (isfinite(value)) printf("%f", value);
+    else printf("null");
+}
+
+// and as an empty field in csv
+void print_csv_float(double value) {
+    if (isfinite(value)) printf("%f", value);
+}
+
+// name=value;name=value list for the csv params column
+void format_csv_params(struct result_record *record, char *field, size_t len) {
+    size_t used = 0;
+    field[0] = '\0';
+    for (int i = 0; i < record->paramCount && used < len; i++) {
+        used += snprintf(field + used, len - used, "%s%s=", i ? ";" : "", record->paramNames[i]);
+        if (used < len && isfinite(record->paramValues[i])) used += snprintf(field + used, len - used, "%f", record->paramValues[i]);
+    }
+}
+
+void format_csv_counters(struct result_record *record, char *field, size_t len) {
+    size_t used = 0;
+    field[0] = '\0';
+    for (int i = 0; i < record->counterCount && used < len; i++) {
+        used += snprintf(field + used, len - used, "%s%s=%llu", i ? ";" : "", record->counterNames[i], (unsigned long long)record->counterValues[i]);
+    }
+}
+
+void emit_json(struct result_record *record) {
+    printf("{\"tool\":");
+    print_json_string(resultsTool);
+    printf(",\"test\":");
+    print_json_string(record->test);
+    printf(",\"metric\":");
+    print_json_string(record->metric);
+    printf(",\"value\":");
+    print_json_float(record->value);
+    printf(",\"size_kb\":%llu,\"threads\":%d,\"cpus\":", (unsigned long long)record->sizeKb, record->threads);
+    print_json_string(record->cpus);
+    if (record->stats) {
+        struct sample_stats *stats = record->stats;
+        printf(",\"stats\":{\"trials\":%d,\"converged\":%d,\"min\":", stats->count, stats->converged);
+        print_json_float(stats->min);
+        printf(",\"max\":");
+        print_json_float(stats->max);
+        printf(",\"mean\":");
+        print_json_float(stats->mean);
+        printf(",\"median\":");
+        print_json_float(stats->median);
+        printf(",\"p99\":");
+        print_json_float(stats->p99);
+        printf(",\"stddev\":");
+        print_json_float(stats->stddev);
+        printf(",\"ci\":");
+        print_json_float(stats->ci);
+        putchar('}');
+    }
+
+    if (record->paramCount > 0) {
+        printf(",\"params\":{");
+        for (int i = 0; i < record->paramCount; i++) {
+            if (i) putchar(',');
+            print_json_string(record->paramNames[i]);
+            putchar(':');
+            print_json_float(record->paramValues[i]);
+        }
+
+        putchar('}');
+    }
+
+    if (record->counterCount > 0) {
+        printf(",\"counters\":{");
+        for (int i = 0; i < record->counterCount; i++) {
+            if (i) putchar(',');
+            print_json_string(record->counterNames[i]);
+            printf(":%llu", (unsigned long long)record->counterValues[i]);
+        }
+
+        putchar('}');
+    }
+
+    printf(",\"host\":{\"hostname\":");
+    print_json_string(hostName);
+    printf(",\"kernel\":");
+    print_json_string(hostKernel);
+    printf(",\"cpu\":");
+    print_json_string(hostCpu);
+    printf(",\"logical_cpus\":%ld,\"timer\":", hostCpuCount);
+    print_json_string(hostTimer);
+    printf("},\"timestamp\":%lld}\n", (long long)time(NULL));
+}
+
+// params and counters go in name=value;name=value columns so every tool shares one header
+void emit_csv(struct result_record *record) {
+    char field[4096];
+    if (!resultsHeaderPrinted) {
+        printf("tool,test,metric,value,size_kb,threads,cpus,trials,min,max,mean,median,p99,stddev,ci,params,counters,hostname,kernel,cpu,logical_cpus,timer,timestamp\n");
+        resultsHeaderPrinted = 1;
+    }
+
+    print_csv_string(resultsTool);
+    putchar(',');
+    print_csv_string(record->test);
+    putchar(',');
+    print_csv_string(record->metric);
+    putchar(',');
+    print_csv_float(record->value);
+    printf(",%llu,%d,", (unsigned long long)record->sizeKb, record->threads);
+    print_csv_string(record->cpus);
+    if (record->stats) {
+        struct sample_stats *stats = record->stats;
+        double statValues[7] = { stats->min, stats->max, stats->mean, stats->median, stats->p99, stats->stddev, stats->ci };
+        printf(",%d", stats->count);
+        for (int i = 0; i < 7; i++) {
+            putchar(',');
+            print_csv_float(statValues[i]);
+        }
+
+        putchar(',');
+    } else printf(",1,,,,,,,,");
+
+    // event names like cpu/event=0x2e,umask=0x41/ have commas, so these get quoted like any other string
+    format_csv_params(record, field, sizeof(field));
+    print_csv_string(field);
+    putchar(',');
+    format_csv_counters(record, field, sizeof(field));
+    print_csv_string(field);
+    putchar(',');
+    print_csv_string(hostName);
+    putchar(',');
+    print_csv_string(hostKernel);
+    putchar(',');
+    print_csv_string(hostCpu);
+    printf(",%ld,", hostCpuCount);
+    print_csv_string(hostTimer);
+    printf(",%lld\n", (long long)time(NULL));
+}
+
+void results_emit(struct result_record *record) {
+    if (resultsFormat == RESULTS_FORMAT_JSON) emit_json(record);
+    else if (resultsFormat == RESULTS_FORMAT_CSV) emit_csv(record);
+    fflush(stdout);
+}
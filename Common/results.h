@@ -0,0 +1,41 @@
+#ifndef resultsincluded
+#define resultsincluded
+#include <stdint.h>
+#include "sampling.h"
+
+// Shared result output. RESULTS_FORMAT_DEFAULT leaves each tool's own output alone.
+// JSON emits one JSON Lines record per data point, CSV emits the same fields as flat rows.
+// Either way, each record carries host metadata so runs from different machines can be merged
+#define RESULTS_FORMAT_DEFAULT 0
+#define RESULTS_FORMAT_JSON 1
+#define RESULTS_FORMAT_CSV 2
+
+#define RESULTS_MAX_PARAMS 8
+#define RESULTS_MAX_COUNTERS 32
+
+struct result_record {
+    const char *test;     // test/method name within the tool
+    const char *metric;   // what value is, like latency_ns or bandwidth_gbps
+    double value;
+    uint64_t sizeKb;      // 0 if not applicable
+    int threads;
+    const char *cpus;     // cpu list the test ran on, NULL if not pinned
+    struct sample_stats *stats;  // NULL if only one trial was run
+    int paramCount;
+    const char *paramNames[RESULTS_MAX_PARAMS];
+    double paramValues[RESULTS_MAX_PARAMS];
+    int counterCount;
+    const char *counterNames[RESULTS_MAX_COUNTERS];
+    uint64_t counterValues[RESULTS_MAX_COUNTERS];
+};
+
+extern int resultsFormat;
+
+int results_parse_format(const char *name);
+// timer = how the tool measures time, for the metadata. Usually timing_backend_name()
+void results_init(const char *tool, int format, const char *timer);
+void results_new_record(struct result_record *record, const char *test, const char *metric, double value);
+void results_add_param(struct result_record *record, const char *name, double value);
+void results_add_counter(struct result_record *record, const char *name, uint64_t value);
+void results_emit(struct result_record *record);
+#endif
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sampling.h"
+
+// two-sided 95% t-distribution critical values for 1-30 degrees of freedom. Past that, 1.96 is close enough
+static const float t95[30] = { 12.706f, 4.303f, 3.182f, 2.776f, 2.571f, 2.447f, 2.365f, 2.306f, 2.262f, 2.228f,
+                               2.201f, 2.179f, 2.160f, 2.145f, 2.131f, 2.120f, 2.110f, 2.101f, 2.093f, 2.086f,
+                               2.080f, 2.074f, 2.069f, 2.064f, 2.060f, 2.056f, 2.052f, 2.048f, 2.045f, 2.042f };
+
+void sampling_default_config(struct sampling_config *cfg) {
+    cfg->minTrials = 1;
+    cfg->maxTrials = 1;
+    cfg->targetCi = 0.01f;
+}
+
+static int compare_floats(const void *a, const void *b) {
+    float fa = *(const float *)a, fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// percentile with linear interpolation between closest ranks. sorted must be sorted ascending
+static float percentile(float *sorted, int count, float pct) {
+    float rank = pct * (count - 1);
+    int lower = (int)rank;
+    if (lower >= count - 1) return sorted[count - 1];
+    return sorted[lower] + (rank - lower) * (sorted[lower + 1] - sorted[lower]);
+}
+
+void compute_stats(float *samples, int count, struct sample_stats *stats) {
+    memset(stats, 0, sizeof(struct sample_stats));
+    stats->count = count;
+    if (count == 0) return;
+
+    float *sorted = (float *)malloc(sizeof(float) * count);
+    memcpy(sorted, samples, sizeof(float) * count);
+    qsort(sorted, count, sizeof(float), compare_floats);
+
+    double sum = 0, sumSquaredDiff = 0;
+    for (int i = 0; i < count; i++) sum += sorted[i];
+    stats->mean = sum / count;
+    for (int i = 0; i < count; i++) sumSquaredDiff += (sorted[i] - stats->mean) * (sorted[i] - stats->mean);
+    stats->stddev = count > 1 ? sqrt(sumSquaredDiff / (count - 1)) : 0;
+
+    stats->min = sorted[0];
+    stats->max = sorted[count - 1];
+    stats->median = percentile(sorted, count, 0.5f);
+    stats->p99 = percentile(sorted, count, 0.99f);
+
+    if (count > 1 && stats->mean != 0) {
+        float t = count - 1 <= 30 ? t95[count - 2] : 1.96f;
+        stats->ci = t * stats->stddev / sqrt((double)count) / fabs(stats->mean);
+    }
+
+    free(sorted);
+}
+
+// runs measure(ctx) until the CI target is met or maxTrials is reached
+// returns the median, which is less sensitive to an interrupt or clock dip in one trial than the mean
+float run_sampled(struct sampling_config *cfg, float (*measure)(void *), void *ctx, struct sample_stats *stats) {
+    int maxTrials = cfg->maxTrials < 1 ? 1 : cfg->maxTrials;
+    float *samples = (float *)malloc(sizeof(float) * maxTrials);
+    int count = 0;
+    memset(stats, 0, sizeof(struct sample_stats));
+
+    while (count < maxTrials) {
+        samples[count++] = measure(ctx);
+        if (count < 2 || count < cfg->minTrials) continue;
+        compute_stats(samples, count, stats);
+        if (stats->ci <= cfg->targetCi) {
+            stats->converged = 1;
+            break;
+        }
+    }
+
+    if (!stats->converged) compute_stats(samples, count, stats);
+
+    free(samples);
+    return stats->median;
+}
@@ -0,0 +1,23 @@
+#ifndef samplingincluded
+#define samplingincluded
+
+// Repeat-and-converge sampling. Runs a measurement up to maxTrials times, stopping early
+// once at least minTrials samples are in and the 95% confidence interval of the mean is within
+// targetCi (fraction of the mean, so 0.01 = +/- 1%)
+struct sampling_config {
+    int minTrials;
+    int maxTrials;
+    float targetCi;
+};
+
+struct sample_stats {
+    int count;
+    int converged;   // 1 if the CI target was met before hitting maxTrials
+    float min, max, mean, median, p99, stddev;
+    float ci;        // 95% CI half-width as a fraction of the mean
+};
+
+void sampling_default_config(struct sampling_config *cfg);
+void compute_stats(float *samples, int count, struct sample_stats *stats);
+float run_sampled(struct sampling_config *cfg, float (*measure)(void *), void *ctx, struct sample_stats *stats);
+#endif
@@ -0,0 +1,189 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include "timing.h"
+#include "threadpool.h"
+
+#define SPIN_LIMIT 100000
+
+static inline void cpu_relax() {
+#if defined(__x86_64) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static void spin_barrier_wait(struct spin_barrier *barrier, int *localSense) {
+    *localSense = !*localSense;
+    if (__atomic_add_fetch(&barrier->count, 1, __ATOMIC_ACQ_REL) == barrier->total) {
+        __atomic_store_n(&barrier->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&barrier->sense, *localSense, __ATOMIC_RELEASE);
+    } else {
+        int spins = 0;
+        while (__atomic_load_n(&barrier->sense, __ATOMIC_ACQUIRE) != *localSense) {
+            if (spins < SPIN_LIMIT) {
+                cpu_relax();
+                spins++;
+            } else sched_yield();
+        }
+    }
+}
+
+static void pool_barrier_wait(struct thread_pool *pool, pthread_barrier_t *barrier, int *localSense) {
+    if (pool->spin) spin_barrier_wait(&pool->spinBarrier, localSense);
+    else pthread_barrier_wait(barrier);
+}
+
+static void *pool_worker_thread(void *param) {
+    struct thread_pool_worker *worker = (struct thread_pool_worker *)param;
+    struct thread_pool *pool = worker->pool;
+#ifdef __linux__
+    worker->tid = syscall(SYS_gettid);
+#endif
+    // let pool_create know this worker is up
+    pool_barrier_wait(pool, &pool->readyBarrier, &worker->sense);
+    while (1) {
+        pool_barrier_wait(pool, &pool->startBarrier, &worker->sense);
+        if (pool->exiting) break;
+        int active = worker->index < pool->activeCount;
+        if (active && pool->prep) pool->prep(worker->arg);
+
+        pool_barrier_wait(pool, &pool->readyBarrier, &worker->sense);
+        if (active) {
+            worker->startTicks = read_timer_start();
+            pool->func(worker->arg);
+            worker->endTicks = read_timer_end();
+        }
+
+        // always a blocking barrier, see pool_run
+        pthread_barrier_wait(&pool->doneBarrier);
+    }
+
+    return NULL;
+}
+
+// barriers include the calling thread, so pool_run can't return before workers are done
+struct thread_pool *pool_create(int workerCount, const int *cores, int spin) {
+    struct thread_pool *pool = (struct thread_pool *)malloc(sizeof(struct thread_pool));
+    memset(pool, 0, sizeof(struct thread_pool));
+    pool->workerCount = workerCount;
+    pool->spin = spin;
+    pool->spinBarrier.total = workerCount + 1;
+    pool->workers = (struct thread_pool_worker *)malloc(sizeof(struct thread_pool_worker) * workerCount);
+    memset(pool->workers, 0, sizeof(struct thread_pool_worker) * workerCount);
+    pthread_barrier_init(&pool->startBarrier, NULL, workerCount + 1);
+    pthread_barrier_init(&pool->readyBarrier, NULL, workerCount + 1);
+    pthread_barrier_init(&pool->doneBarrier, NULL, workerCount + 1);
+    for (int i = 0; i < workerCount; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pool->workers[i].core = cores ? cores[i] : -1;
+
+        // pin at creation so the worker never runs anywhere else
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+#ifdef __linux__
+        if (pool->workers[i].core >= 0) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(pool->workers[i].core, &cpuset);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        }
+#endif
+        int rc = pthread_create(&pool->workers[i].handle, &attr, pool_worker_thread, pool->workers + i);
+        pthread_attr_destroy(&attr);
+
+        // core isn't in our allowed cpuset (taskset, cgroups). run unpinned instead of giving up
+        if (rc != 0 && pool->workers[i].core >= 0) {
+            fprintf(stderr, "Could not pin pool thread %d to core %d, leaving it unpinned\n", i, pool->workers[i].core);
+            pool->workers[i].core = -1;
+            rc = pthread_create(&pool->workers[i].handle, NULL, pool_worker_thread, pool->workers + i);
+        }
+
+        if (rc != 0) {
+            fprintf(stderr, "Could not create pool thread %d (core %d)\n", i, pool->workers[i].core);
+            exit(1);
+        }
+    }
+
+    pool_barrier_wait(pool, &pool->readyBarrier, &pool->mainSense);
+    return pool;
+}
+
+void pool_destroy(struct thread_pool *pool) {
+    pool->exiting = 1;
+    pool_barrier_wait(pool, &pool->startBarrier, &pool->mainSense);
+    for (int i = 0; i < pool->workerCount; i++) pthread_join(pool->workers[i].handle, NULL);
+    pthread_barrier_destroy(&pool->startBarrier);
+    pthread_barrier_destroy(&pool->readyBarrier);
+    pthread_barrier_destroy(&pool->doneBarrier);
+    free(pool->workers);
+    free(pool);
+}
+
+// runs func on the first activeCount workers. Worker i gets (char *)args + i * argSize
+// prep runs before the start barrier and is not included in worker timestamps
+void pool_run(struct thread_pool *pool, int activeCount, void (*prep)(void *), void (*func)(void *), void *args, size_t argSize) {
+    if (activeCount > pool->workerCount) {
+        fprintf(stderr, "Asked for %d threads but pool only has %d\n", activeCount, pool->workerCount);
+        activeCount = pool->workerCount;
+    }
+
+    pool->activeCount = activeCount;
+    pool->prep = prep;
+    pool->func = func;
+    for (int i = 0; i < activeCount; i++) pool->workers[i].arg = (char *)args + i * argSize;
+    pool_barrier_wait(pool, &pool->startBarrier, &pool->mainSense);
+    pool_barrier_wait(pool, &pool->readyBarrier, &pool->mainSense);
+
+    // the calling thread usually isn't pinned, so it sleeps through the timed run instead of
+    // spinning and competing with workers for a core. only workers spin, on start and ready
+    pthread_barrier_wait(&pool->doneBarrier);
+}
+
+uint64_t pool_worker_time_ns(struct thread_pool *pool, int workerIdx) {
+    struct thread_pool_worker *worker = pool->workers + workerIdx;
+    return timer_ticks_to_ns(worker->endTicks - worker->startTicks);
+}
+
+// time from the first worker starting to the last one finishing
+uint64_t pool_span_ns(struct thread_pool *pool) {
+    uint64_t firstStart = UINT64_MAX, lastEnd = 0;
+    for (int i = 0; i < pool->activeCount; i++) {
+        if (pool->workers[i].startTicks < firstStart) firstStart = pool->workers[i].startTicks;
+        if (pool->workers[i].endTicks > lastEnd) lastEnd = pool->workers[i].endTicks;
+    }
+
+    return lastEnd > firstStart ? timer_ticks_to_ns(lastEnd - firstStart) : 0;
+}
+
+// time from the first worker starting to the last one starting
+uint64_t pool_start_skew_ns(struct thread_pool *pool) {
+    uint64_t firstStart = UINT64_MAX, lastStart = 0;
+    for (int i = 0; i < pool->activeCount; i++) {
+        if (pool->workers[i].startTicks < firstStart) firstStart = pool->workers[i].startTicks;
+        if (pool->workers[i].startTicks > lastStart) lastStart = pool->workers[i].startTicks;
+    }
+
+    return lastStart > firstStart ? timer_ticks_to_ns(lastStart - firstStart) : 0;
+}
+
+// time from the first worker finishing to the last one finishing
+uint64_t pool_end_skew_ns(struct thread_pool *pool) {
+    uint64_t firstEnd = UINT64_MAX, lastEnd = 0;
+    for (int i = 0; i < pool->activeCount; i++) {
+        if (pool->workers[i].endTicks < firstEnd) firstEnd = pool->workers[i].endTicks;
+        if (pool->workers[i].endTicks > lastEnd) lastEnd = pool->workers[i].endTicks;
+    }
+
+    return lastEnd > firstEnd ? timer_ticks_to_ns(lastEnd - firstEnd) : 0;
+}
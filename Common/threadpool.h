@@ -0,0 +1,56 @@
+#ifndef threadpoolincluded
+#define threadpoolincluded
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Persistent worker pool, so thread creation stays out of timed regions.
+// Each dispatch runs prep(arg) on every active worker, lines everyone up on a barrier,
+// then runs func(arg) with start/end timestamps taken around it on the worker itself
+struct thread_pool;
+
+// sense-reversing barrier that never sleeps in the kernel, for tighter start alignment
+// between workers. falls back to sched_yield after a while so idle pools don't starve
+// other threads sharing a core
+struct spin_barrier {
+    volatile int count;
+    volatile int sense;
+    int total;
+};
+
+struct thread_pool_worker {
+    pthread_t handle;
+    struct thread_pool *pool;
+    int index;
+    int core;  // -1 = not pinned
+    int tid;   // kernel thread id on linux, for attaching per-thread counters
+    int sense; // local sense for spin barrier
+    void *arg;
+    uint64_t startTicks;  // raw timer ticks, see timer_ticks_to_ns
+    uint64_t endTicks;
+};
+
+struct thread_pool {
+    int workerCount;
+    int activeCount;
+    int exiting;
+    int spin;
+    int mainSense;
+    struct spin_barrier spinBarrier;
+    void (*prep)(void *);
+    void (*func)(void *);
+    pthread_barrier_t startBarrier, readyBarrier, doneBarrier;
+    struct thread_pool_worker *workers;
+};
+
+// cores = core to pin each worker to before it starts, or NULL to leave affinity alone
+// spin = workers use spin barriers to start instead of pthread barriers. finishing always blocks,
+// so the unpinned caller doesn't spin during the timed run
+struct thread_pool *pool_create(int workerCount, const int *cores, int spin);
+void pool_destroy(struct thread_pool *pool);
+void pool_run(struct thread_pool *pool, int activeCount, void (*prep)(void *), void (*func)(void *), void *args, size_t argSize);
+uint64_t pool_worker_time_ns(struct thread_pool *pool, int workerIdx);
+uint64_t pool_span_ns(struct thread_pool *pool);
+uint64_t pool_start_skew_ns(struct thread_pool *pool);
+uint64_t pool_end_skew_ns(struct thread_pool *pool);
+#endif
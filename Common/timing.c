@@ -1,3 +1,8 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "timing.h"
+
 #ifdef _MSC_VER
 #include <sys\timeb.h>
 __declspec(selectany) struct timeb start, end;
@@ -49,3 +54,190 @@ unsigned long long scale_iterations_to_target(unsigned long long last_iteration_
   if (last_time < 50) return last_iteration_count * 2;
   return last_iteration_count * (target_time / last_time);
 }
+
+// Nanosecond timing backends
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#define TIMING_X86 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define TIMING_X86 1
+#endif
+
+#ifndef CLOCK_MONOTONIC_RAW
+#define CLOCK_MONOTONIC_RAW CLOCK_MONOTONIC
+#endif
+
+static int timingBackend = TIMING_CLOCK;
+static double nsPerTick = 1.0;
+static uint64_t timerOverheadTicks = 0;
+
+static uint64_t read_clock_ns() {
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000ULL +
+        (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000ULL / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// lfence before rdtsc keeps earlier instructions from leaking past the start timestamp.
+// rdtscp waits for earlier instructions to finish, and the lfence after it keeps later ones
+// from starting before the end timestamp is taken
+static uint64_t read_tsc_start() {
+#if defined(_MSC_VER) && defined(TIMING_X86)
+    _mm_lfence();
+    return __rdtsc();
+#elif defined(TIMING_X86)
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("lfence\n\trdtsc" : "=a" (lo), "=d" (hi) : : "memory");
+    return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t cnt;
+    __asm__ __volatile__ ("isb\n\tmrs %0, cntvct_el0" : "=r" (cnt) : : "memory");
+    return cnt;
+#else
+    return read_clock_ns();
+#endif
+}
+
+static uint64_t read_tsc_end() {
+#if defined(_MSC_VER) && defined(TIMING_X86)
+    unsigned int aux;
+    uint64_t tsc = __rdtscp(&aux);
+    _mm_lfence();
+    return tsc;
+#elif defined(TIMING_X86)
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("rdtscp\n\tlfence" : "=a" (lo), "=d" (hi) : : "ecx", "memory");
+    return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t cnt;
+    __asm__ __volatile__ ("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r" (cnt) : : "memory");
+    return cnt;
+#else
+    return read_clock_ns();
+#endif
+}
+
+// returns 1 if a usable cycle counter exists. On x86 that means an invariant TSC and rdtscp,
+// otherwise the TSC may change rate with clock speed or stop in deep C-states
+static int tsc_usable() {
+#if defined(_MSC_VER) && defined(TIMING_X86)
+    int cpuidData[4];
+    __cpuid(cpuidData, 0x80000000);
+    if ((unsigned int)cpuidData[0] < 0x80000007) return 0;
+    __cpuid(cpuidData, 0x80000001);
+    if (!(cpuidData[3] & (1 << 27))) return 0;
+    __cpuid(cpuidData, 0x80000007);
+    return (cpuidData[3] >> 8) & 1;
+#elif defined(TIMING_X86)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007) return 0;
+    __cpuid(0x80000001, eax, ebx, ecx, edx);
+    if (!(edx & (1 << 27))) return 0;  // rdtscp
+    __cpuid(0x80000007, eax, ebx, ecx, edx);
+    return (edx >> 8) & 1;             // invariant TSC
+#elif defined(__aarch64__)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+uint64_t read_timer_start() {
+    if (timingBackend == TIMING_TSC) return read_tsc_start();
+    return read_clock_ns();
+}
+
+uint64_t read_timer_end() {
+    if (timingBackend == TIMING_TSC) return read_tsc_end();
+    return read_clock_ns();
+}
+
+uint64_t timer_ticks_to_ns(uint64_t ticks) {
+    return (uint64_t)((double)ticks * nsPerTick);
+}
+
+// Picks a backend, works out ns per tick, and measures back-to-back read overhead so
+// end_timing_ns can subtract it. Returns the backend actually selected
+int timing_init(int backend) {
+    if (backend == TIMING_AUTO) backend = tsc_usable() ? TIMING_TSC : TIMING_CLOCK;
+    if (backend == TIMING_TSC && !tsc_usable()) {
+        fprintf(stderr, "No invariant cycle counter, falling back to clock timing\n");
+        backend = TIMING_CLOCK;
+    }
+
+    timingBackend = backend;
+    nsPerTick = 1.0;
+    if (backend == TIMING_TSC) {
+#ifdef __aarch64__
+        uint64_t cntfrq;
+        __asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (cntfrq));
+        nsPerTick = 1e9 / (double)cntfrq;
+#else
+        // calibrate against the clock over ~20 ms
+        uint64_t clockStart = read_clock_ns(), tscStart = read_tsc_start();
+        uint64_t clockEnd, tscEnd;
+        do {
+            clockEnd = read_clock_ns();
+            tscEnd = read_tsc_end();
+        } while (clockEnd - clockStart < 20000000ULL);
+        nsPerTick = (double)(clockEnd - clockStart) / (double)(tscEnd - tscStart);
+#endif
+    }
+
+    // take the minimum because that's what a timed region with nothing in it would see
+    timerOverheadTicks = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t startTicks = read_timer_start();
+        uint64_t endTicks = read_timer_end();
+        if (endTicks - startTicks < timerOverheadTicks) timerOverheadTicks = endTicks - startTicks;
+    }
+
+    fprintf(stderr, "Timing with %s, %f ns per tick, %llu ns overhead\n",
+        timing_backend_name(), nsPerTick, (unsigned long long)timer_ticks_to_ns(timerOverheadTicks));
+    return backend;
+}
+
+int timing_parse_backend(const char *name) {
+    if (strncmp(name, "tsc", 3) == 0) return TIMING_TSC;
+    if (strncmp(name, "clock", 5) == 0) return TIMING_CLOCK;
+    return TIMING_AUTO;
+}
+
+const char *timing_backend_name() {
+#ifdef __aarch64__
+    if (timingBackend == TIMING_TSC) return "cntvct_el0";
+#else
+    if (timingBackend == TIMING_TSC) return "rdtsc";
+#endif
+#ifdef _WIN32
+    return "QueryPerformanceCounter";
+#else
+    return "CLOCK_MONOTONIC_RAW";
+#endif
+}
+
+void start_timing_ns(uint64_t *startTicks) {
+    *startTicks = read_timer_start();
+}
+
+// returns elapsed ns since start_timing_ns, with timer overhead subtracted
+uint64_t end_timing_ns(uint64_t *startTicks) {
+    uint64_t elapsedTicks = read_timer_end() - *startTicks;
+    if (elapsedTicks > timerOverheadTicks) elapsedTicks -= timerOverheadTicks;
+    else elapsedTicks = 0;
+    return timer_ticks_to_ns(elapsedTicks);
+}
@@ -1,13 +1,14 @@
 #ifndef timingincluded
 #define timingincluded
+#include <stdint.h>
 #ifdef _MSC_VER
 #include <sys\timeb.h>
 #else
 #include <sys/time.h>
 #endif
 extern struct timeb start, end;
-inline void start_timing();
-inline unsigned int end_timing();
+void start_timing();
+unsigned int end_timing();
 
 #ifdef _MSC_VER
 void start_timing_ts(struct timeb* startTimeb);
@@ -16,5 +17,22 @@ unsigned int end_timing_ts(struct timeb* startTimeb);
 void start_timing_ts(struct timeval* start);
 unsigned int end_timing_ts(struct timeval* start);
 #endif
-unsigned long long scale_iterations_to_target(unsigned long long last_iteration_count, float last_time, float target_time);
-#endif
+unsigned long long scale_iterations_to_target(unsigned long long last_iteration_count, float last_time, float target_time);
+
+// Nanosecond timing. Call timing_init once before using start_timing_ns/end_timing_ns
+// TIMING_CLOCK = clock_gettime(CLOCK_MONOTONIC_RAW), or QueryPerformanceCounter on Windows
+// TIMING_TSC = rdtsc/rdtscp on x86, cntvct_el0 on aarch64. Calibrated against TIMING_CLOCK
+// TIMING_AUTO = TSC if it's invariant, otherwise clock
+#define TIMING_AUTO -1
+#define TIMING_CLOCK 0
+#define TIMING_TSC 1
+
+int timing_init(int backend);
+int timing_parse_backend(const char *name);
+const char *timing_backend_name();
+uint64_t read_timer_start();
+uint64_t read_timer_end();
+uint64_t timer_ticks_to_ns(uint64_t ticks);
+void start_timing_ns(uint64_t *startTicks);
+uint64_t end_timing_ns(uint64_t *startTicks);
+#endif
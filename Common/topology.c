@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "topology.h"
+
+#define SYSFS_CPU_PATH "/sys/devices/system/cpu"
+
+static int read_sysfs_line(const char *path, char *buf, int len) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return 0;
+    if (fgets(buf, len, f) == NULL) buf[0] = '\0';
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 1;
+}
+
+static int read_sysfs_int(const char *path, int fallback) {
+    char buf[64];
+    if (!read_sysfs_line(path, buf, sizeof(buf)) || buf[0] == '\0') return fallback;
+    return atoi(buf);
+}
+
+// walks a cpu list like "0-3,8-11". returns 1 if cpu is in it, and sets lowest and how many
+// listed cpus are below cpu
+static int parse_cpulist(const char *list, int cpu, int *lowest, int *countBelow) {
+    int found = 0;
+    *lowest = -1;
+    *countBelow = 0;
+    while (*list) {
+        char *end;
+        int lo = strtol(list, &end, 10), hi = lo;
+        if (end == list) break;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        if (*lowest < 0 || lo < *lowest) *lowest = lo;
+        if (cpu >= lo && cpu <= hi) found = 1;
+        if (cpu > lo) *countBelow += (cpu > hi ? hi : cpu - 1) - lo + 1;
+        if (*end != ',') break;
+        list = end + 1;
+    }
+
+    return found;
+}
+
+int topology_init(struct cpu_topology *topo) {
+    char path[512], list[4096];
+    int lowest, countBelow;
+    memset(topo, 0, sizeof(struct cpu_topology));
+    topo->cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+    if (topo->cpuCount < 1) topo->cpuCount = 1;
+    topo->cpus = (struct cpu_topology_entry *)malloc(sizeof(struct cpu_topology_entry) * topo->cpuCount);
+
+    int haveOnlineList = read_sysfs_line(SYSFS_CPU_PATH "/online", list, sizeof(list));
+    for (int cpu = 0; cpu < topo->cpuCount; cpu++) {
+        struct cpu_topology_entry *entry = topo->cpus + cpu;
+        entry->cpu = cpu;
+        entry->online = haveOnlineList ? parse_cpulist(list, cpu, &lowest, &countBelow) : 1;
+    }
+
+    for (int cpu = 0; cpu < topo->cpuCount; cpu++) {
+        struct cpu_topology_entry *entry = topo->cpus + cpu;
+        snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/topology/core_id", cpu);
+        entry->coreId = read_sysfs_int(path, cpu);
+        snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/topology/cluster_id", cpu);
+        entry->clusterId = read_sysfs_int(path, -1);
+        snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/topology/die_id", cpu);
+        entry->dieId = read_sysfs_int(path, 0);
+        snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/topology/physical_package_id", cpu);
+        entry->packageId = read_sysfs_int(path, 0);
+        snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/cpu_capacity", cpu);
+        entry->capacity = read_sysfs_int(path, 1024);
+
+        entry->physicalCore = cpu;
+        entry->smtIndex = 0;
+        snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/topology/thread_siblings_list", cpu);
+        if (read_sysfs_line(path, list, sizeof(list)) && parse_cpulist(list, cpu, &lowest, &countBelow)) {
+            entry->physicalCore = lowest;
+            entry->smtIndex = countBelow;
+        }
+
+        // highest cache level with a shared_cpu_list is the LLC
+        int llcLevel = 0;
+        entry->l3Domain = -1;
+        for (int cacheIdx = 0; cacheIdx < 16; cacheIdx++) {
+            snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/cache/index%d/level", cpu, cacheIdx);
+            int level = read_sysfs_int(path, -1);
+            if (level < 0) break;
+            if (level < llcLevel) continue;
+            snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d/cache/index%d/shared_cpu_list", cpu, cacheIdx);
+            if (read_sysfs_line(path, list, sizeof(list)) && parse_cpulist(list, cpu, &lowest, &countBelow)) {
+                llcLevel = level;
+                entry->l3Domain = lowest;
+            }
+        }
+
+        // no cache info, so assume everything in a package shares a domain. fixed up below
+        if (entry->l3Domain < 0) entry->l3Domain = -2 - entry->packageId;
+
+        entry->numaNode = 0;
+        snprintf(path, sizeof(path), SYSFS_CPU_PATH "/cpu%d", cpu);
+        DIR *cpuDir = opendir(path);
+        if (cpuDir != NULL) {
+            struct dirent *dirEntry;
+            while ((dirEntry = readdir(cpuDir)) != NULL) {
+                if (strncmp(dirEntry->d_name, "node", 4) == 0 && dirEntry->d_name[4] >= '0' && dirEntry->d_name[4] <= '9') {
+                    entry->numaNode = atoi(dirEntry->d_name + 4);
+                    break;
+                }
+            }
+
+            closedir(cpuDir);
+        }
+    }
+
+    for (int cpu = 0; cpu < topo->cpuCount; cpu++) {
+        struct cpu_topology_entry *entry = topo->cpus + cpu;
+        if (entry->l3Domain < -1) {
+            for (int other = 0; other < topo->cpuCount; other++) {
+                if (topo->cpus[other].packageId == entry->packageId) {
+                    entry->l3Domain = other;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int cpu = 0; cpu < topo->cpuCount; cpu++) {
+        struct cpu_topology_entry *entry = topo->cpus + cpu;
+        if (!entry->online) continue;
+        if (entry->smtIndex == 0) topo->physicalCoreCount++;
+        if (entry->l3Domain == cpu || topo->cpus[entry->l3Domain].l3Domain != entry->l3Domain || !topo->cpus[entry->l3Domain].online) {
+            // count each domain once, at its lowest online cpu
+            int firstOnline = 1;
+            for (int other = 0; other < cpu; other++) {
+                if (topo->cpus[other].online && topo->cpus[other].l3Domain == entry->l3Domain) firstOnline = 0;
+            }
+
+            topo->l3DomainCount += firstOnline;
+        }
+
+        if (entry->numaNode >= topo->numaNodeCount) topo->numaNodeCount = entry->numaNode + 1;
+    }
+
+    return topo->cpuCount;
+}
+
+void topology_free(struct cpu_topology *topo) {
+    free(topo->cpus);
+    topo->cpus = NULL;
+    topo->cpuCount = 0;
+}
+
+void topology_print(struct cpu_topology *topo) {
+    fprintf(stderr, "%d CPUs, %d physical cores, %d L3 domains, %d NUMA nodes\n",
+        topo->cpuCount, topo->physicalCoreCount, topo->l3DomainCount, topo->numaNodeCount);
+    fprintf(stderr, "CPU\tCore\tCluster\tDie\tPackage\tSMT\tL3\tNode\tCapacity\n");
+    for (int cpu = 0; cpu < topo->cpuCount; cpu++) {
+        struct cpu_topology_entry *entry = topo->cpus + cpu;
+        if (!entry->online) {
+            fprintf(stderr, "%d\toffline\n", cpu);
+            continue;
+        }
+
+        fprintf(stderr, "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n", cpu, entry->coreId, entry->clusterId, entry->dieId,
+            entry->packageId, entry->smtIndex, entry->l3Domain, entry->numaNode, entry->capacity);
+    }
+}
+
+int topology_parse_mode(const char *name) {
+    if (strncmp(name, "linear", 6) == 0) return TOPOLOGY_LINEAR;
+    if (strncmp(name, "physical", 8) == 0) return TOPOLOGY_PHYSICAL;
+    if (strncmp(name, "l3fill", 6) == 0) return TOPOLOGY_L3FILL;
+    if (strncmp(name, "l3spread", 8) == 0) return TOPOLOGY_L3SPREAD;
+    if (strncmp(name, "bigfirst", 8) == 0) return TOPOLOGY_BIGFIRST;
+    fprintf(stderr, "Unrecognized core selection %s. Valid options: linear, physical, l3fill, l3spread, bigfirst\n", name);
+    return TOPOLOGY_INVALID;
+}
+
+int topology_parse_pairs(const char *name) {
+    if (strncmp(name, "all", 3) == 0) return TOPOLOGY_PAIRS_ALL;
+    if (strncmp(name, "physical", 8) == 0) return TOPOLOGY_PAIRS_PHYSICAL;
+    if (strncmp(name, "l3", 2) == 0) return TOPOLOGY_PAIRS_L3;
+    fprintf(stderr, "Unrecognized pair selection %s. Valid options: all, physical, l3\n", name);
+    return TOPOLOGY_INVALID;
+}
+
+// sort keys, compared in order
+struct cpu_sort_entry {
+    int key[4];
+};
+
+static int compare_sort_entries(const void *a, const void *b) {
+    const struct cpu_sort_entry *entryA = (const struct cpu_sort_entry *)a, *entryB = (const struct cpu_sort_entry *)b;
+    for (int i = 0; i < 4; i++) {
+        if (entryA->key[i] != entryB->key[i]) return entryA->key[i] < entryB->key[i] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+// fills selected with up to maxCount online cpus in the order given by mode, skipping excludeCpu (-1 for none).
+// returns how many were selected
+int topology_select_cpus(struct cpu_topology *topo, int mode, int excludeCpu, int *selected, int maxCount) {
+    struct cpu_sort_entry *candidates = (struct cpu_sort_entry *)malloc(sizeof(struct cpu_sort_entry) * topo->cpuCount);
+    int candidateCount = 0;
+    for (int cpu = 0; cpu < topo->cpuCount; cpu++) {
+        struct cpu_topology_entry *entry = topo->cpus + cpu;
+        if (!entry->online || cpu == excludeCpu) continue;
+
+        // position among cpus in the same L3 domain at the same SMT level, for round robin
+        int domainRank = 0;
+        for (int other = 0; other < cpu; other++) {
+            struct cpu_topology_entry *otherEntry = topo->cpus + other;
+            if (otherEntry->online && other != excludeCpu && otherEntry->l3Domain == entry->l3Domain && otherEntry->smtIndex == entry->smtIndex) domainRank++;
+        }
+
+        struct cpu_sort_entry *candidate = candidates + candidateCount;
+        candidate->key[3] = cpu;
+        if (mode == TOPOLOGY_PHYSICAL) {
+            candidate->key[0] = entry->smtIndex;
+            candidate->key[1] = candidate->key[2] = 0;
+        } else if (mode == TOPOLOGY_L3FILL) {
+            candidate->key[0] = entry->smtIndex;
+            candidate->key[1] = entry->l3Domain;
+            candidate->key[2] = 0;
+        } else if (mode == TOPOLOGY_L3SPREAD) {
+            candidate->key[0] = entry->smtIndex;
+            candidate->key[1] = domainRank;
+            candidate->key[2] = entry->l3Domain;
+        } else if (mode == TOPOLOGY_BIGFIRST) {
+            candidate->key[0] = entry->smtIndex;
+            candidate->key[1] = -entry->capacity;
+            candidate->key[2] = 0;
+        } else {
+            candidate->key[0] = candidate->key[1] = candidate->key[2] = 0;
+        }
+
+        candidateCount++;
+    }
+
+    qsort(candidates, candidateCount, sizeof(struct cpu_sort_entry), compare_sort_entries);
+    int selectedCount = candidateCount < maxCount ? candidateCount : maxCount;
+    for (int i = 0; i < selectedCount; i++) selected[i] = candidates[i].key[3];
+    free(candidates);
+    return selectedCount;
+}
+
+static void select_pair(char *selected, int cpuCount, int a, int b) {
+    selected[b + a * cpuCount] = 1;
+    selected[a + b * cpuCount] = 1;
+}
+
+// selected is cpuCount * cpuCount, with selected[j + i * cpuCount] set if i -> j should be tested.
+// returns how many directed pairs were selected
+int topology_select_pairs(struct cpu_topology *topo, int mode, char *selected) {
+    int n = topo->cpuCount, selectedCount = 0;
+    memset(selected, 0, n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (i == j || !topo->cpus[i].online || !topo->cpus[j].online) continue;
+            if (mode == TOPOLOGY_PAIRS_ALL) selected[j + i * n] = 1;
+            else if (mode == TOPOLOGY_PAIRS_PHYSICAL && topo->cpus[i].smtIndex == 0 && topo->cpus[j].smtIndex == 0) selected[j + i * n] = 1;
+        }
+    }
+
+    if (mode == TOPOLOGY_PAIRS_L3) {
+        for (int a = 0; a < n; a++) {
+            struct cpu_topology_entry *entryA = topo->cpus + a;
+            if (!entryA->online || entryA->smtIndex != 0) continue;
+
+            // is this the first physical core in its domain?
+            int firstInDomain = 1;
+            for (int other = 0; other < a; other++) {
+                if (topo->cpus[other].online && topo->cpus[other].smtIndex == 0 && topo->cpus[other].l3Domain == entryA->l3Domain) firstInDomain = 0;
+            }
+
+            if (!firstInDomain) continue;
+
+            int intraDone = 0, smtDone = 0;
+            for (int b = a + 1; b < n; b++) {
+                struct cpu_topology_entry *entryB = topo->cpus + b;
+                if (!entryB->online) continue;
+                if (!smtDone && entryB->physicalCore == a) {
+                    select_pair(selected, n, a, b);
+                    smtDone = 1;
+                } else if (!intraDone && entryB->smtIndex == 0 && entryB->l3Domain == entryA->l3Domain) {
+                    select_pair(selected, n, a, b);
+                    intraDone = 1;
+                } else if (entryB->smtIndex == 0 && entryB->l3Domain != entryA->l3Domain) {
+                    // first physical core of another domain
+                    int bFirst = 1;
+                    for (int other = 0; other < b; other++) {
+                        if (topo->cpus[other].online && topo->cpus[other].smtIndex == 0 && topo->cpus[other].l3Domain == entryB->l3Domain) bFirst = 0;
+                    }
+
+                    if (bFirst) select_pair(selected, n, a, b);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < n * n; i++) selectedCount += selected[i];
+    return selectedCount;
+}
@@ -0,0 +1,48 @@
+#ifndef topologyincluded
+#define topologyincluded
+
+// Host topology from /sys/devices/system/cpu, so tools can pick cores by physical core,
+// SMT sibling, L3 domain or NUMA node instead of assuming linear numbering
+struct cpu_topology_entry {
+    int cpu;
+    int online;
+    int coreId;       // core_id, only unique within a die/package
+    int clusterId;    // -1 if the kernel doesn't report it
+    int dieId;
+    int packageId;
+    int physicalCore; // lowest cpu among thread siblings, unique across the system
+    int smtIndex;     // 0 for the first thread on a physical core, 1 for the next...
+    int l3Domain;     // lowest cpu sharing the last level cache
+    int numaNode;
+    int capacity;     // cpu_capacity on arm big.LITTLE, 1024 if not reported
+};
+
+struct cpu_topology {
+    int cpuCount;
+    int physicalCoreCount;
+    int l3DomainCount;
+    int numaNodeCount;
+    struct cpu_topology_entry *cpus;
+};
+
+// selection orders for topology_select_cpus
+#define TOPOLOGY_LINEAR 0     // cpu number order
+#define TOPOLOGY_PHYSICAL 1   // one thread per physical core first, then SMT siblings
+#define TOPOLOGY_L3FILL 2     // fill one L3 domain (CCX) with physical cores, then the next
+#define TOPOLOGY_L3SPREAD 3   // round robin physical cores across L3 domains
+#define TOPOLOGY_BIGFIRST 4   // highest cpu_capacity first, physical cores before SMT siblings
+#define TOPOLOGY_INVALID -1
+
+// pair selections for topology_select_pairs
+#define TOPOLOGY_PAIRS_ALL 0
+#define TOPOLOGY_PAIRS_PHYSICAL 1 // every pair of physical cores, skipping SMT siblings
+#define TOPOLOGY_PAIRS_L3 2       // one pair within each L3 domain, an SMT pair, and one pair between each two domains
+
+int topology_init(struct cpu_topology *topo);
+void topology_free(struct cpu_topology *topo);
+void topology_print(struct cpu_topology *topo);
+int topology_parse_mode(const char *name);
+int topology_parse_pairs(const char *name);
+int topology_select_cpus(struct cpu_topology *topo, int mode, int excludeCpu, int *selected, int maxCount);
+int topology_select_pairs(struct cpu_topology *topo, int mode, char *selected);
+#endif
@@ -5,22 +5,10 @@ cl_platform_id selected_platform_id;
 cl_ulong max_global_test_size;
 int saveprogram = 0;
 
-// Fills an array using Sattolo's algo
+// Fills an array with a single random cycle, see Common/chain.c
 void FillPatternArr(uint32_t* pattern_arr, uint32_t list_size, uint32_t byte_increment) {
     uint32_t increment = byte_increment / sizeof(uint32_t);
-    uint32_t element_count = list_size / increment;
-    for (int i = 0; i < element_count; i++) {
-        pattern_arr[i * increment] = i * increment;
-    }
-
-    int iter = element_count;
-    while (iter > 1) {
-        iter -= 1;
-        int j = iter - 1 == 0 ? 0 : rand() % (iter - 1);
-        uint32_t tmp = pattern_arr[iter * increment];
-        pattern_arr[iter * increment] = pattern_arr[j * increment];
-        pattern_arr[j * increment] = tmp;
-    }
+    chain_fill32(pattern_arr, list_size / increment, increment, 0);
 }
 
 cl_uint getCuCount() {
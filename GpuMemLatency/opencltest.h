@@ -8,6 +8,7 @@
 #include <string.h>
 #include <math.h>
 #include "../Common/timing.h"
+#include "../Common/chain.h"
 
 #define false 0
 #define true 1
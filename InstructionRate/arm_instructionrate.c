@@ -9,6 +9,7 @@
 #include <sched.h>
 #include <pthread.h>
 #include <string.h>
+#include "../Common/perfmon.h"
 
 extern uint64_t noptest(uint64_t iterations);
 extern uint64_t clktest(uint64_t iterations);
@@ -124,7 +125,7 @@ uint64_t mixaesevecadd128wrapper(uint64_t iterations);
 uint64_t pmullwrapper(uint64_t iterations);
 uint64_t mixpmulladd128wrapper(uint64_t iterations);
 
-int threads = 0, hardaffinity = 0;
+int threads = 0, hardaffinity = 0, pmon = 0;
 cpu_set_t cpuset;
 
 int main(int argc, char *argv[]) {
@@ -167,10 +168,23 @@ int main(int argc, char *argv[]) {
 	  iterationsHigh *= iterMul;
 	  fprintf(stderr, "Scaled iterations by %d\n", iterMul);
 	}
+	else if (strncmp(arg, "pmonevents", 10) == 0) {
+	  argIdx++;
+	  pmon = 1;
+	  perf_event_list = argv[argIdx];
+	}
+	else if (strncmp(arg, "pmon", 4) == 0) {
+	  pmon = 1;
+	}
       }
     }
   }
 
+  if (pmon) {
+    fprintf(stderr, "Using hardware performance monitoring with events %s\n", perf_event_list);
+    open_perf_monitoring();
+  }
+
   // figure out clock speed
   gettimeofday(&startTv, &startTz);
   clktest(iterations);
@@ -251,6 +265,7 @@ int main(int argc, char *argv[]) {
   printf("2:1 mixed 64-bit loads/stores per clk> %.2f\n", measureFunction(iterationsHigh, clockSpeedGhz, mix21loadstorewrapper));
 
 
+  if (pmon) close_perf_monitoring();
   return 0;
 }
 
@@ -275,6 +290,7 @@ float measureFunction(uint64_t iterations, float clockSpeedGhz, uint64_t (*testf
   uint64_t time_diff_ms;
   float latency, opsPerNs;
   
+  if (pmon) start_perf_monitoring();
   gettimeofday(&startTv, &startTz);
   if (threads == 0) testfunc(iterations);
   else {
@@ -294,6 +310,11 @@ float measureFunction(uint64_t iterations, float clockSpeedGhz, uint64_t (*testf
     free(testData);
   }
   gettimeofday(&endTv, &endTz);
+  if (pmon) {
+    stop_perf_monitoring();
+    print_perf_summary(stderr);
+  }
+
   time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
   latency = 1e6 * (float)time_diff_ms / (float)iterations;
   opsPerNs = 1/latency;
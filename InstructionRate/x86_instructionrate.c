@@ -15,6 +15,8 @@
 // make mingw happy for cross compiling
 #ifdef __MINGW32__
 #define aligned_alloc(align, size) _aligned_malloc(size, align)
+#else
+#include "../Common/perfmon.h"
 #endif
 
 extern uint64_t noptest(uint64_t iterations) __attribute((sysv_abi));
@@ -151,6 +153,7 @@ uint64_t mixfmaaddmem256wrapper(uint64_t iterations)  __attribute((sysv_abi));
 float measureFunction(uint64_t iterations, float clockSpeedGhz, __attribute((sysv_abi)) uint64_t (*testfunc)(uint64_t));
 
 int threads = 0;
+int pmon = 0;
 
 int main(int argc, char *argv[]) {
   struct timeval startTv, endTv;
@@ -183,6 +186,15 @@ int main(int argc, char *argv[]) {
                   testName = argv[argIdx];
                   fprintf(stderr, "Only running test %s\n", testName);
               }
+#ifndef __MINGW32__
+              else if (strncmp(arg, "pmonevents", 10) == 0) {
+                  argIdx++;
+                  pmon = 1;
+                  perf_event_list = argv[argIdx];
+              } else if (strncmp(arg, "pmon", 4) == 0) {
+                  pmon = 1;
+              }
+#endif
           }
       }
   }
@@ -224,6 +236,13 @@ int main(int argc, char *argv[]) {
       avx512Supported = 1;
   }
 
+#ifndef __MINGW32__
+  if (pmon) {
+      fprintf(stderr, "Using hardware performance monitoring with events %s\n", perf_event_list);
+      open_perf_monitoring();
+  }
+#endif
+
   // figure out clock speed
   gettimeofday(&startTv, &startTz);
   clktest(iterationsHigh);
@@ -492,6 +511,9 @@ int main(int argc, char *argv[]) {
   if (testName == NULL || argc > 1 && strncmp(argv[1], "mixaddmul128int", 15) == 0)
     printf("1:1 mixed 128-bit vec add/mul per clk: %.2f\n", measureFunction(iterations, clockSpeedGhz, mixaddmul128int));
 
+#ifndef __MINGW32__
+  if (pmon) close_perf_monitoring();
+#endif
   return 0;
 }
 
@@ -512,6 +534,9 @@ float measureFunction(uint64_t iterations, float clockSpeedGhz,  __attribute((sy
   uint64_t time_diff_ms, retval;
   float latency, opsPerNs;
 
+#ifndef __MINGW32__
+  if (pmon) start_perf_monitoring();
+#endif
   gettimeofday(&startTv, &startTz);
   if (threads == 0) retval = testfunc(iterations);
   else {
@@ -531,6 +556,12 @@ float measureFunction(uint64_t iterations, float clockSpeedGhz,  __attribute((sy
       free(testData);
   }
   gettimeofday(&endTv, &endTz);
+#ifndef __MINGW32__
+  if (pmon) {
+      stop_perf_monitoring();
+      print_perf_summary(stderr);
+  }
+#endif
   time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
   latency = 1e6 * (float)time_diff_ms / (float)iterations;
   opsPerNs = 1/latency;
@@ -11,6 +11,9 @@
 #include <pthread.h>
 #include <math.h>
 #include <errno.h>
+#include "../Common/results.h"
+#include "../Common/topology.h"
+#include "../Common/chain.h"
 
 #define CACHELINE_SIZE 64
 
@@ -41,6 +44,7 @@ void *FillBandwidthTestArr(void *param);
 void FillPatternArr(uint32_t *pattern_arr, uint32_t list_size, uint32_t byte_increment);
 void *RunLatencyTest(void *param);
 float RunTest(cpu_set_t latencyAffinity, cpu_set_t bwAffinity, int bwThreadCount, int hugepages, int sharedLatency, float *measuredBw); 
+void EmitLoadedLatencyRecord(const char *test, uint64_t sizeKb, cpu_set_t *latencyAffinity, cpu_set_t *bwAffinity, int bwThreadCount, float latency, float bw);
 
 uint64_t BandwidthTestMemoryKB = 16384;
 uint64_t LatencyTestMemoryKB = 2048;
@@ -53,13 +57,19 @@ int main(int argc, char *argv[]) {
     int latencyCore = 0;
     int *customCores = NULL;
     int sharedLatency = 0;
+    int outputFormat = RESULTS_FORMAT_DEFAULT;
+    int bwMode = TOPOLOGY_INVALID;
     if (argc == 1) {
         fprintf(stderr, "Options:\n");
         fprintf(stderr, "-bwthreads [int]: Number of bandwidth test threads\n");
         fprintf(stderr, "-latencyaffinity [int]: Core to run latency test thread on\n");
         fprintf(stderr, "-bwcores [comma separated list]: Cores to run bandwidth load on\n");
+        fprintf(stderr, "-bwmode [linear/physical/l3fill/l3spread/bigfirst]: Pick bandwidth load cores from host topology\n");
+        fprintf(stderr, "-topology: Print detected host topology and exit\n");
+        fprintf(stderr, "-seed [int]: Seed for the latency test's pointer chasing pattern\n");
         fprintf(stderr, "-scaleiterations [int]: Iterations scaling factor\n");
         fprintf(stderr, "-throttle [int]: Reduce bandwidth load per bandwidth test thread\n");
+        fprintf(stderr, "-format [json/csv]: One record per data point instead of the usual table\n");
     }
     for (int argIdx = 1; argIdx < argc; argIdx++) {
         if (*(argv[argIdx]) == '-') {
@@ -109,6 +119,22 @@ int main(int argc, char *argv[]) {
                 }
 
                 fprintf(stderr, "\n");
+            } else if (strncmp(arg, "format", 6) == 0) {
+                argIdx++;
+                outputFormat = results_parse_format(argv[argIdx]);
+            } else if (strncmp(arg, "bwmode", 6) == 0) {
+                argIdx++;
+                bwMode = topology_parse_mode(argv[argIdx]);
+                if (bwMode == TOPOLOGY_INVALID) return 0;
+            } else if (strncmp(arg, "topology", 8) == 0) {
+                struct cpu_topology topo;
+                topology_init(&topo);
+                topology_print(&topo);
+                topology_free(&topo);
+                return 0;
+            } else if (strncmp(arg, "seed", 4) == 0) {
+                argIdx++;
+                chain_set_seed(strtoull(argv[argIdx], NULL, 0));
             } else if (strncmp(arg, "sharedlatency", 13) == 0) {
                 fprintf(stderr, "Shared arr bw+latency\n");
                 sharedLatency = 1;
@@ -116,6 +142,20 @@ int main(int argc, char *argv[]) {
         }
     }
         
+    // explicit -bwcores wins over topology based selection
+    if (bwMode != TOPOLOGY_INVALID && customCores == NULL) {
+        struct cpu_topology topo;
+        topology_init(&topo);
+        customCores = (int *)malloc(sizeof(int) * topo.cpuCount);
+        int selectedCount = topology_select_cpus(&topo, bwMode, latencyCore, customCores, topo.cpuCount);
+        if (bwThreadCap > selectedCount) bwThreadCap = selectedCount;
+        fprintf(stderr, "Cores used for bandwidth load:");
+        for (int i = 0; i < bwThreadCap; i++) fprintf(stderr, " %d", customCores[i]);
+        fprintf(stderr, "\n");
+        topology_free(&topo);
+    }
+
+    results_init("LoadedMemoryLatency", outputFormat, "gettimeofday");
     cpu_set_t latency_cpuset;
     CPU_ZERO(&latency_cpuset);
     CPU_SET(latencyCore, &latency_cpuset);
@@ -144,10 +184,12 @@ int main(int argc, char *argv[]) {
             fprintf(stderr, "%d bw threads %f GB/s %f ns\n", bwThreadCount, bw, latencyNs);
             latencies[bwThreadCount] = latencyNs;
             bandwidths[bwThreadCount] = bw;
+            if (resultsFormat != RESULTS_FORMAT_DEFAULT)
+                EmitLoadedLatencyRecord("loaded", LatencyTestMemoryKB, &latency_cpuset, &bw_cpuset, bwThreadCount, latencyNs, bw);
         }
 
-        printf("BW Threads, Bandwidth (GB/s), Latency (ns)\n");
-        for (int bwThreadCount = 0; bwThreadCount <= bwThreadCap; bwThreadCount++) {
+        if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("BW Threads, Bandwidth (GB/s), Latency (ns)\n");
+        for (int bwThreadCount = 0; bwThreadCount <= bwThreadCap && resultsFormat == RESULTS_FORMAT_DEFAULT; bwThreadCount++) {
             printf("%d, %f, %f\n", bwThreadCount, bandwidths[bwThreadCount], latencies[bwThreadCount]);
         }
         free(latencies);
@@ -169,10 +211,12 @@ int main(int argc, char *argv[]) {
             LatencyTestMemoryKB = default_test_sizes[i];
             latencies[i] = RunTest(latency_cpuset, bw_cpuset, bwThreadCap, 1, sharedLatency, bandwidths + i);
             fprintf(stderr, "%d KB: %f ns %f GB/s\n", LatencyTestMemoryKB, latencies[i], bandwidths[i]);
+            if (resultsFormat != RESULTS_FORMAT_DEFAULT)
+                EmitLoadedLatencyRecord("sharedlatency", LatencyTestMemoryKB, &latency_cpuset, &bw_cpuset, bwThreadCap, latencies[i], bandwidths[i]);
         }
 
-        printf("Test Size (KB), Latency (ns), Bandwidth (GB/s)\n");
-        for (int i = 0; i < testSizeCount; i++) {
+        if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("Test Size (KB), Latency (ns), Bandwidth (GB/s)\n");
+        for (int i = 0; i < testSizeCount && resultsFormat == RESULTS_FORMAT_DEFAULT; i++) {
             printf("%d,%f,%f\n", default_test_sizes[i], latencies[i], bandwidths[i]);
         }
 
@@ -184,6 +228,26 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
+// cpus = latency core first, then bandwidth cores
+void EmitLoadedLatencyRecord(const char *test, uint64_t sizeKb, cpu_set_t *latencyAffinity, cpu_set_t *bwAffinity, int bwThreadCount, float latency, float bw) {
+    char cpuList[1024];
+    int cpuListLen = 0;
+    cpuList[0] = '\0';
+    for (int i = 0; i < CPU_SETSIZE && cpuListLen < sizeof(cpuList) - 8; i++)
+        if (CPU_ISSET(i, latencyAffinity)) cpuListLen += snprintf(cpuList + cpuListLen, sizeof(cpuList) - cpuListLen, "%s%d", cpuListLen ? "," : "", i);
+    for (int i = 0; i < CPU_SETSIZE && cpuListLen < sizeof(cpuList) - 8; i++)
+        if (CPU_ISSET(i, bwAffinity)) cpuListLen += snprintf(cpuList + cpuListLen, sizeof(cpuList) - cpuListLen, ",%d", i);
+
+    struct result_record record;
+    results_new_record(&record, test, "latency_ns", latency);
+    record.sizeKb = sizeKb;
+    record.threads = bwThreadCount + 1;
+    record.cpus = cpuList;
+    results_add_param(&record, "bw_threads", bwThreadCount);
+    results_add_param(&record, "bandwidth_gbps", bw);
+    results_emit(&record);
+}
+
 // returns latency in ns
 // sets measuredBw = measured bandwidth
 float RunTest(cpu_set_t latencyAffinity, cpu_set_t bwAffinity, int bwThreadCount, int hugepages, int sharedLatency, float *measuredBw) {
@@ -275,21 +339,10 @@ float RunTest(cpu_set_t latencyAffinity, cpu_set_t bwAffinity, int bwThreadCount
     return latencyTestData.latency;
 }
 
+// single random cycle, see Common/chain.c
 void FillPatternArr(uint32_t *pattern_arr, uint32_t list_size, uint32_t byte_increment) {
     uint32_t increment = byte_increment / sizeof(uint32_t);
-    uint32_t element_count = list_size / increment;
-    for (int i = 0; i < element_count; i++) {
-        pattern_arr[i * increment] = i * increment;
-    }
-
-    int iter = element_count;
-    while (iter > 1) {
-        iter -= 1;
-        int j = iter - 1 == 0 ? 0 : rand() % (iter - 1);
-        uint32_t tmp = pattern_arr[iter * increment];
-        pattern_arr[iter * increment] = pattern_arr[j * increment];
-        pattern_arr[j * increment] = tmp;
-    }
+    chain_fill32(pattern_arr, list_size / increment, increment, 0);
 }
 
 // No need for simple addressing because this test should be operating well in DRAM
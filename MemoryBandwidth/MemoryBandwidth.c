@@ -25,6 +25,7 @@
 #include <sys/stat.h>
 #include <fcntl.h> 
 #include "../Common/perfmon.h"
+#include "../Common/topology.h"
 #endif 
 
 #ifdef NUMA
@@ -32,6 +33,11 @@
 #include <numa.h>
 #endif
 
+#include "../Common/timing.h"
+#include "../Common/sampling.h"
+#include "../Common/threadpool.h"
+#include "../Common/results.h"
+
 #ifndef gettid
 #define gettid() ((pid_t)syscall(SYS_gettid))
 #endif
@@ -47,23 +53,48 @@ int default_test_sizes[] = { 2, 4, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256,
 
 typedef struct BandwidthTestThreadData {
     uint64_t iterations;
+    uint64_t chunks;  // with -duration, iterations is per kernel call and this counts calls
     uint64_t arr_length;
     uint64_t start;
     float* arr;
-    float bw; // written to by the thread
+    volatile int *flag; // with -duration, set 1 to stop
+    float bw; // filled in from pool worker timestamps after the run
     #ifdef NUMA
     cpu_set_t cpuset; // if numa set, will set affinity
+    int firstTouch;   // fill arr[touchStart, touchEnd) from the worker, so the OS places it
+    uint64_t touchStart, touchEnd;
     #endif
 } BandwidthTestThreadData;
 
 float MeasureBw(uint64_t sizeKb, uint64_t iterations, uint64_t threads, int shared, int nopBytes, int coreNode, int memNode);
 
+// one bandwidth data point, for the sampling engine to run repeatedly
+typedef struct BandwidthTestPoint {
+    uint64_t sizeKb;
+    uint64_t threads;
+    int shared;
+    int nopBytes;
+} BandwidthTestPoint;
+
+float MeasureBwPoint(void *param);
+void PrintBwPoint(BandwidthTestPoint *point, float bw, struct sample_stats *stats);
+void EmitBwRecord(uint64_t sizeKb, int threads, int shared, float bw, int cpuNode, int memNode);
+void GetFairness(float *minBw, float *maxBw, float *jain);
+void AddFairnessParams(struct result_record *record);
+void EmitThreadRecords(uint64_t sizeKb, int shared);
+
 #ifdef __x86_64
 #include <cpuid.h>
 float scalar_read(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute((ms_abi));
 extern float sse_read(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
 extern float sse_write(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
 extern float sse_ntwrite(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
+extern float sse_ntcopy(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
+extern float avx_ntwrite(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
+extern float avx_ntcopy(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
+extern float avx512_ntwrite(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
+extern float avx512_ntcopy(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
+extern float clzero_write(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
 extern float avx512_read(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
 extern float avx512_write(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
 extern float avx512_copy(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start) __attribute__((ms_abi));
@@ -94,7 +125,63 @@ extern float asm_add(float *arr, uint64_t arr_length, uint64_t iterations, uint6
 
 #ifdef __aarch64__
 extern void flush_icache(void *arr, uint64_t length);
+extern float asm_ntwrite(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start);
+extern float asm_ntcopy(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start);
+extern float asm_zvawrite(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t start);
+#endif
+
+// read/write mix kernels take {start, lines to read, lines to write} in place of start
+#ifdef __x86_64
+extern float mix_avx(float *arr, uint64_t arr_length, uint64_t iterations, uint64_t *params) __attribute__((ms_abi));
+extern float mix_avx_nt(float *arr, uint64_t arr_length, uint64_t iterations, uint64_t *params) __attribute__((ms_abi));
+float (*mix_func)(float *, uint64_t, uint64_t, uint64_t *) __attribute__((ms_abi));
+#else
+#ifdef __aarch64__
+extern float asm_mix(float *arr, uint64_t arr_length, uint64_t iterations, uint64_t *params);
+extern float asm_mix_nt(float *arr, uint64_t arr_length, uint64_t iterations, uint64_t *params);
+#elif defined(__riscv)
+extern float asm_mix(float *arr, uint64_t arr_length, uint64_t iterations, uint64_t *params);
+#endif
+float (*mix_func)(float *, uint64_t, uint64_t, uint64_t *);
 #endif
+uint64_t mixReadLines = 0, mixWriteLines = 0;
+
+#ifdef __x86_64
+__attribute((ms_abi)) float mix_read_write(float *arr, uint64_t arr_length, uint64_t iterations, uint64_t start) {
+#else
+float mix_read_write(float *arr, uint64_t arr_length, uint64_t iterations, uint64_t start) {
+#endif
+    uint64_t params[3] = { start, mixReadLines, mixWriteLines };
+    return mix_func(arr, arr_length, iterations, params);
+}
+
+// memcpy/memset shootout. routines take (dst, src, length in bytes), fill routines ignore src.
+// func = NULL means libc memcpy/memset, called directly so an ABI thunk doesn't get timed
+typedef struct CopyRoutine {
+    const char *name;
+    int fill;
+#ifdef __x86_64
+    void (*func)(void *dst, const void *src, uint64_t len) __attribute__((ms_abi));
+#else
+    void (*func)(void *dst, const void *src, uint64_t len);
+#endif
+} CopyRoutine;
+
+#ifdef __x86_64
+extern void repmovsb_memcpy(void *dst, const void *src, uint64_t len) __attribute__((ms_abi));
+extern void repstosb_memset(void *dst, const void *src, uint64_t len) __attribute__((ms_abi));
+extern void avx_memcpy(void *dst, const void *src, uint64_t len) __attribute__((ms_abi));
+extern void avx_ntmemcpy(void *dst, const void *src, uint64_t len) __attribute__((ms_abi));
+extern void avx_memset(void *dst, const void *src, uint64_t len) __attribute__((ms_abi));
+extern void avx_ntmemset(void *dst, const void *src, uint64_t len) __attribute__((ms_abi));
+#elif defined(__aarch64__)
+extern void asm_memcpy(void *dst, const void *src, uint64_t len);
+extern void asm_ntmemcpy(void *dst, const void *src, uint64_t len);
+extern void asm_memset(void *dst, const void *src, uint64_t len);
+extern void asm_ntmemset(void *dst, const void *src, uint64_t len);
+#endif
+
+void RunCopySuite(uint64_t maxBytes);
 
 #ifdef __x86_64
 __attribute((ms_abi)) float instr_read(float *arr, uint64_t arr_length, uint64_t iterations, uint64_t start) {
@@ -108,9 +195,15 @@ float instr_read(float *arr, uint64_t arr_length, uint64_t iterations, uint64_t
 
 void FillInstructionArray(uint64_t *nops, uint64_t sizeKb, int nopSize, int branchInterval); 
 uint64_t GetIterationCount(uint64_t testSize, uint64_t threads);
-void *ReadBandwidthTestThread(void *param);
+uint64_t GetChunkIterations(uint64_t arr_length);
+void BandwidthTestThreadPrep(void *param);
+void ReadBandwidthTestThread(void *param);
 void *allocate_memory(size_t bytes, unsigned int threadOffset);
+#ifndef __MINGW32__
+int *GetPoolCores(int count);
+#endif
 uint64_t gbToTransfer = 512;
+uint64_t durationMs = 0; // if set, run each point for this long instead of a fixed amount of data
 int branchInterval = 0; 
 
 cpu_set_t global_cpuset;
@@ -122,10 +215,36 @@ int hardaffinity = 0;
 #define NUMA_CROSSNODE 3
 #define NUMA_AUTO 4
 #define NUMA_DOUBLE_CROSSNODE 5
+#define NUMA_INTERLEAVE 6
+#define NUMA_NODESCALE 7
 int numa = 0;
+
+// nodes that have CPUs, in node order, from NumaInit
+int numaCpuNodeCount = 0;
+int *numaCpuNodes = NULL;
+int *numaNodeCpuCounts = NULL; // indexed by node
+int numaTotalCpus = 0;
+
+int NumaInit();
+void NumaNodeCpuset(int node, cpu_set_t *cpuset);
+void NumaPlaceThread(uint64_t threadIdx, int *coreNode, int *memNode);
+void *AllocateNumaMemory(size_t bytes, int memNode);
+void RunNumaNodeScaling(int sizeKb, int shared, int nopBytes);
 #endif
 
 int pmon = 0;
+char *methodName = "default";
+
+// per-thread results from the most recent MeasureBw call, for -perthread
+int perThread = 0;
+float *lastThreadBw = NULL;
+int lastThreadCount = 0;
+uint64_t lastStartSkewNs = 0, lastEndSkewNs = 0;
+struct sampling_config samplingConfig;
+
+// created once and reused so thread creation isn't timed. with pmon, workers get
+// their own counters since they already exist when monitoring is opened
+struct thread_pool *bwPool = NULL;
 
 int main(int argc, char *argv[]) {
     int threads = 1;
@@ -134,8 +253,13 @@ int main(int argc, char *argv[]) {
     int sleepTime = 0;
     int methodSet = 0, nopBytes = 0, testBankConflict = 0;
     int testBankConflict128 = 0;
-    int singleSize = 0, autothreads = 0;
+    int singleSize = 0, autothreads = 0, copySuite = 0;
+    int timingBackend = TIMING_AUTO;
+    int outputFormat = RESULTS_FORMAT_DEFAULT;
     int testSizeCount = sizeof(default_test_sizes) / sizeof(int);
+    BandwidthTestPoint testPoint;
+    struct sample_stats pointStats;
+    sampling_default_config(&samplingConfig);
 
 #ifdef __x86_64
     int sseSupported = 0, avxSupported = 0, avx512Supported = 0;
@@ -151,6 +275,13 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "AVX512 supported\n");
         avx512Supported = 1;
     }
+
+    // clzero is AMD only. eax = 0x80000008, bit 0 of ebx
+    int clzeroSupported = 0;
+    if (__get_cpuid_max(0x80000000, NULL) >= 0x80000008) {
+        __cpuid(0x80000008, cpuidEax, cpuidEbx, cpuidEcx, cpuidEdx);
+        clzeroSupported = cpuidEbx & 1;
+    }
 #endif
 
     bw_func = asm_read;
@@ -191,13 +322,54 @@ int main(int argc, char *argv[]) {
                 argIdx++;
                 gbToTransfer = atoi(argv[argIdx]);
                 fprintf(stderr, "Base GB to transfer: %lu\n", gbToTransfer);
+            } else if (strncmp(arg, "duration", 8) == 0) {
+                argIdx++;
+                durationMs = atoi(argv[argIdx]);
+                fprintf(stderr, "Running each test for %lu ms\n", durationMs);
+            }
+            else if (strncmp(arg, "timer", 5) == 0) {
+                argIdx++;
+                timingBackend = timing_parse_backend(argv[argIdx]);
+            }
+            else if (strncmp(arg, "trials", 6) == 0) {
+                argIdx++;
+                samplingConfig.maxTrials = atoi(argv[argIdx]);
+                fprintf(stderr, "Up to %d trials per test size\n", samplingConfig.maxTrials);
+            }
+            else if (strncmp(arg, "mintrials", 9) == 0) {
+                argIdx++;
+                samplingConfig.minTrials = atoi(argv[argIdx]);
+                fprintf(stderr, "At least %d trials per test size\n", samplingConfig.minTrials);
+            }
+            else if (strncmp(arg, "ci", 2) == 0) {
+                argIdx++;
+                samplingConfig.targetCi = atof(argv[argIdx]) / 100.0f;
+                fprintf(stderr, "Will stop when 95%% confidence interval is within %f%% of mean\n", samplingConfig.targetCi * 100);
+            }
+            else if (strncmp(arg, "format", 6) == 0) {
+                argIdx++;
+                outputFormat = results_parse_format(argv[argIdx]);
             }
             else if (strncmp(arg, "autothreads", 11) == 0) {
                 argIdx++;
                 autothreads = atoi(argv[argIdx]);
                 fprintf(stderr, "Testing bw scaling up to %d threads\n", autothreads);
             }
+            else if (strncmp(arg, "perthread", 9) == 0) {
+                perThread = 1;
+                fprintf(stderr, "Reporting per-thread bandwidth and fairness\n");
+            }
+            else if (strncmp(arg, "copysuite", 9) == 0) {
+                copySuite = 1;
+                fprintf(stderr, "Comparing memcpy/memset implementations\n");
+            }
 #ifndef __MINGW32__
+            else if (strncmp(arg, "pmonevents", 10) == 0) {
+                argIdx++;
+                pmon = 1;
+                perf_event_list = argv[argIdx];
+                fprintf(stderr, "Using hardware performance monitoring with events %s\n", perf_event_list);
+            }
             else if (strncmp(arg, "pmon", 4) == 0) {
                 pmon = 1;
                 fprintf(stderr, "Using hardware performance monitoring\n");
@@ -220,12 +392,25 @@ int main(int argc, char *argv[]) {
                 } else if (strncmp(argv[argIdx], "doublecross", 10) == 0) {
                     fprintf(stderr, "Crossnode, with two nodes\n");
                     numa = NUMA_DOUBLE_CROSSNODE;
+                } else if (strncmp(argv[argIdx], "interleave", 10) == 0) {
+                    fprintf(stderr, "Striping threads across NUMA nodes, with memory interleaved across nodes\n");
+                    numa = NUMA_INTERLEAVE;
+                } else if (strncmp(argv[argIdx], "firsttouch", 10) == 0 || strncmp(argv[argIdx], "auto", 4) == 0) {
+                    fprintf(stderr, "Striping threads across NUMA nodes, letting the OS place memory on first touch\n");
+                    numa = NUMA_AUTO;
+                } else if (strncmp(argv[argIdx], "nodescale", 9) == 0) {
+                    fprintf(stderr, "Scaling threads within each node, with local and remote memory\n");
+                    numa = NUMA_NODESCALE;
+                } else {
+                    fprintf(stderr, "Unknown NUMA mode %s\n", argv[argIdx]);
+                    return 0;
                 }
             }
 #endif
             else if (strncmp(arg, "method", 6) == 0) {
                 methodSet = 1;
                 argIdx++;
+                methodName = argv[argIdx];
                 if (strncmp(argv[argIdx], "scalar", 6) == 0) {
                     bw_func = scalar_read;
                     fprintf(stderr, "Using scalar C code\n");
@@ -262,7 +447,75 @@ int main(int argc, char *argv[]) {
                         bw_func = avx512_add;
                     }
                     #endif
+                } else if (strncmp(argv[argIdx], "ntwrite", 7) == 0) {
+                    #ifdef __x86_64
+                    bw_func = sse_ntwrite;
+                    if (avxSupported) bw_func = avx_ntwrite;
+                    if (avx512Supported) bw_func = avx512_ntwrite;
+                    #elif defined(__aarch64__)
+                    bw_func = asm_ntwrite;
+                    #else
+                    fprintf(stderr, "No non-temporal write test for this platform\n");
+                    return 0;
+                    #endif
+                    fprintf(stderr, "Using widest non-temporal stores available to test write bandwidth\n");
+                } else if (strncmp(argv[argIdx], "ntcopy", 6) == 0) {
+                    #ifdef __x86_64
+                    bw_func = sse_ntcopy;
+                    if (avxSupported) bw_func = avx_ntcopy;
+                    if (avx512Supported) bw_func = avx512_ntcopy;
+                    #elif defined(__aarch64__)
+                    bw_func = asm_ntcopy;
+                    #else
+                    fprintf(stderr, "No non-temporal copy test for this platform\n");
+                    return 0;
+                    #endif
+                    fprintf(stderr, "Using widest non-temporal stores available to copy\n");
+                } else if (strncmp(argv[argIdx], "mix", 3) == 0) {
+                    // mix:R:W reads R cache lines then writes W, mixnt:R:W does the writes with NT stores
+                    int nt = strncmp(argv[argIdx], "mixnt", 5) == 0;
+                    if (sscanf(argv[argIdx] + (nt ? 5 : 3), ":%lu:%lu", &mixReadLines, &mixWriteLines) != 2 || mixReadLines + mixWriteLines == 0) {
+                        fprintf(stderr, "Expected mix:R:W or mixnt:R:W with R + W > 0, got %s\n", argv[argIdx]);
+                        return 0;
+                    }
+
+                    #ifdef __x86_64
+                    if (!avxSupported) {
+                        fprintf(stderr, "Read/write mix test needs AVX\n");
+                        return 0;
+                    }
+
+                    mix_func = nt ? mix_avx_nt : mix_avx;
+                    #elif defined(__aarch64__)
+                    mix_func = nt ? asm_mix_nt : asm_mix;
+                    #elif defined(__riscv)
+                    if (nt) {
+                        fprintf(stderr, "No non-temporal mix test for this platform\n");
+                        return 0;
+                    }
+
+                    mix_func = asm_mix;
+                    #else
+                    fprintf(stderr, "No read/write mix test for this platform\n");
+                    return 0;
+                    #endif
+                    bw_func = mix_read_write;
+                    fprintf(stderr, "Reading %lu and %swriting %lu of every %lu cache lines\n",
+                        mixReadLines, nt ? "non-temporally " : "", mixWriteLines, mixReadLines + mixWriteLines);
                 }
+                #ifdef __aarch64__
+                else if (strncmp(argv[argIdx], "dczva", 5) == 0) {
+                    uint64_t dczid;
+                    __asm__ volatile("mrs %0, dczid_el0" : "=r"(dczid));
+                    if (dczid & 0x10) {
+                        fprintf(stderr, "dc zva is prohibited on this system\n");
+                        return 0;
+                    }
+
+                    bw_func = asm_zvawrite;
+                    fprintf(stderr, "Using dc zva to zero %d byte blocks\n", 4 << (dczid & 0xF));
+                }
+                #endif
 
                 else if (strncmp(argv[argIdx], "instr8", 6) == 0) {
                     nopBytes = 8;
@@ -288,6 +541,35 @@ int main(int argc, char *argv[]) {
                     bw_func = instr_read;
                     fprintf(stderr, "Testing instruction bandwidth with call to function/return blocks\n");
                 } 
+                else if (strncmp(argv[argIdx], "avx512_ntwrite", 14) == 0) {
+                    bw_func = avx512_ntwrite;
+                    fprintf(stderr, "Using AVX-512 NT writes to test write bandwidth\n");
+                }
+                else if (strncmp(argv[argIdx], "avx512_ntcopy", 13) == 0) {
+                    bw_func = avx512_ntcopy;
+                    fprintf(stderr, "Using AVX-512 loads and NT writes to copy\n");
+                }
+                else if (strncmp(argv[argIdx], "avx_ntwrite", 11) == 0) {
+                    bw_func = avx_ntwrite;
+                    fprintf(stderr, "Using AVX NT writes to test write bandwidth\n");
+                }
+                else if (strncmp(argv[argIdx], "avx_ntcopy", 10) == 0) {
+                    bw_func = avx_ntcopy;
+                    fprintf(stderr, "Using AVX loads and NT writes to copy\n");
+                }
+                else if (strncmp(argv[argIdx], "sse_ntcopy", 10) == 0) {
+                    bw_func = sse_ntcopy;
+                    fprintf(stderr, "Using SSE loads and NT writes to copy\n");
+                }
+                else if (strncmp(argv[argIdx], "clzero", 6) == 0) {
+                    if (!clzeroSupported) {
+                        fprintf(stderr, "clzero is not supported on this CPU\n");
+                        return 0;
+                    }
+
+                    bw_func = clzero_write;
+                    fprintf(stderr, "Using CLZERO to zero the array\n");
+                }
                 else if (strncmp(argv[argIdx], "avx512", 6) == 0) {
                     bw_func = avx512_read;
                     fprintf(stderr, "Using ASM code, AVX512\n");
@@ -329,10 +611,22 @@ int main(int argc, char *argv[]) {
             }
         } else {
             fprintf(stderr, "Expected - parameter\n");
-            fprintf(stderr, "Usage: [-threads <thread count>] [-private] [-method <scalar/asm/avx512>] [-sleep <time in seconds>] [-sizekb <single test size>]\n");
+            fprintf(stderr, "Usage: [-threads <thread count>] [-private] [-method <scalar/asm/avx512/write/copy/ntwrite/ntcopy/mix:R:W/mixnt:R:W>] [-sleep <time in seconds>] [-sizekb <single test size>] [-duration <ms>] [-timer <tsc/clock>] [-perthread] [-copysuite]\n");
         }
     }
 
+    timing_init(timingBackend);
+    results_init("MemoryBandwidth", outputFormat, timing_backend_name());
+
+    if (copySuite) {
+        RunCopySuite(singleSize != 0 ? (uint64_t)singleSize * 1024 : 1ULL << 30);
+        return 0;
+    }
+
+#ifdef NUMA
+    if (numa && !NumaInit()) return 0;
+#endif
+
 #ifdef __x86_64
     // if no method was specified, attempt to pick the best one for x86
     // for aarch64 we'll just use NEON because SVE basically doesn't exist
@@ -353,24 +647,41 @@ int main(int argc, char *argv[]) {
     }
 #endif
 
+    // with pmon, pin workers when they're created, so counters attached to them open on the PMU for
+    // that core's type on hybrid CPUs. numa and hardaffinity pin workers themselves in prep
+    int poolSize = autothreads > threads ? autothreads : threads;
+    int *poolCores = NULL;
+#ifndef __MINGW32__
+    int pinPool = pmon && !hardaffinity;
+#ifdef NUMA
+    if (numa) pinPool = 0;
+#endif
+    if (pinPool) poolCores = GetPoolCores(poolSize);
+#endif
+    bwPool = pool_create(poolSize, poolCores, 0);
+    free(poolCores);
     if (autothreads > 0) {
         float *threadResults = (float *)malloc(sizeof(float) * autothreads * testSizeCount);
-        printf("Auto threads mode, up to %d threads\n", autothreads);
+        if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("Auto threads mode, up to %d threads\n", autothreads);
         for (int threadIdx = 1; threadIdx <= autothreads; threadIdx++) {
             if (singleSize != 0) {
                 threadResults[threadIdx - 1] = MeasureBw(singleSize, GetIterationCount(singleSize, threadIdx), threadIdx, shared, nopBytes, 0, 0);
                 fprintf(stderr, "%d threads: %f GB/s\n", threadIdx, threadResults[threadIdx - 1]);
+                if (resultsFormat != RESULTS_FORMAT_DEFAULT) EmitBwRecord(singleSize, threadIdx, shared, threadResults[threadIdx - 1], -1, -1);
             } else {
                 for (int i = 0; i < testSizeCount; i++) {
                     int currentTestSize = default_test_sizes[i];
                     //fprintf(stderr, "Testing size %d\n", currentTestSize);
                     threadResults[(threadIdx - 1) * testSizeCount + i] = MeasureBw(currentTestSize, GetIterationCount(currentTestSize, threadIdx), threadIdx, shared, nopBytes, 0, 0);
                     fprintf(stderr, "%d threads, %d KB total: %f GB/s\n", threadIdx, currentTestSize, threadResults[(threadIdx - 1) * testSizeCount + i]);
+                    if (resultsFormat != RESULTS_FORMAT_DEFAULT) EmitBwRecord(currentTestSize, threadIdx, shared, threadResults[(threadIdx - 1) * testSizeCount + i], -1, -1);
                 }
             }
         }
 
-        if (singleSize != 0) {
+        if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+            // already emitted
+        } else if (singleSize != 0) {
             printf("Threads, BW (GB/s)\n");
             for (int i = 0;i < autothreads; i++) {
                 printf("%d,%f\n", i + 1, threadResults[i]);
@@ -415,15 +726,17 @@ int main(int argc, char *argv[]) {
                 crossnodeBandwidths[cpuNode * numaNodeCount + memNode] = 
                 MeasureBw(singleSize, GetIterationCount(singleSize, nodeCpuCount), nodeCpuCount, shared, nopBytes, cpuNode, memNode);
             fprintf(stderr, "CPU node %d <- mem node %d: %f\n", cpuNode, memNode, crossnodeBandwidths[cpuNode * numaNodeCount + memNode]);
+            if (resultsFormat != RESULTS_FORMAT_DEFAULT)
+                EmitBwRecord(singleSize, nodeCpuCount, shared, crossnodeBandwidths[cpuNode * numaNodeCount + memNode], cpuNode, memNode);
             }
         }
 
-        for (int memNode = 0; memNode < numaNodeCount; memNode++) {
+        for (int memNode = 0; memNode < numaNodeCount && resultsFormat == RESULTS_FORMAT_DEFAULT; memNode++) {
         printf(",%d", memNode);
     }
 
-    printf("\n");
-    for (int cpuNode = 0; cpuNode < numaNodeCount; cpuNode++) {
+    if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("\n");
+    for (int cpuNode = 0; cpuNode < numaNodeCount && resultsFormat == RESULTS_FORMAT_DEFAULT; cpuNode++) {
         printf("%d", cpuNode);
         for (int memNode = 0; memNode < numaNodeCount; memNode++) {
             printf(",%f", crossnodeBandwidths[cpuNode * numaNodeCount + memNode]);
@@ -435,43 +748,159 @@ int main(int argc, char *argv[]) {
         numa_free_cpumask(nodeBitmask);
     free(crossnodeBandwidths);
     }
+    else if (numa == NUMA_NODESCALE) {
+        RunNumaNodeScaling(singleSize != 0 ? singleSize : 1048576, shared, nopBytes);
+    }
 #endif
     else {
-        printf("Using %d threads\n", threads);
-        printf("Size (KB),Bandwidth (GB/s)");
 #ifndef __MINGW32__
         if (pmon) {
             open_perf_monitoring();
-            append_perf_header();
+            pid_t *workerTids = (pid_t *)malloc(sizeof(pid_t) * bwPool->workerCount);
+            for (int i = 0; i < bwPool->workerCount; i++) workerTids[i] = bwPool->workers[i].tid;
+            perf_attach_threads(workerTids, bwPool->workerCount);
+            free(workerTids);
         }
 #endif
-        printf("\n");
+        if (resultsFormat == RESULTS_FORMAT_DEFAULT) {
+            printf("Using %d threads\n", threads);
+            printf("Size (KB),Bandwidth (GB/s)");
+            if (samplingConfig.maxTrials > 1) printf(",Min,P99,Stddev,Trials");
+            if (perThread) {
+                printf(",Thread min,Thread max,Jain index,Start skew (ns),End skew (ns)");
+                for (int threadIdx = 0; threadIdx < threads; threadIdx++) printf(",T%d", threadIdx);
+            }
+#ifndef __MINGW32__
+            if (pmon) append_perf_header();
+#endif
+            printf("\n");
+        }
+
+        testPoint.threads = threads;
+        testPoint.shared = shared;
+        testPoint.nopBytes = nopBytes;
         if (singleSize == 0)
         {
             for (int i = 0; i < testSizeCount; i++)
             {
-                printf("%d,%f", default_test_sizes[i], MeasureBw(default_test_sizes[i], GetIterationCount(default_test_sizes[i], threads), threads, shared, nopBytes, 0, 0));
-
-#ifndef __MINGW32__
-                if (pmon) append_perf_values();
-#endif
-                printf("\n");
+                testPoint.sizeKb = default_test_sizes[i];
+                float bw = run_sampled(&samplingConfig, MeasureBwPoint, &testPoint, &pointStats);
+                PrintBwPoint(&testPoint, bw, &pointStats);
                 if (sleepTime > 0) sleep(sleepTime);
             }
         }
         else
         {
-            printf("%d,%f", singleSize, MeasureBw(singleSize, GetIterationCount(singleSize, threads), threads, shared, nopBytes, 0, 0));
-            append_perf_values();
-            printf("\n");
+            testPoint.sizeKb = singleSize;
+            float bw = run_sampled(&samplingConfig, MeasureBwPoint, &testPoint, &pointStats);
+            PrintBwPoint(&testPoint, bw, &pointStats);
         }
 
-        close_perf_monitoring();
+#ifndef __MINGW32__
+        if (pmon) close_perf_monitoring();
+#endif
     }
 
+    if (bwPool) pool_destroy(bwPool);
     return 0;
 }
 
+float MeasureBwPoint(void *param) {
+    BandwidthTestPoint *point = (BandwidthTestPoint *)param;
+    return MeasureBw(point->sizeKb, GetIterationCount(point->sizeKb, point->threads), point->threads, point->shared, point->nopBytes, 0, 0);
+}
+
+// bw is the median if multiple trials were run
+void PrintBwPoint(BandwidthTestPoint *point, float bw, struct sample_stats *stats) {
+    if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+        struct result_record record;
+        results_new_record(&record, methodName, "bandwidth_gbps", bw);
+        record.sizeKb = point->sizeKb;
+        record.threads = point->threads;
+        if (samplingConfig.maxTrials > 1) record.stats = stats;
+        results_add_param(&record, "shared", point->shared);
+        if (perThread) AddFairnessParams(&record);
+#ifndef __MINGW32__
+        for (int evtIdx = 0; pmon && evtIdx < perf_default_set.eventCount; evtIdx++)
+            results_add_counter(&record, perf_default_set.events[evtIdx].description, perf_default_set.events[evtIdx].value);
+#endif
+        results_emit(&record);
+        if (perThread) EmitThreadRecords(point->sizeKb, point->shared);
+        return;
+    }
+
+    printf("%lu,%f", point->sizeKb, bw);
+    if (samplingConfig.maxTrials > 1) printf(",%f,%f,%f,%d", stats->min, stats->p99, stats->stddev, stats->count);
+    if (perThread) {
+        // per-thread numbers are from the last trial
+        float minBw, maxBw, jain;
+        GetFairness(&minBw, &maxBw, &jain);
+        printf(",%f,%f,%f,%lu,%lu", minBw, maxBw, jain, lastStartSkewNs, lastEndSkewNs);
+        for (int threadIdx = 0; threadIdx < lastThreadCount; threadIdx++) printf(",%f", lastThreadBw[threadIdx]);
+    }
+#ifndef __MINGW32__
+    if (pmon) append_perf_values(); // from the last trial
+#endif
+    printf("\n");
+}
+
+// for data points that don't go through the sampling engine
+void EmitBwRecord(uint64_t sizeKb, int threads, int shared, float bw, int cpuNode, int memNode) {
+    struct result_record record;
+    results_new_record(&record, methodName, "bandwidth_gbps", bw);
+    record.sizeKb = sizeKb;
+    record.threads = threads;
+    results_add_param(&record, "shared", shared);
+    if (cpuNode >= 0) {
+        results_add_param(&record, "cpu_node", cpuNode);
+        results_add_param(&record, "mem_node", memNode);
+    }
+
+    if (perThread) AddFairnessParams(&record);
+    results_emit(&record);
+    if (perThread) EmitThreadRecords(sizeKb, shared);
+}
+
+// Jain's fairness index = (sum x)^2 / (n * sum x^2). 1 = all threads got the same bandwidth,
+// 1/n = one thread got all of it
+void GetFairness(float *minBw, float *maxBw, float *jain) {
+    double sum = 0, sumSquares = 0;
+    *minBw = lastThreadCount ? lastThreadBw[0] : 0;
+    *maxBw = *minBw;
+    for (int threadIdx = 0; threadIdx < lastThreadCount; threadIdx++) {
+        float threadBw = lastThreadBw[threadIdx];
+        if (threadBw < *minBw) *minBw = threadBw;
+        if (threadBw > *maxBw) *maxBw = threadBw;
+        sum += threadBw;
+        sumSquares += threadBw * threadBw;
+    }
+
+    *jain = sumSquares > 0 ? sum * sum / (lastThreadCount * sumSquares) : 0;
+}
+
+void AddFairnessParams(struct result_record *record) {
+    float minBw, maxBw, jain;
+    GetFairness(&minBw, &maxBw, &jain);
+    results_add_param(record, "thread_min_gbps", minBw);
+    results_add_param(record, "thread_max_gbps", maxBw);
+    results_add_param(record, "jain_index", jain);
+    results_add_param(record, "start_skew_ns", lastStartSkewNs);
+    results_add_param(record, "end_skew_ns", lastEndSkewNs);
+}
+
+// one record per thread, so uneven bandwidth across cores shows up in the data
+void EmitThreadRecords(uint64_t sizeKb, int shared) {
+    for (int threadIdx = 0; threadIdx < lastThreadCount; threadIdx++) {
+        struct result_record record;
+        results_new_record(&record, methodName, "thread_bandwidth_gbps", lastThreadBw[threadIdx]);
+        record.sizeKb = sizeKb;
+        record.threads = lastThreadCount;
+        results_add_param(&record, "shared", shared);
+        results_add_param(&record, "thread", threadIdx);
+        results_emit(&record);
+    }
+}
+
 /// <summary>
 /// Given test size in KB, return a good iteration count
 /// </summary>
@@ -488,6 +917,128 @@ uint64_t GetIterationCount(uint64_t testSize, uint64_t threads)
     else return iterations;
 }
 
+// src, dst byte offsets from a 4 KB aligned base. fill routines only use the ones with src = 0
+int copy_offsets[][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 0, 48 }, { 16, 48 } };
+#define COPY_SUITE_MIN_NS 20000000ULL
+
+uint64_t TimeCopyCalls(CopyRoutine *routine, char *dst, char *src, uint64_t len, uint64_t calls) {
+    uint64_t startTicks;
+    start_timing_ns(&startTicks);
+    if (routine->func != NULL) {
+        for (uint64_t callIdx = 0; callIdx < calls; callIdx++) routine->func(dst, src, len);
+    } else if (routine->fill) {
+        for (uint64_t callIdx = 0; callIdx < calls; callIdx++) {
+            memset(dst, 0, len);
+            __asm__ volatile("" ::: "memory"); // don't let the compiler merge repeated calls
+        }
+    } else {
+        for (uint64_t callIdx = 0; callIdx < calls; callIdx++) {
+            memcpy(dst, src, len);
+            __asm__ volatile("" ::: "memory");
+        }
+    }
+
+    return end_timing_ns(&startTicks);
+}
+
+// sweeps copy/fill size from 16 B to maxBytes and src/dst misalignment for each routine.
+// buffers are reused across calls, so sizes that fit in cache measure cache-hot copies
+void RunCopySuite(uint64_t maxBytes) {
+    CopyRoutine routines[10];
+    int routineCount = 0;
+    routines[routineCount++] = (CopyRoutine){ "libc_memcpy", 0, NULL };
+    routines[routineCount++] = (CopyRoutine){ "libc_memset", 1, NULL };
+#ifdef __x86_64
+    routines[routineCount++] = (CopyRoutine){ "repmovsb", 0, repmovsb_memcpy };
+    routines[routineCount++] = (CopyRoutine){ "repstosb", 1, repstosb_memset };
+    if (__builtin_cpu_supports("avx")) {
+        routines[routineCount++] = (CopyRoutine){ "avx_memcpy", 0, avx_memcpy };
+        routines[routineCount++] = (CopyRoutine){ "avx_ntmemcpy", 0, avx_ntmemcpy };
+        routines[routineCount++] = (CopyRoutine){ "avx_memset", 1, avx_memset };
+        routines[routineCount++] = (CopyRoutine){ "avx_ntmemset", 1, avx_ntmemset };
+    } else fprintf(stderr, "AVX not supported, skipping vector loops\n");
+#elif defined(__aarch64__)
+    routines[routineCount++] = (CopyRoutine){ "neon_memcpy", 0, asm_memcpy };
+    routines[routineCount++] = (CopyRoutine){ "neon_ntmemcpy", 0, asm_ntmemcpy };
+    routines[routineCount++] = (CopyRoutine){ "neon_memset", 1, asm_memset };
+    routines[routineCount++] = (CopyRoutine){ "neon_ntmemset", 1, asm_ntmemset };
+#endif
+
+    // leave room past the end for the largest offset
+    uint64_t requestedBytes = maxBytes;
+    char *src = NULL, *dst = NULL;
+    for (; maxBytes >= 16; maxBytes /= 2) {
+        if (posix_memalign((void **)&src, 4096, maxBytes + 4096) != 0) continue;
+        if (posix_memalign((void **)&dst, 4096, maxBytes + 4096) == 0) break;
+        free(src);
+        src = NULL;
+    }
+
+    if (dst == NULL) {
+        fprintf(stderr, "Could not allocate memory for copy suite\n");
+        return;
+    }
+
+    if (maxBytes != requestedBytes) fprintf(stderr, "Could not allocate %lu B buffers, stopping at %lu B\n", requestedBytes, maxBytes);
+    memset(src, 1, maxBytes + 4096);
+    memset(dst, 0, maxBytes + 4096);
+
+    if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("Routine,Size (B),Src offset,Dst offset,GB/s,ns/call\n");
+    for (uint64_t pow2 = 16; pow2 <= maxBytes; pow2 *= 2) {
+        // odd sizes only matter for short copies, where tail handling is a big part of the cost
+        uint64_t sizes[3] = { pow2, pow2 + 1, pow2 + pow2 / 2 };
+        for (int sizeIdx = 0; sizeIdx < 3; sizeIdx++) {
+            uint64_t len = sizes[sizeIdx];
+            if (len > maxBytes || (sizeIdx == 1 && pow2 > 256)) continue;
+            for (int routineIdx = 0; routineIdx < routineCount; routineIdx++) {
+                CopyRoutine *routine = routines + routineIdx;
+                for (int offsetIdx = 0; offsetIdx < sizeof(copy_offsets) / sizeof(copy_offsets[0]); offsetIdx++) {
+                    int srcOffset = copy_offsets[offsetIdx][0], dstOffset = copy_offsets[offsetIdx][1];
+                    if (routine->fill && srcOffset != 0) continue;
+                    char *srcPtr = src + srcOffset, *dstPtr = dst + dstOffset;
+
+                    // warm up, then double the call count until the run is long enough to time
+                    uint64_t calls = 1, elapsedNs;
+                    TimeCopyCalls(routine, dstPtr, srcPtr, len, 1);
+                    while ((elapsedNs = TimeCopyCalls(routine, dstPtr, srcPtr, len, calls)) < COPY_SUITE_MIN_NS) calls *= 2;
+
+                    float nsPerCall = (float)elapsedNs / calls;
+                    float gbps = (float)len / nsPerCall; // bytes per ns = GB/s
+                    if (resultsFormat == RESULTS_FORMAT_DEFAULT) {
+                        printf("%s,%lu,%d,%d,%f,%f\n", routine->name, len, srcOffset, dstOffset, gbps, nsPerCall);
+                        fflush(stdout);
+                    } else {
+                        char testName[64];
+                        struct result_record record;
+                        snprintf(testName, sizeof(testName), "copysuite:%s", routine->name);
+                        results_new_record(&record, testName, "bandwidth_gbps", gbps);
+                        record.sizeKb = len / 1024;
+                        record.threads = 1;
+                        results_add_param(&record, "bytes", len);
+                        results_add_param(&record, "src_offset", srcOffset);
+                        results_add_param(&record, "dst_offset", dstOffset);
+                        results_add_param(&record, "ns_per_call", nsPerCall);
+                        results_emit(&record);
+                    }
+                }
+            }
+        }
+    }
+
+    free(src);
+    free(dst);
+}
+
+// passes over the array per kernel call with -duration. about 1 MB of traffic per call keeps
+// flag checks cheap and the overshoot past the deadline short. must be even, like GetIterationCount
+uint64_t GetChunkIterations(uint64_t arr_length)
+{
+    uint64_t iterations = (1 << 20) / (arr_length * sizeof(float));
+    if (iterations % 2 != 0) iterations += 1;
+    if (iterations < 2) return 2;
+    else return iterations;
+}
+
 // Writes 7B NOP + return
 void WriteReturn8BBlock(char *dst) {
     dst[0] = 0xF;
@@ -635,10 +1186,16 @@ void FillInstructionArray(uint64_t *nops, uint64_t sizeKb, int nopSize, int bran
 // If coreNode and memNode are set, use the specified numa config
 // otherwise if numa is set to stripe or seq, respect that
 float MeasureBw(uint64_t sizeKb, uint64_t iterations, uint64_t threads, int shared, int nopBytes, int coreNode, int memNode) {
-    struct timeval startTv, endTv;
-    struct timezone startTz, endTz;
+    struct thread_pool *pool;
     float bw = 0;
     uint64_t elements = sizeKb * 1024 / sizeof(float);
+    lastThreadCount = 0;
+
+    // with first touch, workers fill their own array (or slice of the shared one) after they're pinned
+    int workerFill = 0;
+#ifdef NUMA
+    workerFill = numa == NUMA_AUTO && nopBytes == 0;
+#endif
 
     if (!shared && sizeKb < threads) {
         fprintf(stderr, "Too many threads for this test size\n");
@@ -656,124 +1213,75 @@ float MeasureBw(uint64_t sizeKb, uint64_t iterations, uint64_t threads, int shar
     float* testArr = NULL;
     if (shared){
         //testArr = (float*)aligned_alloc(64, elements * sizeof(float));
+#ifdef NUMA
+        // only crossnode and nodescale say where one shared array should go
+        if (numa) testArr = AllocateNumaMemory(elements * sizeof(float), (numa == NUMA_CROSSNODE || numa == NUMA_NODESCALE) ? memNode : -1);
+        else
+#endif
         testArr = allocate_memory(elements * sizeof(float), 0);
         if (testArr == NULL) {
                 fprintf(stderr, "Could not allocate memory\n");
                 return 0;
         }
 
-        if (nopBytes == 0) {
+        if (nopBytes != 0) FillInstructionArray((uint64_t *)testArr, sizeKb, nopBytes, branchInterval);
+        else if (!workerFill) {
             for (uint64_t i = 0; i < elements; i++) {
                 testArr[i] = i + 0.5f;
             }
-        } else FillInstructionArray((uint64_t *)testArr, sizeKb, nopBytes, branchInterval);
+        }
     }
     else
     {
         elements = private_elements; // will fill arrays below, per-thread
     }
 
-    pthread_t* testThreads = (pthread_t*)malloc(threads * sizeof(pthread_t));
     struct BandwidthTestThreadData* threadData = (struct BandwidthTestThreadData*)malloc(threads * sizeof(struct BandwidthTestThreadData));
+    volatile int stopFlag = 0;
+    for (uint64_t i = 0; i < threads; i++) {
 #ifdef NUMA
-    // if numa, tell each thread to set an affinity mask
-    struct bitmask *nodeBitmask = NULL;
-    cpu_set_t cpuset;
-    
-    if (numa == NUMA_CROSSNODE) {
-        nodeBitmask = numa_allocate_cpumask();
-    int nprocs = get_nprocs();
-        numa_node_to_cpus(coreNode, nodeBitmask); 
-    CPU_ZERO(&cpuset);
-
-    // provided functions for manipultaing bitmask don't work
-    // for (int i = 0; i < nprocs; i++)
-    //   if (numa_bitmask_isbitset(nodeBitmask, i)) CPU_SET(i, &cpuset);
-    // bitmask has fields:
-    // - size = number of bits
-    // - maskp = pointer to bitmap
-    // cpu_set_t has field __bits. have to assume it's CPU_SETSIZE bits
-    // also assume bitmap size is divisible by 8 (byte size)
-    memcpy(cpuset.__bits, nodeBitmask->maskp, nodeBitmask->size / 8);
-    }
+        // crossnode and nodescale pass in nodes. other modes decide per thread
+        threadData[i].firstTouch = workerFill;
+        threadData[i].touchStart = 0;
+        threadData[i].touchEnd = elements;
+        if (numa) {
+            if (numa != NUMA_CROSSNODE && numa != NUMA_NODESCALE) NumaPlaceThread(i, &coreNode, &memNode);
+            NumaNodeCpuset(coreNode, &(threadData[i].cpuset));
+        }
 #endif
-
-    for (uint64_t i = 0; i < threads; i++) {
         if (shared)
         {
             threadData[i].arr = testArr;
             threadData[i].iterations = iterations;
+#ifdef NUMA
+            if (workerFill) {
+                // page aligned slices, so each thread's pages land on its own node
+                uint64_t sliceElements = (elements / threads + 1023) & ~1023ULL;
+                threadData[i].touchStart = i * sliceElements < elements ? i * sliceElements : elements;
+                threadData[i].touchEnd = (i + 1) * sliceElements < elements && i < threads - 1 ? (i + 1) * sliceElements : elements;
+            }
+#endif
         }
         else
         {
 #ifdef NUMA
-            int cpuCount = get_nprocs();
-            if (numa == NUMA_CROSSNODE) {
-                threadData[i].arr = numa_alloc_onnode(elements * sizeof(float), memNode);
-                threadData[i].cpuset = cpuset;
-            } else if (numa) {
-                // Figure out which nodes actually have CPUs and memory
-                //int numaNodeCount = numa_max_node() + 1;
-                int numaNodeCount = 4;   // for knl. geez
-                if (numa == NUMA_SEQ) {
-                    // unimplemented
-                    fprintf(stderr, "sequential numa node fill not implemented yet\n");
-                } else if (numa == NUMA_STRIPE) {
-                    memNode = i % numaNodeCount;
-                    coreNode = memNode;
-                } else if (numa == NUMA_DOUBLE_CROSSNODE) {
-                    // hardcode source nodes to 0,1 and destinations 2,3
-		    // edit this later for one-off testing
-                    coreNode = i & 1;
-                    memNode = (i & 1);
-                    fprintf(stderr, "Thread %d: Core %d -> mem %d\n", i, coreNode, memNode);
-                }
-
-                for(int cpuIdx = 0; cpuIdx < get_nprocs(); cpuIdx++) {
-                    CPU_ZERO(&(threadData[i].cpuset));
-                    if(CPU_ISSET(i, &(threadData[i].cpuset))) {
-                        fprintf(stderr, "bitmask not cleared\n");
-                    }
-                }
-
-                threadData[i].arr = numa_alloc_onnode(elements * sizeof(float), memNode);
-
-                for(int cpuIdx = 0; cpuIdx < get_nprocs(); cpuIdx++) {
-                    CPU_ZERO(&(threadData[i].cpuset));
-                    if(CPU_ISSET(i, &(threadData[i].cpuset))) {
-                        fprintf(stderr, "bitmask not cleared\n");
-                    }
-                }
-
-                // cpu node affinity has to be set for each thread
-                nodeBitmask = numa_allocate_cpumask();
-                numa_node_to_cpus(coreNode, nodeBitmask); 
-                CPU_ZERO(&(threadData[i].cpuset));
-                fprintf(stderr, "\tNode %d has CPUs:", coreNode);
-                for (int cpuIdx = 0; cpuIdx < cpuCount; cpuIdx++) { 
-                    if (numa_bitmask_isbitset(nodeBitmask, cpuIdx))  {
-                        CPU_SET(cpuIdx, &(threadData[i].cpuset)); 
-                    }
-                }
-            } else {
-#endif
-                // Not NUMA aware. Allocate memory normally
-		//threadData[i].arr = (float*)aligned_alloc(64, elements * sizeof(float));
-                threadData[i].arr = allocate_memory(elements * sizeof(float), i);
-                if (threadData[i].arr == NULL)
-                {
-                    fprintf(stderr, "Could not allocate memory for thread %ld\n", i);
-                    return 0;
-                }
-#ifdef NUMA
-	}
+            if (numa) threadData[i].arr = AllocateNumaMemory(elements * sizeof(float), memNode);
+            else
 #endif
+            // Not NUMA aware. Allocate memory normally
+            threadData[i].arr = allocate_memory(elements * sizeof(float), i);
+            if (threadData[i].arr == NULL)
+            {
+                fprintf(stderr, "Could not allocate memory for thread %ld\n", i);
+                return 0;
+            }
 
-        if (nopBytes == 0) {
-            for (uint64_t arr_idx = 0; arr_idx < elements; arr_idx++) {
-                threadData[i].arr[arr_idx] = arr_idx + i + 0.5f;
+            if (nopBytes != 0) FillInstructionArray((uint64_t *)threadData[i].arr, elements * sizeof(float) / 1024, nopBytes, branchInterval);
+            else if (!workerFill) {
+                for (uint64_t arr_idx = 0; arr_idx < elements; arr_idx++) {
+                    threadData[i].arr[arr_idx] = arr_idx + i + 0.5f;
+                }
             }
-        } else FillInstructionArray((uint64_t *)threadData[i].arr, elements * sizeof(float) / 1024, nopBytes, branchInterval);
 
             threadData[i].iterations = iterations * threads;
         }
@@ -781,30 +1289,48 @@ float MeasureBw(uint64_t sizeKb, uint64_t iterations, uint64_t threads, int shar
         threadData[i].arr_length = elements;
         threadData[i].bw = 0;
         threadData[i].start = 0;
+        threadData[i].chunks = 1;
+        threadData[i].flag = &stopFlag;
+        if (durationMs) threadData[i].iterations = GetChunkIterations(elements);
         //if (elements > 8192 * 1024) threadData[i].start = 4096 * i; // must be multiple of 128 because of unrolling
-        //int pthreadRc = pthread_create(testThreads + i, NULL, ReadBandwidthTestThread, (void *)(threadData + i));
     }
 
 #ifndef __MINGW32__
     if (pmon) start_perf_monitoring();
 #endif
-    gettimeofday(&startTv, &startTz);
-    for (uint64_t i = 0; i < threads; i++) pthread_create(testThreads + i, NULL, ReadBandwidthTestThread, (void *)(threadData + i));
-    for (uint64_t i = 0; i < threads; i++) pthread_join(testThreads[i], NULL);
-    gettimeofday(&endTv, &endTz);
+    // a throwaway pool still keeps thread creation out of the timestamps. its workers are created after
+    // monitoring is opened, so inherited counters fold their counts back in when they exit
+    pool = (bwPool && bwPool->workerCount >= threads) ? bwPool : pool_create(threads, NULL, 0);
+    pool_run(pool, threads, BandwidthTestThreadPrep, ReadBandwidthTestThread, threadData, sizeof(struct BandwidthTestThreadData));
+
+    // workers take their own timestamps after the start barrier, so thread creation and prep aren't counted.
+    // aggregate bandwidth is everything transferred over the first start to the last finish. summing
+    // per-thread rates would overstate it if threads didn't run at the same time
+    double totalGb = 0;
+    for (uint64_t i = 0; i < threads; i++) {
+        double threadGb = threadData[i].iterations * threadData[i].chunks * sizeof(float) * threadData[i].arr_length / (double)1e9;
+        uint64_t threadNs = pool_worker_time_ns(pool, i);
+        threadData[i].bw = threadNs ? 1e9 * threadGb / (double)threadNs : 0;
+        totalGb += threadGb;
+    }
+
+    uint64_t spanNs = pool_span_ns(pool);
+    bw = spanNs ? 1e9 * totalGb / (double)spanNs : 0;
+
+    lastThreadBw = (float *)realloc(lastThreadBw, threads * sizeof(float));
+    for (uint64_t i = 0; i < threads; i++) lastThreadBw[i] = threadData[i].bw;
+    lastThreadCount = threads;
+    lastStartSkewNs = pool_start_skew_ns(pool);
+    lastEndSkewNs = pool_end_skew_ns(pool);
+
+    if (pool != bwPool) pool_destroy(pool); // only after reading worker timestamps
 #ifndef __MINGW32__
     if (pmon) stop_perf_monitoring();
 #endif
-
-    uint64_t time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
-    double gbTransferred = iterations * sizeof(float) * elements * threads / (double)1e9;
-    bw = 1000 * gbTransferred / (double)time_diff_ms;
-    if (!shared) bw = bw * threads; // iteration count is divided by thread count if in thread private mode
-    //printf("%f GB, %lu ms\n", gbTransferred, time_diff_ms);
 #ifdef NUMA
-    if (numa) numa_free_cpumask(nodeBitmask);
+    if (numa && testArr) numa_free(testArr, elements * sizeof(float));
+    else
 #endif
-    free(testThreads);
     #ifndef HUGEPAGE_HACK
     free(testArr); // should be null in not-shared (private) mode
     #endif
@@ -825,6 +1351,146 @@ float MeasureBw(uint64_t sizeKb, uint64_t iterations, uint64_t threads, int shar
     return bw;
 }
 
+#ifdef NUMA
+// finds nodes with CPUs, so modes that spread threads skip memory-only nodes (like KNL's MCDRAM)
+int NumaInit() {
+    if (numa_available() == -1) {
+        fprintf(stderr, "NUMA is not available\n");
+        return 0;
+    }
+
+    int nodeCount = numa_max_node() + 1;
+    struct bitmask *nodeBitmask = numa_allocate_cpumask();
+    numaCpuNodes = (int *)malloc(sizeof(int) * nodeCount);
+    numaNodeCpuCounts = (int *)calloc(nodeCount, sizeof(int));
+    numaCpuNodeCount = 0;
+    numaTotalCpus = 0;
+    for (int node = 0; node < nodeCount; node++) {
+        if (numa_node_to_cpus(node, nodeBitmask) != 0) continue;
+        numaNodeCpuCounts[node] = numa_bitmask_weight(nodeBitmask);
+        if (numaNodeCpuCounts[node] == 0) continue;
+        numaCpuNodes[numaCpuNodeCount++] = node;
+        numaTotalCpus += numaNodeCpuCounts[node];
+    }
+
+    numa_free_cpumask(nodeBitmask);
+    fprintf(stderr, "%d NUMA nodes, %d with CPUs (%d CPUs total)\n", nodeCount, numaCpuNodeCount, numaTotalCpus);
+    if (numa == NUMA_DOUBLE_CROSSNODE && nodeCount < 4) {
+        fprintf(stderr, "doublecross needs at least 4 NUMA nodes\n");
+        return 0;
+    }
+
+    return numaCpuNodeCount > 0;
+}
+
+void NumaNodeCpuset(int node, cpu_set_t *cpuset) {
+    struct bitmask *nodeBitmask = numa_allocate_cpumask();
+    numa_node_to_cpus(node, nodeBitmask);
+    CPU_ZERO(cpuset);
+    for (int cpuIdx = 0; cpuIdx < nodeBitmask->size && cpuIdx < CPU_SETSIZE; cpuIdx++) {
+        if (numa_bitmask_isbitset(nodeBitmask, cpuIdx)) CPU_SET(cpuIdx, cpuset);
+    }
+
+    numa_free_cpumask(nodeBitmask);
+}
+
+// picks the node a thread runs on for modes that spread threads out. memory is local to it
+void NumaPlaceThread(uint64_t threadIdx, int *coreNode, int *memNode) {
+    if (numa == NUMA_SEQ) {
+        // fill every CPU on one node before moving to the next
+        int cpuIdx = threadIdx % numaTotalCpus;
+        int nodeIdx = 0;
+        while (cpuIdx >= numaNodeCpuCounts[numaCpuNodes[nodeIdx]]) {
+            cpuIdx -= numaNodeCpuCounts[numaCpuNodes[nodeIdx]];
+            nodeIdx++;
+        }
+
+        *coreNode = numaCpuNodes[nodeIdx];
+    } else if (numa == NUMA_DOUBLE_CROSSNODE) {
+        // hardcode source nodes to 0,1 and destinations 2,3
+        // edit this later for one-off testing
+        *coreNode = threadIdx & 1;
+        *memNode = (threadIdx & 1) + 2;
+        return;
+    } else {
+        // stripe, interleave, first touch: round robin across nodes
+        *coreNode = numaCpuNodes[threadIdx % numaCpuNodeCount];
+    }
+
+    *memNode = *coreNode;
+}
+
+// memNode = -1 to leave placement to the OS. always free with numa_free
+void *AllocateNumaMemory(size_t bytes, int memNode) {
+    void *arr;
+    if (numa == NUMA_INTERLEAVE) arr = numa_alloc_interleaved(bytes);
+    else if (numa == NUMA_AUTO || memNode < 0) arr = numa_alloc(bytes);
+    else arr = numa_alloc_onnode(bytes, memNode);
+    if (arr == NULL) fprintf(stderr, "Could not allocate %lu bytes of NUMA memory\n", bytes);
+    return arr;
+}
+
+// for each node with CPUs, scale threads on that node against its local memory and the farthest
+// node with memory, to check memory population and cross-socket bandwidth
+void RunNumaNodeScaling(int sizeKb, int shared, int nopBytes) {
+    int nodeCount = numa_max_node() + 1;
+    if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("CPU node,Mem node,Distance,Threads,Bandwidth (GB/s)\n");
+    for (int nodeIdx = 0; nodeIdx < numaCpuNodeCount; nodeIdx++) {
+        int cpuNode = numaCpuNodes[nodeIdx];
+        int localNode = -1, remoteNode = -1;
+        for (int memNode = 0; memNode < nodeCount; memNode++) {
+            if (numa_node_size64(memNode, NULL) <= 0) continue;
+            if (localNode < 0 || numa_distance(cpuNode, memNode) < numa_distance(cpuNode, localNode)) localNode = memNode;
+            if (remoteNode < 0 || numa_distance(cpuNode, memNode) > numa_distance(cpuNode, remoteNode)) remoteNode = memNode;
+        }
+
+        if (localNode < 0) continue;
+        int memNodes[2] = { localNode, remoteNode };
+        int memNodeCount = remoteNode != localNode ? 2 : 1;
+        for (int memIdx = 0; memIdx < memNodeCount; memIdx++) {
+            int memNode = memNodes[memIdx];
+            fprintf(stderr, "CPU node %d (%d CPUs) <- mem node %d, distance %d\n", cpuNode, numaNodeCpuCounts[cpuNode], memNode, numa_distance(cpuNode, memNode));
+            // powers of two, always finishing with every CPU in the node
+            for (int threads = 1; threads <= numaNodeCpuCounts[cpuNode];
+                 threads = (threads < numaNodeCpuCounts[cpuNode] && threads * 2 > numaNodeCpuCounts[cpuNode]) ? numaNodeCpuCounts[cpuNode] : threads * 2) {
+                float bw = MeasureBw(sizeKb, GetIterationCount(sizeKb, threads), threads, shared, nopBytes, cpuNode, memNode);
+                if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("%d,%d,%d,%d,%f\n", cpuNode, memNode, numa_distance(cpuNode, memNode), threads, bw);
+                else EmitBwRecord(sizeKb, threads, shared, bw, cpuNode, memNode);
+
+            }
+        }
+    }
+}
+#endif
+
+#ifndef __MINGW32__
+// one core per worker, physical cores before SMT siblings. wraps around if there are more workers
+// than cpus we're allowed to run on. NULL if topology couldn't be read
+int *GetPoolCores(int count) {
+    struct cpu_topology topo;
+    cpu_set_t allowed;
+    int *cores = NULL;
+    topology_init(&topo);
+    int *cpus = (int *)malloc(sizeof(int) * topo.cpuCount);
+    int cpuCount = topology_select_cpus(&topo, TOPOLOGY_PHYSICAL, -1, cpus, topo.cpuCount);
+    int allowedCount = 0;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(cpu_set_t), &allowed);
+    for (int i = 0; i < cpuCount; i++) {
+        if (CPU_ISSET(cpus[i], &allowed)) cpus[allowedCount++] = cpus[i];
+    }
+
+    if (allowedCount > 0) {
+        cores = (int *)malloc(sizeof(int) * count);
+        for (int i = 0; i < count; i++) cores[i] = cpus[i % allowedCount];
+    }
+
+    free(cpus);
+    topology_free(&topo);
+    return cores;
+}
+#endif
+
 // one place to make memory allocation calls
 #define HUGEPAGE_HACK_SIZE (1048576*1024)
 void *hugepageBuffer = NULL;
@@ -891,10 +1557,11 @@ float scalar_read(float* arr, uint64_t arr_length, uint64_t iterations, uint64_t
     return sum;
 }
 
-void *ReadBandwidthTestThread(void *param) {
-    BandwidthTestThreadData* bwTestData = (BandwidthTestThreadData*)param;
+// runs on the pool worker before the start barrier
+void BandwidthTestThreadPrep(void *param) {
     if (hardaffinity) sched_setaffinity(gettid(), sizeof(cpu_set_t), &global_cpuset);
 #ifdef NUMA
+    BandwidthTestThreadData* bwTestData = (BandwidthTestThreadData*)param;
     if (numa) {
         int affinity_rc = sched_setaffinity(gettid(), sizeof(cpu_set_t), &(bwTestData->cpuset));
     if (affinity_rc != 0) {
@@ -902,8 +1569,32 @@ void *ReadBandwidthTestThread(void *param) {
         
     }
     }
+
+    // after setting affinity, so pages land on the node this thread runs on
+    if (bwTestData->firstTouch) {
+        for (uint64_t arr_idx = bwTestData->touchStart; arr_idx < bwTestData->touchEnd; arr_idx++) bwTestData->arr[arr_idx] = arr_idx + 0.5f;
+    }
 #endif
-    float sum = bw_func(bwTestData->arr, bwTestData->arr_length, bwTestData->iterations, bwTestData->start);
+}
+
+void ReadBandwidthTestThread(void *param) {
+    BandwidthTestThreadData* bwTestData = (BandwidthTestThreadData*)param;
+    if (durationMs == 0) {
+        float sum = bw_func(bwTestData->arr, bwTestData->arr_length, bwTestData->iterations, bwTestData->start);
+        if (sum == 0) printf("woohoo\n");
+        return;
+    }
+
+    // fixed duration: call the kernel in chunks until time is up. the first thread to get there
+    // stops everyone, so all threads are streaming for the whole measured window
+    uint64_t startTicks;
+    float sum = 0;
+    bwTestData->chunks = 0;
+    start_timing_ns(&startTicks);
+    do {
+        sum += bw_func(bwTestData->arr, bwTestData->arr_length, bwTestData->iterations, bwTestData->start);
+        bwTestData->chunks++;
+        if (end_timing_ns(&startTicks) >= durationMs * 1000000) *(bwTestData->flag) = 1;
+    } while (!*(bwTestData->flag));
     if (sum == 0) printf("woohoo\n");
-    pthread_exit(NULL);
 }
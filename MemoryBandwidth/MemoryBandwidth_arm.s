@@ -6,6 +6,15 @@
 .global asm_cflip
 .global asm_copy
 .global asm_add
+.global asm_ntwrite
+.global asm_ntcopy
+.global asm_zvawrite
+.global asm_mix
+.global asm_mix_nt
+.global asm_memcpy
+.global asm_ntmemcpy
+.global asm_memset
+.global asm_ntmemset
 .global flush_icache
 .global readbankconflict
 .global readbankconflict128
@@ -15,6 +24,15 @@
 .global _asm_cflip
 .global _asm_copy
 .global _asm_add
+.global _asm_ntwrite
+.global _asm_ntcopy
+.global _asm_zvawrite
+.global _asm_mix
+.global _asm_mix_nt
+.global _asm_memcpy
+.global _asm_ntmemcpy
+.global _asm_memset
+.global _asm_ntmemset
 .global _flush_icache
 .global _readbankconflict
 
@@ -484,6 +502,454 @@ asm_add_pass_loop:
   ret
 
 
+/* x0 = ptr to array (was rcx)
+ * x1 = arr length (was rdx)
+ * x2 = iterations (was r8)
+ * x3 = start (was r9)
+ */
+/* asm_write with stnp */
+_asm_ntwrite:
+asm_ntwrite:
+  sub sp, sp, #0x30
+  stp x14, x15, [sp, #0x10]
+  stp x12, x13, [sp, #0x20]
+  sub x1, x1, 128 /* last iteration: rsi == rdx. rsi > rdx = break */
+  mov x14, x3     /* set x14 = index into array to start location (x3) */
+  eor x13, x13, x13 /* x13 = 0 (for comparison) */
+  ldr q16, [x0]
+asm_ntwrite_pass_loop:
+  lsl x12, x14, 2  /* x12 = x14 * 4, because float is 4B */
+  add x15, x0, x12 /* ptr (x15) to next element = x0 (base) + x12 (index *4) */
+  stnp q16, q16, [x15]
+  stnp q16, q16, [x15, 32]
+  stnp q16, q16, [x15, 64]
+  stnp q16, q16, [x15, 96]
+  add x14, x14, 32
+
+  lsl x12, x14, 2
+  add x15, x0, x12
+  stnp q16, q16, [x15]
+  stnp q16, q16, [x15, 32]
+  stnp q16, q16, [x15, 64]
+  stnp q16, q16, [x15, 96]
+  add x14, x14, 32
+
+  lsl x12, x14, 2
+  add x15, x0, x12
+  stnp q16, q16, [x15]
+  stnp q16, q16, [x15, 32]
+  stnp q16, q16, [x15, 64]
+  stnp q16, q16, [x15, 96]
+  add x14, x14, 32
+
+  lsl x12, x14, 2
+  add x15, x0, x12
+  stnp q16, q16, [x15]
+  stnp q16, q16, [x15, 32]
+  stnp q16, q16, [x15, 64]
+  stnp q16, q16, [x15, 96]
+  add x14, x14, 32
+
+  cmp x1, x14 /* if x1 (len - 128) - x14 < 0, loop back around */
+  csel x14, x13, x14, LT
+  cmp x14, x3
+  b.ne asm_ntwrite_pass_loop /* skip iteration decrement if we're not back to start */
+  sub x2, x2, 1
+  cbnz x2, asm_ntwrite_pass_loop
+  add v0.4s, v16.4s, v16.4s
+  ldp x12, x13, [sp, #0x20]
+  ldp x14, x15, [sp, #0x10]
+  add sp, sp, #0x30
+  ret
+
+/* x0 = ptr to array (was rcx)
+ * x1 = arr length (was rdx)
+ * x2 = iterations (was r8)
+ * x3 = start (was r9)
+ */
+/* asm_copy with ldnp/stnp */
+_asm_ntcopy:
+asm_ntcopy:
+  sub sp, sp, #0x50
+  stp x14, x15, [sp, #0x10]
+  stp x12, x13, [sp, #0x20]
+  stp x10, x11, [sp, #0x30]
+  stp x8, x9, [sp, #0x40]
+  asr x11, x1, 1    /* x11 = destination index (length / 2) */
+  sub x1, x1, 128
+  mov x10, x11      /* use x10 as index into destination */
+  mov x14, x3     /* set x14 = index into array to start location (x3) */
+  eor x13, x13, x13 /* x13 = 0 (for comparison) */
+asm_ntcopy_pass_loop:
+  lsl x12, x14, 2  /* x12 = x14 * 4, because float is 4B */
+  add x15, x0, x12 /* ptr (x15) to next element = x0 (base) + x12 (index *4) */
+  lsl x12, x10, 2  /* x12 = x10 * 4, to calculate destination */
+  add x9, x0, x12  /* x9 = ptr to destination */
+  ldnp q16, q17, [x15]
+  ldnp q18, q19, [x15, 32]
+  ldnp q20, q21, [x15, 64]
+  ldnp q22, q23, [x15, 96]
+  stnp q16, q17, [x9]
+  stnp q18, q19, [x9, 32]
+  stnp q20, q21, [x9, 64]
+  stnp q22, q23, [x9, 96]
+  add x14, x14, 32
+  add x10, x10, 32
+
+  lsl x12, x14, 2
+  add x15, x0, x12
+  lsl x12, x10, 2
+  add x9, x0, x12
+  ldnp q16, q17, [x15]
+  ldnp q18, q19, [x15, 32]
+  ldnp q20, q21, [x15, 64]
+  ldnp q22, q23, [x15, 96]
+  stnp q16, q17, [x9]
+  stnp q18, q19, [x9, 32]
+  stnp q20, q21, [x9, 64]
+  stnp q22, q23, [x9, 96]
+  add x14, x14, 32
+  add x10, x10, 32
+
+  cmp x1, x10 /* if destination hits end, loop around */
+  csel x14, x13, x14, LT
+  csel x10, x11, x10, LT
+  cmp x14, x3
+  b.ne asm_ntcopy_pass_loop /* skip iteration decrement if we're not back to start */
+  sub x2, x2, 1
+  cbnz x2, asm_ntcopy_pass_loop
+  add v0.4s, v16.4s, v16.4s
+  ldp x8, x9, [sp, #0x40]
+  ldp x10, x11, [sp, #0x30]
+  ldp x12, x13, [sp, #0x20]
+  ldp x14, x15, [sp, #0x10]
+  add sp, sp, #0x50
+  ret
+
+/* x0 = ptr to array
+ * x1 = arr length, in fp32 elements
+ * x2 = iterations
+ * zeroes the array with dc zva, using the block size from dczid_el0. Only whole
+ * blocks inside the array are zeroed, so caller should check dc zva isn't prohibited
+ */
+_asm_zvawrite:
+asm_zvawrite:
+  mrs x9, dczid_el0
+  and x9, x9, 15
+  mov x10, 4
+  lsl x10, x10, x9  /* x10 = block size in bytes (dczid_el0 gives log2 of 4B words) */
+  sub x12, x10, 1
+  add x13, x0, x12
+  bic x13, x13, x12 /* x13 = first block-aligned address in the array */
+  add x1, x0, x1, lsl 2
+  bic x1, x1, x12   /* x1 = end of array, rounded down to a block */
+asm_zvawrite_pass_loop:
+  mov x11, x13
+  cmp x11, x1
+  b.hs asm_zvawrite_pass_end
+asm_zvawrite_block_loop:
+  dc zva, x11
+  add x11, x11, x10
+  cmp x11, x1
+  b.lo asm_zvawrite_block_loop
+asm_zvawrite_pass_end:
+  sub x2, x2, 1
+  cbnz x2, asm_zvawrite_pass_loop
+  dsb ish
+  ldr s0, [x0]
+  ret
+
+/* x0 = ptr to array
+ * x1 = arr length, in fp32 elements
+ * x2 = iterations
+ * x3 = ptr to {start, lines to read, lines to write}
+ * reads R 64B lines, then writes W lines, and repeats. The group carries across the
+ * wrap so every line is touched once per pass
+ */
+_asm_mix:
+asm_mix:
+  ldp x9, x10, [x3]     /* x9 = start, x10 = lines to read per group */
+  ldr x11, [x3, 16]     /* x11 = lines to write per group */
+  add x9, x0, x9, lsl 2 /* x9 = start address, a pass is done when we get back here */
+  add x1, x0, x1, lsl 2 /* x1 = end of array */
+  mov x12, x9
+  ldp q0, q1, [x12]
+  ldp q2, q3, [x12, 32]
+  mov v16.16b, v0.16b   /* q16 = value to write */
+asm_mix_group:
+  mov x13, x10
+  cbz x13, asm_mix_write
+asm_mix_read_loop:
+  ldp q4, q5, [x12]
+  ldp q6, q7, [x12, 32]
+  fadd v0.4s, v0.4s, v4.4s
+  fadd v1.4s, v1.4s, v5.4s
+  fadd v2.4s, v2.4s, v6.4s
+  fadd v3.4s, v3.4s, v7.4s
+  add x12, x12, 64
+  cmp x12, x1
+  csel x12, x0, x12, eq /* back to start of array */
+  cmp x12, x9
+  b.ne asm_mix_read_count
+  subs x2, x2, 1
+  b.eq asm_mix_end
+asm_mix_read_count:
+  subs x13, x13, 1
+  b.ne asm_mix_read_loop
+asm_mix_write:
+  mov x13, x11
+  cbz x13, asm_mix_group
+asm_mix_write_loop:
+  stp q16, q16, [x12]
+  stp q16, q16, [x12, 32]
+  add x12, x12, 64
+  cmp x12, x1
+  csel x12, x0, x12, eq
+  cmp x12, x9
+  b.ne asm_mix_write_count
+  subs x2, x2, 1
+  b.eq asm_mix_end
+asm_mix_write_count:
+  subs x13, x13, 1
+  b.ne asm_mix_write_loop
+  b asm_mix_group
+asm_mix_end:
+  fadd v0.4s, v0.4s, v1.4s
+  fadd v2.4s, v2.4s, v3.4s
+  fadd v0.4s, v0.4s, v2.4s
+  ret
+
+/* same as asm_mix, with stnp */
+_asm_mix_nt:
+asm_mix_nt:
+  ldp x9, x10, [x3]     /* x9 = start, x10 = lines to read per group */
+  ldr x11, [x3, 16]     /* x11 = lines to write per group */
+  add x9, x0, x9, lsl 2 /* x9 = start address, a pass is done when we get back here */
+  add x1, x0, x1, lsl 2 /* x1 = end of array */
+  mov x12, x9
+  ldp q0, q1, [x12]
+  ldp q2, q3, [x12, 32]
+  mov v16.16b, v0.16b   /* q16 = value to write */
+asm_mix_nt_group:
+  mov x13, x10
+  cbz x13, asm_mix_nt_write
+asm_mix_nt_read_loop:
+  ldp q4, q5, [x12]
+  ldp q6, q7, [x12, 32]
+  fadd v0.4s, v0.4s, v4.4s
+  fadd v1.4s, v1.4s, v5.4s
+  fadd v2.4s, v2.4s, v6.4s
+  fadd v3.4s, v3.4s, v7.4s
+  add x12, x12, 64
+  cmp x12, x1
+  csel x12, x0, x12, eq /* back to start of array */
+  cmp x12, x9
+  b.ne asm_mix_nt_read_count
+  subs x2, x2, 1
+  b.eq asm_mix_nt_end
+asm_mix_nt_read_count:
+  subs x13, x13, 1
+  b.ne asm_mix_nt_read_loop
+asm_mix_nt_write:
+  mov x13, x11
+  cbz x13, asm_mix_nt_group
+asm_mix_nt_write_loop:
+  stnp q16, q16, [x12]
+  stnp q16, q16, [x12, 32]
+  add x12, x12, 64
+  cmp x12, x1
+  csel x12, x0, x12, eq
+  cmp x12, x9
+  b.ne asm_mix_nt_write_count
+  subs x2, x2, 1
+  b.eq asm_mix_nt_end
+asm_mix_nt_write_count:
+  subs x13, x13, 1
+  b.ne asm_mix_nt_write_loop
+  b asm_mix_nt_group
+asm_mix_nt_end:
+  fadd v0.4s, v0.4s, v1.4s
+  fadd v2.4s, v2.4s, v3.4s
+  fadd v0.4s, v0.4s, v2.4s
+  ret
+
+/* memcpy/memset style routines for the copy suite
+ * x0 = dst, x1 = src, x2 = length in bytes
+ * the last 32 bytes are loaded up front and stored at the end, so the loops never
+ * have to deal with a partial vector
+ */
+_asm_memcpy:
+asm_memcpy:
+  cmp x2, 32
+  b.lo asm_memcpy_small
+  add x9, x1, x2
+  ldp q4, q5, [x9, -32]
+  add x10, x0, x2   /* x10 = end of dst */
+  sub x2, x2, 32    /* x2 = bytes left before the tail */
+  cmp x2, 128
+  b.lo asm_memcpy_vec
+asm_memcpy_loop:
+  ldp q0, q1, [x1]
+  ldp q2, q3, [x1, 32]
+  ldp q16, q17, [x1, 64]
+  ldp q18, q19, [x1, 96]
+  stp q0, q1, [x0]
+  stp q2, q3, [x0, 32]
+  stp q16, q17, [x0, 64]
+  stp q18, q19, [x0, 96]
+  add x1, x1, 128
+  add x0, x0, 128
+  sub x2, x2, 128
+  cmp x2, 128
+  b.hs asm_memcpy_loop
+asm_memcpy_vec:
+  cbz x2, asm_memcpy_tail
+asm_memcpy_vec_loop:
+  ldp q0, q1, [x1]
+  stp q0, q1, [x0]
+  add x1, x1, 32
+  add x0, x0, 32
+  subs x2, x2, 32
+  b.hi asm_memcpy_vec_loop
+asm_memcpy_tail:
+  stp q4, q5, [x10, -32]
+  ret
+asm_memcpy_small:
+  cmp x2, 16
+  b.lo asm_memcpy_bytes
+  add x9, x1, x2
+  add x10, x0, x2
+  ldr q0, [x1]
+  ldr q1, [x9, -16]
+  str q0, [x0]
+  str q1, [x10, -16]
+  ret
+asm_memcpy_bytes:
+  cbz x2, asm_memcpy_done
+asm_memcpy_byte_loop:
+  ldrb w9, [x1], 1
+  strb w9, [x0], 1
+  subs x2, x2, 1
+  b.ne asm_memcpy_byte_loop
+asm_memcpy_done:
+  ret
+
+
+/* asm_memcpy with ldnp/stnp in the main loops */
+_asm_ntmemcpy:
+asm_ntmemcpy:
+  cmp x2, 32
+  b.lo asm_memcpy_small
+  add x9, x1, x2
+  ldp q4, q5, [x9, -32]
+  add x10, x0, x2   /* x10 = end of dst */
+  sub x2, x2, 32    /* x2 = bytes left before the tail */
+  cmp x2, 128
+  b.lo asm_ntmemcpy_vec
+asm_ntmemcpy_loop:
+  ldnp q0, q1, [x1]
+  ldnp q2, q3, [x1, 32]
+  ldnp q16, q17, [x1, 64]
+  ldnp q18, q19, [x1, 96]
+  stnp q0, q1, [x0]
+  stnp q2, q3, [x0, 32]
+  stnp q16, q17, [x0, 64]
+  stnp q18, q19, [x0, 96]
+  add x1, x1, 128
+  add x0, x0, 128
+  sub x2, x2, 128
+  cmp x2, 128
+  b.hs asm_ntmemcpy_loop
+asm_ntmemcpy_vec:
+  cbz x2, asm_ntmemcpy_tail
+asm_ntmemcpy_vec_loop:
+  ldnp q0, q1, [x1]
+  stnp q0, q1, [x0]
+  add x1, x1, 32
+  add x0, x0, 32
+  subs x2, x2, 32
+  b.hi asm_ntmemcpy_vec_loop
+asm_ntmemcpy_tail:
+  stp q4, q5, [x10, -32]
+  ret
+
+
+/* fills with zero, since that's the common case (page zeroing, calloc) */
+_asm_memset:
+asm_memset:
+  movi v0.16b, 0
+  cmp x2, 32
+  b.lo asm_memset_small
+  add x10, x0, x2
+  sub x2, x2, 32
+  cmp x2, 128
+  b.lo asm_memset_vec
+asm_memset_loop:
+  stp q0, q0, [x0]
+  stp q0, q0, [x0, 32]
+  stp q0, q0, [x0, 64]
+  stp q0, q0, [x0, 96]
+  add x0, x0, 128
+  sub x2, x2, 128
+  cmp x2, 128
+  b.hs asm_memset_loop
+asm_memset_vec:
+  cbz x2, asm_memset_tail
+asm_memset_vec_loop:
+  stp q0, q0, [x0]
+  add x0, x0, 32
+  subs x2, x2, 32
+  b.hi asm_memset_vec_loop
+asm_memset_tail:
+  stp q0, q0, [x10, -32]
+  ret
+asm_memset_small:
+  cmp x2, 16
+  b.lo asm_memset_bytes
+  add x10, x0, x2
+  str q0, [x0]
+  str q0, [x10, -16]
+  ret
+asm_memset_bytes:
+  cbz x2, asm_memset_done
+asm_memset_byte_loop:
+  strb wzr, [x0], 1
+  subs x2, x2, 1
+  b.ne asm_memset_byte_loop
+asm_memset_done:
+  ret
+
+
+/* asm_memset with stnp in the main loops */
+_asm_ntmemset:
+asm_ntmemset:
+  movi v0.16b, 0
+  cmp x2, 32
+  b.lo asm_memset_small
+  add x10, x0, x2
+  sub x2, x2, 32
+  cmp x2, 128
+  b.lo asm_ntmemset_vec
+asm_ntmemset_loop:
+  stnp q0, q0, [x0]
+  stnp q0, q0, [x0, 32]
+  stnp q0, q0, [x0, 64]
+  stnp q0, q0, [x0, 96]
+  add x0, x0, 128
+  sub x2, x2, 128
+  cmp x2, 128
+  b.hs asm_ntmemset_loop
+asm_ntmemset_vec:
+  cbz x2, asm_ntmemset_tail
+asm_ntmemset_vec_loop:
+  stnp q0, q0, [x0]
+  add x0, x0, 32
+  subs x2, x2, 32
+  b.hi asm_ntmemset_vec_loop
+asm_ntmemset_tail:
+  stp q0, q0, [x10, -32]
+  ret
+
 /* Tests for cache bank conflicts by reading from two locations, spaced by some
    number of bytes
    x0 = ptr to array. first 32-bit int = increment step, because I'm too lazy to mess with the stack
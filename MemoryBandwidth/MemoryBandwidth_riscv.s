@@ -5,6 +5,7 @@
 .global asm_cflip
 .global asm_copy
 .global asm_add
+.global asm_mix
 .global flush_icache
 .global readbankconflict
 .global readbankconflict128
@@ -144,6 +145,78 @@ asm_add_pass_loop:
 asm_cflip:
   ret
 
+/* a0 = arr, a1 = arr_len, a2 = iterations, a3 = ptr to {start, lines to read, lines to write}
+   scalar, since there's no non-temporal store to test. Reads R 64B lines, then writes W lines,
+   and repeats. The group carries across the wrap so every line is touched once per pass */
+asm_mix:
+  ld t0, (a3)
+  ld t1, 8(a3)        /* t1 = lines to read per group */
+  ld t2, 16(a3)       /* t2 = lines to write per group */
+  slli t0, t0, 2
+  add t0, t0, a0      /* t0 = start address, a pass is done when we get back here */
+  slli a1, a1, 2
+  add a1, a1, a0      /* a1 = end of array */
+  mv t3, t0           /* t3 = current address */
+  ld t5, (t3)         /* t5 = value to write */
+  mv a4, x0
+  mv a5, x0
+asm_mix_group:
+  mv t4, t1
+  beqz t4, asm_mix_write
+asm_mix_read_loop:
+  ld t6, (t3)
+  add a4, a4, t6
+  ld t6, 8(t3)
+  add a5, a5, t6
+  ld t6, 16(t3)
+  add a4, a4, t6
+  ld t6, 24(t3)
+  add a5, a5, t6
+  ld t6, 32(t3)
+  add a4, a4, t6
+  ld t6, 40(t3)
+  add a5, a5, t6
+  ld t6, 48(t3)
+  add a4, a4, t6
+  ld t6, 56(t3)
+  add a5, a5, t6
+  addi t3, t3, 64
+  bne t3, a1, asm_mix_read_wrapped
+  mv t3, a0           /* back to start of array */
+asm_mix_read_wrapped:
+  bne t3, t0, asm_mix_read_count
+  addi a2, a2, -1
+  beqz a2, asm_mix_end
+asm_mix_read_count:
+  addi t4, t4, -1
+  bnez t4, asm_mix_read_loop
+asm_mix_write:
+  mv t4, t2
+  beqz t4, asm_mix_group
+asm_mix_write_loop:
+  sd t5, (t3)
+  sd t5, 8(t3)
+  sd t5, 16(t3)
+  sd t5, 24(t3)
+  sd t5, 32(t3)
+  sd t5, 40(t3)
+  sd t5, 48(t3)
+  sd t5, 56(t3)
+  addi t3, t3, 64
+  bne t3, a1, asm_mix_write_wrapped
+  mv t3, a0
+asm_mix_write_wrapped:
+  bne t3, t0, asm_mix_write_count
+  addi a2, a2, -1
+  beqz a2, asm_mix_end
+asm_mix_write_count:
+  addi t4, t4, -1
+  bnez t4, asm_mix_write_loop
+  j asm_mix_group
+asm_mix_end:
+  flw fa0, (a0)
+  ret
+
 readbankconflict:
   ret
 
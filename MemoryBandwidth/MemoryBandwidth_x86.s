@@ -8,10 +8,18 @@
 .global sse_read
 .global sse_write
 .global sse_ntwrite
+.global sse_ntcopy
+.global avx_ntwrite
+.global avx_ntcopy
 .global avx512_read
 .global avx512_write
 .global avx512_copy
 .global avx512_add
+.global avx512_ntwrite
+.global avx512_ntcopy
+.global clzero_write
+.global mix_avx
+.global mix_avx_nt
 .global readbankconflict
 .global readbankconflict128
 
@@ -20,6 +28,13 @@
 .global repmovsb_copy
 .global repmovsd_copy
 
+.global avx_memcpy
+.global avx_ntmemcpy
+.global avx_memset
+.global avx_ntmemset
+.global repmovsb_memcpy
+.global repstosb_memset
+
 asm_read:
   push %rsi
   push %rdi
@@ -833,6 +848,665 @@ repstosd_copy_pass_loop:
   ret   
 
 
+/* non-temporal writes, same structure as sse_ntwrite */
+avx_ntwrite:
+  push %rsi
+  push %rdi
+  push %rbx
+  push %r15
+  push %r14
+  mov $256, %r15 /* write in blocks of 256 bytes */
+  sub $128, %rdx /* last iteration: rsi == rdx. rsi > rdx = break */
+  mov %r9, %rsi  /* assume we're passed in an aligned start location O.o */
+  xor %rbx, %rbx
+  lea (%rcx,%rsi,4), %rdi
+  mov %rdi, %r14
+  vmovaps (%rdi), %ymm0
+  vmovaps 32(%rdi), %ymm1
+  vmovaps 64(%rdi), %ymm2
+  vmovaps 96(%rdi), %ymm3
+avx_ntwrite_pass_loop:
+  vmovntps %ymm0, (%rdi)
+  vmovntps %ymm1, 32(%rdi)
+  vmovntps %ymm2, 64(%rdi)
+  vmovntps %ymm3, 96(%rdi)
+  vmovntps %ymm0, 128(%rdi)
+  vmovntps %ymm1, 160(%rdi)
+  vmovntps %ymm2, 192(%rdi)
+  vmovntps %ymm3, 224(%rdi)
+  add $64, %rsi
+  add %r15, %rdi
+  vmovntps %ymm0, (%rdi)
+  vmovntps %ymm1, 32(%rdi)
+  vmovntps %ymm2, 64(%rdi)
+  vmovntps %ymm3, 96(%rdi)
+  vmovntps %ymm0, 128(%rdi)
+  vmovntps %ymm1, 160(%rdi)
+  vmovntps %ymm2, 192(%rdi)
+  vmovntps %ymm3, 224(%rdi)
+  add $64, %rsi
+  add %r15, %rdi
+  cmp %rsi, %rdx
+  jge avx_ntwrite_iteration_count
+  mov %rbx, %rsi
+  lea (%rcx,%rsi,4), %rdi /* back to start */
+avx_ntwrite_iteration_count:
+  cmp %rsi, %r9
+  jnz avx_ntwrite_pass_loop /* skip iteration decrement if we're not back to start */
+  dec %r8
+  jnz avx_ntwrite_pass_loop
+  sfence /* NT stores are weakly ordered */
+  vzeroupper
+  movss (%rcx), %xmm0
+  pop %r14
+  pop %r15
+  pop %rbx
+  pop %rdi
+  pop %rsi
+  ret
+
+
+/* non-temporal writes, same structure as sse_ntwrite */
+avx512_ntwrite:
+  push %rsi
+  push %rdi
+  push %rbx
+  push %r15
+  push %r14
+  mov $256, %r15 /* write in blocks of 256 bytes */
+  sub $128, %rdx /* last iteration: rsi == rdx. rsi > rdx = break */
+  mov %r9, %rsi  /* assume we're passed in an aligned start location O.o */
+  xor %rbx, %rbx
+  lea (%rcx,%rsi,4), %rdi
+  mov %rdi, %r14
+  vmovaps (%rdi), %zmm0
+  vmovaps 64(%rdi), %zmm1
+  vmovaps 128(%rdi), %zmm2
+  vmovaps 192(%rdi), %zmm3
+avx512_ntwrite_pass_loop:
+  vmovntps %zmm0, (%rdi)
+  vmovntps %zmm1, 64(%rdi)
+  vmovntps %zmm2, 128(%rdi)
+  vmovntps %zmm3, 192(%rdi)
+  add $64, %rsi
+  add %r15, %rdi
+  vmovntps %zmm0, (%rdi)
+  vmovntps %zmm1, 64(%rdi)
+  vmovntps %zmm2, 128(%rdi)
+  vmovntps %zmm3, 192(%rdi)
+  add $64, %rsi
+  add %r15, %rdi
+  cmp %rsi, %rdx
+  jge avx512_ntwrite_iteration_count
+  mov %rbx, %rsi
+  lea (%rcx,%rsi,4), %rdi /* back to start */
+avx512_ntwrite_iteration_count:
+  cmp %rsi, %r9
+  jnz avx512_ntwrite_pass_loop /* skip iteration decrement if we're not back to start */
+  dec %r8
+  jnz avx512_ntwrite_pass_loop
+  sfence /* NT stores are weakly ordered */
+  vzeroupper
+  movss (%rcx), %xmm0
+  pop %r14
+  pop %r15
+  pop %rbx
+  pop %rdi
+  pop %rsi
+  ret
+
+
+/* copies one half of the array to the other with non-temporal stores, like asm_copy */
+sse_ntcopy:
+  push %rsi
+  push %rdi
+  push %rbx
+  push %r15
+  push %r14
+  push %r13
+  xor %rsi, %rsi
+  mov %rdx, %r9
+  shr $1, %r9    /* start destination at array + length / 2 */
+  mov $256, %r15 /* copy in blocks of 256 bytes */
+  mov %r9, %r13
+  sub $64, %r13 /* place loop limit 256B before end */
+  lea (%rcx,%rsi,4), %rdi
+  lea (%rcx,%r9,4), %r14
+sse_ntcopy_pass_loop:
+  movaps (%rdi), %xmm0
+  movaps 16(%rdi), %xmm1
+  movaps 32(%rdi), %xmm2
+  movaps 48(%rdi), %xmm3
+  movntps %xmm0, (%r14)
+  movntps %xmm1, 16(%r14)
+  movntps %xmm2, 32(%r14)
+  movntps %xmm3, 48(%r14)
+  movaps 64(%rdi), %xmm0
+  movaps 80(%rdi), %xmm1
+  movaps 96(%rdi), %xmm2
+  movaps 112(%rdi), %xmm3
+  movntps %xmm0, 64(%r14)
+  movntps %xmm1, 80(%r14)
+  movntps %xmm2, 96(%r14)
+  movntps %xmm3, 112(%r14)
+  movaps 128(%rdi), %xmm0
+  movaps 144(%rdi), %xmm1
+  movaps 160(%rdi), %xmm2
+  movaps 176(%rdi), %xmm3
+  movntps %xmm0, 128(%r14)
+  movntps %xmm1, 144(%r14)
+  movntps %xmm2, 160(%r14)
+  movntps %xmm3, 176(%r14)
+  movaps 192(%rdi), %xmm0
+  movaps 208(%rdi), %xmm1
+  movaps 224(%rdi), %xmm2
+  movaps 240(%rdi), %xmm3
+  movntps %xmm0, 192(%r14)
+  movntps %xmm1, 208(%r14)
+  movntps %xmm2, 224(%r14)
+  movntps %xmm3, 240(%r14)
+  add $64, %rsi
+  add %r15, %rdi  /* increment src/dst pointers */
+  add %r15, %r14
+  cmp %rsi, %r13   /* end location is at half */
+  jge sse_ntcopy_pass_loop
+  xor %rsi, %rsi
+  lea (%rcx,%rsi,4), %rdi /* back to start */
+  lea (%rcx,%r9,4), %r14
+  dec %r8                 /* decrement iteration counter */
+  jnz sse_ntcopy_pass_loop
+  sfence
+  movss (%rcx), %xmm0
+  pop %r13
+  pop %r14
+  pop %r15
+  pop %rbx
+  pop %rdi
+  pop %rsi
+  ret
+
+
+/* sse_ntcopy with 32B vectors */
+avx_ntcopy:
+  push %rsi
+  push %rdi
+  push %rbx
+  push %r15
+  push %r14
+  push %r13
+  xor %rsi, %rsi
+  mov %rdx, %r9
+  shr $1, %r9    /* start destination at array + length / 2 */
+  mov $256, %r15 /* copy in blocks of 256 bytes */
+  mov %r9, %r13
+  sub $64, %r13 /* place loop limit 256B before end */
+  lea (%rcx,%rsi,4), %rdi
+  lea (%rcx,%r9,4), %r14
+avx_ntcopy_pass_loop:
+  vmovaps (%rdi), %ymm0
+  vmovaps 32(%rdi), %ymm1
+  vmovaps 64(%rdi), %ymm2
+  vmovaps 96(%rdi), %ymm3
+  vmovntps %ymm0, (%r14)
+  vmovntps %ymm1, 32(%r14)
+  vmovntps %ymm2, 64(%r14)
+  vmovntps %ymm3, 96(%r14)
+  vmovaps 128(%rdi), %ymm0
+  vmovaps 160(%rdi), %ymm1
+  vmovaps 192(%rdi), %ymm2
+  vmovaps 224(%rdi), %ymm3
+  vmovntps %ymm0, 128(%r14)
+  vmovntps %ymm1, 160(%r14)
+  vmovntps %ymm2, 192(%r14)
+  vmovntps %ymm3, 224(%r14)
+  add $64, %rsi
+  add %r15, %rdi  /* increment src/dst pointers */
+  add %r15, %r14
+  cmp %rsi, %r13   /* end location is at half */
+  jge avx_ntcopy_pass_loop
+  xor %rsi, %rsi
+  lea (%rcx,%rsi,4), %rdi /* back to start */
+  lea (%rcx,%r9,4), %r14
+  dec %r8                 /* decrement iteration counter */
+  jnz avx_ntcopy_pass_loop
+  sfence
+  vzeroupper
+  movss (%rcx), %xmm0
+  pop %r13
+  pop %r14
+  pop %r15
+  pop %rbx
+  pop %rdi
+  pop %rsi
+  ret
+
+
+/* sse_ntcopy with 64B vectors */
+avx512_ntcopy:
+  push %rsi
+  push %rdi
+  push %rbx
+  push %r15
+  push %r14
+  push %r13
+  xor %rsi, %rsi
+  mov %rdx, %r9
+  shr $1, %r9    /* start destination at array + length / 2 */
+  mov $256, %r15 /* copy in blocks of 256 bytes */
+  mov %r9, %r13
+  sub $64, %r13 /* place loop limit 256B before end */
+  lea (%rcx,%rsi,4), %rdi
+  lea (%rcx,%r9,4), %r14
+avx512_ntcopy_pass_loop:
+  vmovaps (%rdi), %zmm0
+  vmovaps 64(%rdi), %zmm1
+  vmovaps 128(%rdi), %zmm2
+  vmovaps 192(%rdi), %zmm3
+  vmovntps %zmm0, (%r14)
+  vmovntps %zmm1, 64(%r14)
+  vmovntps %zmm2, 128(%r14)
+  vmovntps %zmm3, 192(%r14)
+  add $64, %rsi
+  add %r15, %rdi  /* increment src/dst pointers */
+  add %r15, %r14
+  cmp %rsi, %r13   /* end location is at half */
+  jge avx512_ntcopy_pass_loop
+  xor %rsi, %rsi
+  lea (%rcx,%rsi,4), %rdi /* back to start */
+  lea (%rcx,%r9,4), %r14
+  dec %r8                 /* decrement iteration counter */
+  jnz avx512_ntcopy_pass_loop
+  sfence
+  vzeroupper
+  movss (%rcx), %xmm0
+  pop %r13
+  pop %r14
+  pop %r15
+  pop %rbx
+  pop %rdi
+  pop %rsi
+  ret
+
+
+/* rcx = ptr to arr, rdx = nr of fp32 elements in arr, r8 = iteration count,
+   r9 = ptr to {start, lines to read, lines to write}. Reads R 64B lines, then writes
+   W lines, and repeats. The group carries across the wrap so every line is touched once per pass */
+mix_avx:
+  push %rsi
+  push %rdi
+  push %rbx
+  push %r15
+  push %r14
+  mov 8(%r9), %r14          /* r14 = lines to read per group */
+  mov 16(%r9), %r15         /* r15 = lines to write per group */
+  mov (%r9), %rbx
+  lea (%rcx,%rbx,4), %r9    /* r9 = start address, a pass is done when we get back here */
+  lea (%rcx,%rdx,4), %rdx   /* rdx = end of array */
+  mov %r9, %rdi
+  vmovaps (%rdi), %ymm0
+  vmovaps 32(%rdi), %ymm1
+  vmovaps %ymm0, %ymm2      /* ymm2 = value to write */
+mix_avx_group:
+  mov %r14, %rsi
+  test %rsi, %rsi
+  jz mix_avx_write
+mix_avx_read_loop:
+  vaddps (%rdi), %ymm0, %ymm0
+  vaddps 32(%rdi), %ymm1, %ymm1
+  add $64, %rdi
+  cmp %rdi, %rdx
+  jne mix_avx_read_wrapped
+  mov %rcx, %rdi            /* back to start of array */
+mix_avx_read_wrapped:
+  cmp %rdi, %r9
+  jne mix_avx_read_count     /* skip iteration decrement if we're not back to start */
+  dec %r8
+  jz mix_avx_end
+mix_avx_read_count:
+  dec %rsi
+  jnz mix_avx_read_loop
+mix_avx_write:
+  mov %r15, %rsi
+  test %rsi, %rsi
+  jz mix_avx_group
+mix_avx_write_loop:
+  vmovaps %ymm2, (%rdi)
+  vmovaps %ymm2, 32(%rdi)
+  add $64, %rdi
+  cmp %rdi, %rdx
+  jne mix_avx_write_wrapped
+  mov %rcx, %rdi
+mix_avx_write_wrapped:
+  cmp %rdi, %r9
+  jne mix_avx_write_count
+  dec %r8
+  jz mix_avx_end
+mix_avx_write_count:
+  dec %rsi
+  jnz mix_avx_write_loop
+  jmp mix_avx_group
+mix_avx_end:
+  vaddps %ymm1, %ymm0, %ymm0
+  vzeroupper
+  pop %r14
+  pop %r15
+  pop %rbx
+  pop %rdi
+  pop %rsi
+  ret
+
+/* same as mix_avx, with non-temporal stores */
+mix_avx_nt:
+  push %rsi
+  push %rdi
+  push %rbx
+  push %r15
+  push %r14
+  mov 8(%r9), %r14          /* r14 = lines to read per group */
+  mov 16(%r9), %r15         /* r15 = lines to write per group */
+  mov (%r9), %rbx
+  lea (%rcx,%rbx,4), %r9    /* r9 = start address, a pass is done when we get back here */
+  lea (%rcx,%rdx,4), %rdx   /* rdx = end of array */
+  mov %r9, %rdi
+  vmovaps (%rdi), %ymm0
+  vmovaps 32(%rdi), %ymm1
+  vmovaps %ymm0, %ymm2      /* ymm2 = value to write */
+mix_avx_nt_group:
+  mov %r14, %rsi
+  test %rsi, %rsi
+  jz mix_avx_nt_write
+mix_avx_nt_read_loop:
+  vaddps (%rdi), %ymm0, %ymm0
+  vaddps 32(%rdi), %ymm1, %ymm1
+  add $64, %rdi
+  cmp %rdi, %rdx
+  jne mix_avx_nt_read_wrapped
+  mov %rcx, %rdi            /* back to start of array */
+mix_avx_nt_read_wrapped:
+  cmp %rdi, %r9
+  jne mix_avx_nt_read_count     /* skip iteration decrement if we're not back to start */
+  dec %r8
+  jz mix_avx_nt_end
+mix_avx_nt_read_count:
+  dec %rsi
+  jnz mix_avx_nt_read_loop
+mix_avx_nt_write:
+  mov %r15, %rsi
+  test %rsi, %rsi
+  jz mix_avx_nt_group
+mix_avx_nt_write_loop:
+  vmovntps %ymm2, (%rdi)
+  vmovntps %ymm2, 32(%rdi)
+  add $64, %rdi
+  cmp %rdi, %rdx
+  jne mix_avx_nt_write_wrapped
+  mov %rcx, %rdi
+mix_avx_nt_write_wrapped:
+  cmp %rdi, %r9
+  jne mix_avx_nt_write_count
+  dec %r8
+  jz mix_avx_nt_end
+mix_avx_nt_write_count:
+  dec %rsi
+  jnz mix_avx_nt_write_loop
+  jmp mix_avx_nt_group
+mix_avx_nt_end:
+  sfence /* NT stores are weakly ordered */
+  vaddps %ymm1, %ymm0, %ymm0
+  vzeroupper
+  pop %r14
+  pop %r15
+  pop %rbx
+  pop %rdi
+  pop %rsi
+  ret
+
+/* zeroes the whole array a cache line at a time with clzero (AMD only)
+   rcx = ptr to arr, rdx = nr of fp32 elements in arr, r8 = iteration count */
+clzero_write:
+  mov %rcx, %r9
+  shl $2, %rdx     /* fp32 elements -> bytes */
+  add %rcx, %rdx   /* rdx = end of array */
+clzero_write_pass_loop:
+  mov %r9, %rax    /* clzero takes its address in rax */
+clzero_write_line_loop:
+  clzero
+  add $64, %rax
+  clzero
+  add $64, %rax
+  clzero
+  add $64, %rax
+  clzero
+  add $64, %rax
+  cmp %rdx, %rax
+  jb clzero_write_line_loop
+  dec %r8
+  jnz clzero_write_pass_loop
+  sfence
+  movss (%r9), %xmm0
+  ret
+
+/* memcpy/memset style routines for the copy suite
+   rcx = dst, rdx = src, r8 = length in bytes
+   the last 32 bytes are loaded up front and stored at the end, so the loops never
+   have to deal with a partial vector */
+avx_memcpy:
+  cmp $32, %r8
+  jb avx_memcpy_small
+  vmovups -32(%rdx,%r8), %ymm4
+  lea -32(%rcx,%r8), %r9
+  sub $32, %r8      /* r8 = bytes left before the tail */
+  cmp $128, %r8
+  jb avx_memcpy_vec
+avx_memcpy_loop:
+  vmovups (%rdx), %ymm0
+  vmovups 32(%rdx), %ymm1
+  vmovups 64(%rdx), %ymm2
+  vmovups 96(%rdx), %ymm3
+  vmovups %ymm0, (%rcx)
+  vmovups %ymm1, 32(%rcx)
+  vmovups %ymm2, 64(%rcx)
+  vmovups %ymm3, 96(%rcx)
+  add $128, %rdx
+  add $128, %rcx
+  sub $128, %r8
+  cmp $128, %r8
+  jae avx_memcpy_loop
+avx_memcpy_vec:
+  test %r8, %r8
+  jz avx_memcpy_tail
+avx_memcpy_vec_loop:
+  vmovups (%rdx), %ymm0
+  vmovups %ymm0, (%rcx)
+  add $32, %rdx
+  add $32, %rcx
+  sub $32, %r8
+  ja avx_memcpy_vec_loop
+avx_memcpy_tail:
+  vmovups %ymm4, (%r9)
+  vzeroupper
+  ret
+avx_memcpy_small:
+  cmp $16, %r8
+  jb avx_memcpy_bytes
+  vmovups (%rdx), %xmm0
+  vmovups -16(%rdx,%r8), %xmm1
+  vmovups %xmm0, (%rcx)
+  vmovups %xmm1, -16(%rcx,%r8)
+  ret
+avx_memcpy_bytes:
+  test %r8, %r8
+  jz avx_memcpy_done
+avx_memcpy_byte_loop:
+  movzbl (%rdx), %eax
+  mov %al, (%rcx)
+  inc %rdx
+  inc %rcx
+  dec %r8
+  jnz avx_memcpy_byte_loop
+avx_memcpy_done:
+  ret
+
+
+/* same as avx_memcpy but with NT stores to a 32B aligned destination. head and tail
+   are written with normal stores. short copies go to avx_memcpy */
+avx_ntmemcpy:
+  cmp $256, %r8
+  jb avx_memcpy
+  vmovups (%rdx), %ymm4
+  vmovups -32(%rdx,%r8), %ymm5
+  mov %rcx, %r10
+  lea -32(%rcx,%r8), %r9
+  mov %rcx, %rax
+  neg %rax
+  and $31, %rax     /* rax = bytes until dst is 32B aligned */
+  add %rax, %rcx
+  add %rax, %rdx
+  sub %rax, %r8
+  sub $32, %r8      /* r8 = bytes left before the tail */
+  cmp $128, %r8
+  jb avx_ntmemcpy_vec
+avx_ntmemcpy_loop:
+  vmovups (%rdx), %ymm0
+  vmovups 32(%rdx), %ymm1
+  vmovups 64(%rdx), %ymm2
+  vmovups 96(%rdx), %ymm3
+  vmovntps %ymm0, (%rcx)
+  vmovntps %ymm1, 32(%rcx)
+  vmovntps %ymm2, 64(%rcx)
+  vmovntps %ymm3, 96(%rcx)
+  add $128, %rdx
+  add $128, %rcx
+  sub $128, %r8
+  cmp $128, %r8
+  jae avx_ntmemcpy_loop
+avx_ntmemcpy_vec:
+  test %r8, %r8
+  jz avx_ntmemcpy_tail
+avx_ntmemcpy_vec_loop:
+  vmovups (%rdx), %ymm0
+  vmovntps %ymm0, (%rcx)
+  add $32, %rdx
+  add $32, %rcx
+  sub $32, %r8
+  ja avx_ntmemcpy_vec_loop
+avx_ntmemcpy_tail:
+  sfence
+  vmovups %ymm4, (%r10)
+  vmovups %ymm5, (%r9)
+  vzeroupper
+  ret
+
+
+/* fills with zero, since that's the common case (page zeroing, calloc) */
+avx_memset:
+  vxorps %ymm0, %ymm0, %ymm0
+  cmp $32, %r8
+  jb avx_memset_small
+  lea -32(%rcx,%r8), %r9
+  sub $32, %r8
+  cmp $128, %r8
+  jb avx_memset_vec
+avx_memset_loop:
+  vmovups %ymm0, (%rcx)
+  vmovups %ymm0, 32(%rcx)
+  vmovups %ymm0, 64(%rcx)
+  vmovups %ymm0, 96(%rcx)
+  add $128, %rcx
+  sub $128, %r8
+  cmp $128, %r8
+  jae avx_memset_loop
+avx_memset_vec:
+  test %r8, %r8
+  jz avx_memset_tail
+avx_memset_vec_loop:
+  vmovups %ymm0, (%rcx)
+  add $32, %rcx
+  sub $32, %r8
+  ja avx_memset_vec_loop
+avx_memset_tail:
+  vmovups %ymm0, (%r9)
+  vzeroupper
+  ret
+avx_memset_small:
+  cmp $16, %r8
+  jb avx_memset_bytes
+  vmovups %xmm0, (%rcx)
+  vmovups %xmm0, -16(%rcx,%r8)
+  vzeroupper
+  ret
+avx_memset_bytes:
+  xor %eax, %eax
+  test %r8, %r8
+  jz avx_memset_done
+avx_memset_byte_loop:
+  mov %al, (%rcx)
+  inc %rcx
+  dec %r8
+  jnz avx_memset_byte_loop
+avx_memset_done:
+  vzeroupper
+  ret
+
+
+/* avx_memset with NT stores, same head/tail handling as avx_ntmemcpy */
+avx_ntmemset:
+  cmp $256, %r8
+  jb avx_memset
+  vxorps %ymm0, %ymm0, %ymm0
+  vmovups %ymm0, (%rcx)
+  vmovups %ymm0, -32(%rcx,%r8)
+  mov %rcx, %rax
+  neg %rax
+  and $31, %rax     /* rax = bytes until dst is 32B aligned */
+  add %rax, %rcx
+  sub %rax, %r8
+  sub $32, %r8
+  cmp $128, %r8
+  jb avx_ntmemset_vec
+avx_ntmemset_loop:
+  vmovntps %ymm0, (%rcx)
+  vmovntps %ymm0, 32(%rcx)
+  vmovntps %ymm0, 64(%rcx)
+  vmovntps %ymm0, 96(%rcx)
+  add $128, %rcx
+  sub $128, %r8
+  cmp $128, %r8
+  jae avx_ntmemset_loop
+avx_ntmemset_vec:
+  test %r8, %r8
+  jz avx_ntmemset_tail
+avx_ntmemset_vec_loop:
+  vmovntps %ymm0, (%rcx)
+  add $32, %rcx
+  sub $32, %r8
+  ja avx_ntmemset_vec_loop
+avx_ntmemset_tail:
+  sfence
+  vzeroupper
+  ret
+
+
+repmovsb_memcpy:
+  push %rsi
+  push %rdi
+  mov %rcx, %rdi
+  mov %rdx, %rsi
+  mov %r8, %rcx
+  rep movsb
+  pop %rdi
+  pop %rsi
+  ret
+
+repstosb_memset:
+  push %rdi
+  mov %rcx, %rdi
+  mov %r8, %rcx
+  xor %eax, %eax
+  rep stosb
+  pop %rdi
+  ret
+
 /* Tests for cache bank conflicts by reading from two locations, spaced by some
    number of bytes
    rcx = ptr to array. first 32-bit int = increment step, because I'm too lazy to mess with the stack
@@ -10,6 +10,7 @@
 
 #ifndef __MINGW32__
 #include <sys/mman.h>
+#include "../Common/perfmon.h"
 #endif
 
 #ifdef NUMA
@@ -20,14 +21,25 @@
 
 #include <errno.h>
 #include <sched.h>
+#include <pthread.h>
+
+#include "../Common/timing.h"
+#include "../Common/sampling.h"
+#include "../Common/results.h"
+#include "../Common/chain.h"
+#include "../Common/pattern.h"
+#include "../Common/pages.h"
+#include "../Common/topology.h"
 
 // TODO: possibly get this programatically
 #define PAGE_SIZE 4096
 #define CACHELINE_SIZE 64
 
-int default_test_sizes[] = { 2, 4, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 600, 768, 1024, 1536, 2048, 2304, 2560,
+// sizes past 1 GB are only tested up to memFraction of physical memory, see -memfraction
+uint64_t default_test_sizes[] = { 2, 4, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 600, 768, 1024, 1536, 2048, 2304, 2560,
                                3072, 4096, 5120, 6144, 8192, 10240, 12288, 13312, 14336, 15360, 16384, 18432, 20480, 24567, 32768, 65536, 98304,
-                               131072, 262144, 393216, 524288, 1048576 }; //2097152 };
+                               131072, 262144, 393216, 524288, 1048576, 2097152, 4194304, 8388608, 16777216, 33554432, 67108864, 134217728,
+                               268435456, 536870912, 1073741824, 2147483648 };
 
 #ifdef __x86_64
 extern void preplatencyarr(uint64_t *arr, uint64_t len) __attribute__((ms_abi));
@@ -44,11 +56,25 @@ int posix_memalign(void **memptr, size_t alignment, size_t size)
 #define LONGPATTERN 1
 extern uint32_t longpatternlatencytest(uint64_t iterations, uint64_t *arr) __attribute((ms_abi));
 
+// mlptestfuncs[n - 1] chases n chains held in registers
+#define MLP_ASM_MAX_CHAINS 14
+typedef uint64_t (*mlpfunc)(uint64_t iterations, uint64_t **starts) __attribute((ms_abi));
+extern mlpfunc mlptestfuncs[];
+
 extern void stlftest(uint64_t iterations, char *arr) __attribute((ms_abi));
 extern void matchedstlftest(uint64_t iterations, char *arr) __attribute((ms_abi));
 extern void stlftest32(uint64_t iterations, char *arr) __attribute((ms_abi));
 extern void stlftest128(uint64_t iterations, char *arr) __attribute((ms_abi));
 void (*stlfFunc)(uint64_t, char *) __attribute__((ms_abi)) = stlftest;
+
+// stlfmatrixfuncs[store size index * 7 + load size index], sizes 1, 2, 4, 8, 16, 32, 64 bytes
+#define STLF_MATRIX 1
+typedef void (*stlfmatrixfunc)(uint64_t iterations, char *arr) __attribute((ms_abi));
+extern stlfmatrixfunc stlfmatrixfuncs[];
+extern uint64_t clktest(uint64_t iterations) __attribute((ms_abi));
+
+#define DISAMBIG_TEST 1
+extern void disambigtest(uint64_t iterations, uint32_t *offsets, char *arr, uint64_t offsetMask) __attribute((ms_abi));
 #elif __i686
 extern void preplatencyarr(uint32_t *arr, uint32_t len) __attribute__((fastcall));
 extern uint32_t latencytest(uint32_t iterations, uint32_t *arr) __attribute((fastcall));
@@ -63,14 +89,26 @@ extern uint32_t latencytest(uint64_t iterations, uint64_t *arr);
 #define LONGPATTERN 1
 extern uint32_t longpatternlatencytest(uint64_t iterations, uint64_t *arr);
 
+#define MLP_ASM_MAX_CHAINS 26
+typedef uint64_t (*mlpfunc)(uint64_t iterations, uint64_t **starts);
+extern mlpfunc mlptestfuncs[];
+
 extern void matchedstlftest(uint64_t iterations, char *arr);
 extern void stlftest(uint64_t iterations, char *arr);
 extern void stlftest32(uint64_t iterations, char *arr);
 extern void stlftest128(uint64_t iterations, char *arr);
 void (*stlfFunc)(uint64_t, char *) = stlftest;
+
+#define DISAMBIG_TEST 1
+extern void disambigtest(uint64_t iterations, uint32_t *offsets, char *arr, uint64_t offsetMask);
 #elif __riscv
 extern void preplatencyarr(uint64_t *arr, uint64_t len);
 extern uint32_t latencytest(uint64_t iterations, uint64_t *arr);
+
+#define MLP_ASM_MAX_CHAINS 25
+typedef uint64_t (*mlpfunc)(uint64_t iterations, uint64_t **starts);
+extern mlpfunc mlptestfuncs[];
+
 extern void matchedstlftest(uint64_t iterations, char *arr);
 extern void stlftest(uint64_t iterations, char *arr);
 extern void stlftest32(uint64_t iterations, char *arr);
@@ -82,46 +120,110 @@ extern uint32_t latencytest(uint64_t iterations, uint64_t *arr);
 void (*stlfFunc)(uint64_t, char *) = NULL;
 #endif
 
-float RunTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedArr);
-float RunAsmTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedArr);
-float RunTlbTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedArr);
-float RunMlpTest(uint32_t size_kb, uint32_t iterations, uint32_t parallelism);
-float RunAopTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedArr);
+float RunTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr);
+float RunTest64(uint64_t size_kb, uint32_t iterations, uint64_t *preallocatedArr);
+float RunAsmTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr);
+float RunTlbTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr);
+float RunMlpTest(uint64_t size_kb, uint32_t iterations, uint32_t parallelism, uint32_t *preallocatedArr);
+float RunAopTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr);
+float RunSequenceTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr);
 void RunStlfTest(uint32_t iterations, int mode, int pageEnd, int loadDistance);
 void FillPatternArr64(uint64_t *pattern_arr, uint64_t list_size, uint64_t byte_increment);
 void FillPatternArr(uint32_t *pattern_arr, uint32_t list_size, uint32_t byte_increment);
 
-float (*testFunc)(uint32_t, uint32_t, uint32_t *) = RunTest;
+float (*testFunc)(uint64_t, uint32_t, uint32_t *) = RunTest;
+
+#define MLP_MAX_CHAINS 64
 
-uint32_t ITERATIONS = 100000000;
+// with ns timing, this is plenty even for L1-sized tests
+uint32_t ITERATIONS = 10000000;
 uint32_t pageByPage = 0;
 uint32_t longpattern = 0;
+int pmon = 0;
+char *testName = "c";
+struct access_pattern accessPattern;
+int pagePolicy = PAGES_DEFAULT;
+struct sampling_config samplingConfig;
+
+// one latency data point, for the sampling engine to run repeatedly
+struct LatencyTestPoint {
+    uint64_t size_kb;
+    uint32_t iterations;
+    uint32_t *arr;
+};
+
+float MeasureLatencyPoint(void *param);
+void RunPrefetchSuite(uint64_t *sizes, uint32_t sizeCount, uint32_t *arr);
+void RunSwPrefetchSweep(uint64_t *sizes, uint32_t sizeCount, uint32_t *arr);
+void PrintLatencyPoint(uint64_t size_kb, float latency, struct sample_stats *stats);
+uint64_t physical_memory_kb();
+void *AllocTestArr(uint64_t bytes);
+void FreeTestArr(void *arr, uint64_t bytes);
+void ReportTestArr(void *arr, uint64_t bytes, int policy);
+void RunPageSizeSweep(uint64_t *sizes, uint32_t sizeCount);
+void RunTlbSuite();
+void RunStlfMatrix(uint32_t iterations);
+void RunDisambigTest(uint32_t iterations);
+void RunThreadedLatency(uint64_t *sizes, uint32_t sizeCount, int threadCount, int threadMode, int shared);
+#ifdef NUMA
+void RunNumaMatrix(uint64_t size_kb, int everyCore, int hugePages);
+#endif
+float EstimateClockGhz();
+uint64_t scale_iterations(uint64_t size_kb, uint32_t iterations);
+void start_test_timing(uint64_t *startTicks);
+uint64_t end_test_timing(uint64_t *startTicks);
 
 int main(int argc, char* argv[]) {
-    uint32_t maxTestSizeMb = 0;
-    uint32_t singleSize = 0;
-    uint32_t testSizeCount = sizeof(default_test_sizes) / sizeof(int);
+    uint64_t maxTestSizeMb = 0;
+    uint64_t singleSize = 0;
+    uint32_t testSizeCount = sizeof(default_test_sizes) / sizeof(uint64_t);
+    float memFraction = 0.25f;
     int mlpTest = 0;  // if > 0, run MLP test with (value) levels of parallelism max
-    int stlf = 0, hugePages = 0;
+    int mlpChains = 32;
+    int prefetchTest = 0, swPrefetchTest = 0, pageSweep = 0, tlbSuite = 0;
+    int stlf = 0, stlfMatrix = 0, disambig = 0, hugePages = 0;
+    int threadCount = 0, threadMode = TOPOLOGY_L3FILL, sharedArr = 0;
     int stlfPageEnd = 0, numa = 0, stlfLoadDistance = 0;
+#ifdef NUMA
+    int numaCores = 0;
+#endif
+    int timingBackend = TIMING_AUTO;
+    int outputFormat = RESULTS_FORMAT_DEFAULT;
+    struct LatencyTestPoint testPoint;
+    struct sample_stats pointStats;
     uint32_t *hugePagesArr = NULL;
     size_t hugePagesAllocatedBytes = 0;
+    sampling_default_config(&samplingConfig);
+    pattern_default(&accessPattern);
     for (int argIdx = 1; argIdx < argc; argIdx++) {
         if (*(argv[argIdx]) == '-') {
             char *arg = argv[argIdx] + 1;
             if (strncmp(arg, "test", 4) == 0) {
                 argIdx++;
                 char *testType = argv[argIdx];
+                testName = testType;
 
         if (strncmp(testType, "c", 1) == 0) {
                     testFunc = RunTest;
                     fprintf(stderr, "Using simple C test\n");
+                } else if (strncmp(testType, "tlbsuite", 8) == 0) {
+                    tlbSuite = 1;
+                    fprintf(stderr, "Running TLB and page walk suite\n");
                 } else if (strncmp(testType, "tlb", 3) == 0) {
                     testFunc = RunTlbTest;
                     fprintf(stderr, "Testing TLB with one element accessed per 4K page\n");
                 } else if (strncmp(testType, "mlp", 3) == 0) {
-                    mlpTest = 32;
+                    mlpTest = 1;
                     fprintf(stderr, "Running memory parallelism test\n");
+                } else if (strncmp(testType, "swprefetch", 10) == 0) {
+                    swPrefetchTest = 1;
+                    fprintf(stderr, "Running software prefetch distance sweep\n");
+                } else if (strncmp(testType, "prefetch", 8) == 0) {
+                    prefetchTest = 1;
+#ifndef UNKNOWN_ARCH
+                    testFunc = RunAsmTest;
+#endif
+                    fprintf(stderr, "Running prefetcher characterization suite\n");
                 } else if (strncmp(testType, "aop", 3) == 0) {
                     testFunc = RunAopTest;
                     fprintf(stderr, "Running array-of-pointers test\n");
@@ -130,7 +232,20 @@ int main(int argc, char* argv[]) {
                 else if (strncmp(testType, "asm", 3) == 0) {
                     testFunc = RunAsmTest;
                     fprintf(stderr, "Using ASM (simple address) test\n");
-                } else if (strncmp(testType, "stlf", 4) == 0) {
+                }
+                #ifdef DISAMBIG_TEST
+                else if (strncmp(testType, "disambig", 8) == 0) {
+                    disambig = 1;
+                    fprintf(stderr, "Running memory disambiguation test\n");
+                }
+                #endif
+                #ifdef STLF_MATRIX
+                else if (strncmp(testType, "stlfmatrix", 10) == 0) {
+                    stlfMatrix = 1;
+                    fprintf(stderr, "Running store to load forwarding matrix across store and load sizes\n");
+                }
+                #endif
+                else if (strncmp(testType, "stlf", 4) == 0) {
                     stlf = 1;
                     fprintf(stderr, "Running store to load forwarding test\n");
                 } else if (strncmp(testType, "matched_stlf", 4) == 0) {
@@ -159,21 +274,67 @@ int main(int argc, char* argv[]) {
                 #endif  // end UNKNOWN_ARCH
                 else {
                     fprintf(stderr, "Unrecognized test type: %s\n", testType);
-                    fprintf(stderr, "Valid test types: c, tlb, mlp");
+                    fprintf(stderr, "Valid test types: c, tlb, tlbsuite, mlp, prefetch, swprefetch, aop");
             #ifndef UNKNOWN_ARCH
             fprintf(stderr, ", asm, stlf, matched_stlf, dword_stlf");
+            #ifdef STLF_MATRIX
+            fprintf(stderr, ", stlfmatrix");
+            #endif
+            #ifdef DISAMBIG_TEST
+            fprintf(stderr, ", disambig");
+            #endif
             #endif
             fprintf(stderr, "\n");
                 }
             } else if (strncmp(arg, "maxsizemb", 9) == 0) {
                 argIdx++;
-                maxTestSizeMb = atoi(argv[argIdx]);
-                fprintf(stderr, "Will not exceed %u MB\n", maxTestSizeMb);
+                maxTestSizeMb = strtoull(argv[argIdx], NULL, 0);
+                fprintf(stderr, "Will not exceed %lu MB\n", maxTestSizeMb);
+            } else if (strncmp(arg, "mlpchains", 9) == 0) {
+                argIdx++;
+                mlpChains = atoi(argv[argIdx]);
+                if (mlpChains < 1) mlpChains = 1;
+                if (mlpChains > MLP_MAX_CHAINS) mlpChains = MLP_MAX_CHAINS;
+                fprintf(stderr, "MLP test will go up to %d chains\n", mlpChains);
+            } else if (strncmp(arg, "memfraction", 11) == 0) {
+                argIdx++;
+                memFraction = atof(argv[argIdx]);
+                fprintf(stderr, "Sizes past 1 GB will go up to %f of physical memory\n", memFraction);
             } else if (strncmp(arg, "iter", 4) == 0) {
                 argIdx++;
                 ITERATIONS = atoi(argv[argIdx]);
                 fprintf(stderr, "Base iterations: %u\n", ITERATIONS);
-            } 
+            }
+            #ifndef __MINGW32__
+            else if (strncmp(arg, "pmonevents", 10) == 0) {
+                argIdx++;
+                pmon = 1;
+                perf_event_list = argv[argIdx];
+                fprintf(stderr, "Using hardware performance monitoring with events %s\n", perf_event_list);
+            } else if (strncmp(arg, "pmon", 4) == 0) {
+                pmon = 1;
+                fprintf(stderr, "Using hardware performance monitoring\n");
+            }
+            #endif
+            else if (strncmp(arg, "format", 6) == 0) {
+                argIdx++;
+                outputFormat = results_parse_format(argv[argIdx]);
+            } else if (strncmp(arg, "timer", 5) == 0) {
+                argIdx++;
+                timingBackend = timing_parse_backend(argv[argIdx]);
+            } else if (strncmp(arg, "trials", 6) == 0) {
+                argIdx++;
+                samplingConfig.maxTrials = atoi(argv[argIdx]);
+                fprintf(stderr, "Up to %d trials per test size\n", samplingConfig.maxTrials);
+            } else if (strncmp(arg, "mintrials", 9) == 0) {
+                argIdx++;
+                samplingConfig.minTrials = atoi(argv[argIdx]);
+                fprintf(stderr, "At least %d trials per test size\n", samplingConfig.minTrials);
+            } else if (strncmp(arg, "ci", 2) == 0) {
+                argIdx++;
+                samplingConfig.targetCi = atof(argv[argIdx]) / 100.0f;
+                fprintf(stderr, "Will stop when 95%% confidence interval is within %f%% of mean\n", samplingConfig.targetCi * 100);
+            }
             else if (strncmp(arg, "stlf_page_end", 13) == 0) {
                     argIdx++;
                     stlfPageEnd = atoi(argv[argIdx]);
@@ -199,17 +360,58 @@ int main(int argc, char* argv[]) {
                 sched_setaffinity(gettid(), sizeof(cpu_set_t), &cpuset);
 	    }
             #endif
+            else if (strncmp(arg, "threadmode", 10) == 0) {
+                argIdx++;
+                threadMode = topology_parse_mode(argv[argIdx]);
+                if (threadMode == TOPOLOGY_INVALID) return 0;
+                fprintf(stderr, "Picking cores for latency threads with %s order\n", argv[argIdx]);
+            }
+            else if (strncmp(arg, "threads", 7) == 0) {
+                argIdx++;
+                threadCount = atoi(argv[argIdx]);
+                fprintf(stderr, "Running latency test on %d threads at once\n", threadCount);
+            }
+            else if (strncmp(arg, "shared", 6) == 0) {
+                sharedArr = 1;
+                fprintf(stderr, "Latency threads will chase the same array\n");
+            }
+            else if (strncmp(arg, "pagesweep", 9) == 0) {
+                pageSweep = 1;
+                fprintf(stderr, "Will run each size with 4K, transparent huge, 2M hugetlb, and 1G hugetlb pages\n");
+            }
+            else if (strncmp(arg, "pages", 5) == 0) {
+                argIdx++;
+                pagePolicy = pages_parse_policy(argv[argIdx]);
+                if (pagePolicy == PAGES_INVALID) return 0;
+                fprintf(stderr, "Test arrays will use %s pages\n", pages_policy_name(pagePolicy));
+            }
             else if (strncmp(arg, "pagebypage", 10) == 0) {
                 pageByPage = 1;
                 fprintf(stderr, "If applicable, will hit all elements in a page before moving to another page to reduce TLB penalties\n");
             }
+            else if (strncmp(arg, "seed", 4) == 0) {
+                argIdx++;
+                chain_set_seed(strtoull(argv[argIdx], NULL, 0));
+                fprintf(stderr, "Pointer chasing pattern seed: %s\n", argv[argIdx]);
+            }
+            else if (strncmp(arg, "pattern", 7) == 0) {
+                argIdx++;
+                if (pattern_parse(argv[argIdx], &accessPattern) == PATTERN_INVALID) return 0;
+                fprintf(stderr, "Access pattern: %s\n", argv[argIdx]);
+            }
             else if (strncmp(arg, "sizekb", 6) == 0) {
                 argIdx++;
-                singleSize = atoi(argv[argIdx]);
-                fprintf(stderr, "Testing %u KB only\n", singleSize);
+                singleSize = strtoull(argv[argIdx], NULL, 0);
+                fprintf(stderr, "Testing %lu KB only\n", singleSize);
             }
 
 #ifdef NUMA
+            else if (strncmp(arg, "numacores", 9) == 0) {
+                numa = 1;
+                numaCores = 1;
+                singleSize = singleSize ? singleSize : 1048576;
+                fprintf(stderr, "Testing every core to every node latency. If test size is not set, it will be 1 GB\n");
+            }
             else if (strncmp(arg, "numa", 4) == 0) {
                 numa = 1;
                 singleSize = 1048576;
@@ -223,11 +425,50 @@ int main(int argc, char* argv[]) {
     }
 
     if (argc == 1) {
-        fprintf(stderr, "Usage: [-test <c/asm/tlb/mlp>] [-maxsizemb <max test size in MB>] [-iter <base iterations, default 100000000]\n");
+        fprintf(stderr, "Usage: [-test <c/asm/tlb/mlp");
+#ifdef STLF_MATRIX
+        fprintf(stderr, "/stlfmatrix");
+#endif
+#ifdef DISAMBIG_TEST
+        fprintf(stderr, "/disambig");
+#endif
+        fprintf(stderr, ">] [-maxsizemb <max test size in MB>] [-memfraction <max share of RAM past 1 GB, default 0.25>] [-mlpchains <max chains for mlp, default 32>] [-iter <base iterations, default 10000000] [-timer <tsc/clock>]\n");
+        fprintf(stderr, "       [-trials <max trials per size>] [-mintrials <min trials per size>] [-ci <target confidence interval, percent of mean>]\n");
+        fprintf(stderr, "       [-pmon] [-pmonevents <comma separated perf events>] [-format <json/csv>] [-seed <pattern seed>]\n");
+        fprintf(stderr, "       [-pages <default/4k/thp/2m/1g>] [-pagesweep] [-threads <count>] [-threadmode <linear/physical/l3fill/l3spread/bigfirst>] [-shared]\n");
+        fprintf(stderr, "       [-pattern <random/stride:N/reverse:N/pages:N/streams:N/zipf:s/hotcold:hot fraction:hot access fraction>]\n");
+    }
+
+    // tag results with the pattern and page size, so runs with different patterns can be told apart
+    char patternTestName[64];
+    if (accessPattern.type != PATTERN_RANDOM && !prefetchTest) {
+        char patternName[48];
+        pattern_describe(&accessPattern, patternName, sizeof(patternName));
+        snprintf(patternTestName, sizeof(patternTestName), "%s:%s", testName, patternName);
+        testName = patternTestName;
+    }
+
+    char pagesTestName[80];
+    if (pagePolicy != PAGES_DEFAULT && !pageSweep) {
+        snprintf(pagesTestName, sizeof(pagesTestName), "%s:%s", testName, pages_policy_name(pagePolicy));
+        testName = pagesTestName;
     }
 
+    timing_init(timingBackend);
+    results_init("MemoryLatency", outputFormat, timing_backend_name());
+
+    // trim the default sweep. sizes up to 1 GB always run like before, larger ones have to fit in memFraction of RAM
+    uint64_t memLimitKb = physical_memory_kb() * memFraction;
+    if (memLimitKb < 1048576) memLimitKb = 1048576;
+    while (testSizeCount > 1 && (default_test_sizes[testSizeCount - 1] > memLimitKb ||
+        (maxTestSizeMb > 0 && default_test_sizes[testSizeCount - 1] > maxTestSizeMb * 1024))) testSizeCount--;
+#ifndef __MINGW32__
+    if (pmon) open_perf_monitoring();
+#endif
+
 #ifdef __linux__
-    if (hugePages) {
+    // the NUMA matrix allocates per node instead, see RunNumaMatrix
+    if (hugePages && !numa) {
        size_t hugePageSize = 1 << 21;
        size_t testSizeKb = singleSize ? singleSize : default_test_sizes[testSizeCount - 1];
        size_t maxMemRequired = testSizeKb * (size_t)1024;
@@ -235,146 +476,444 @@ int main(int argc, char* argv[]) {
        if (maxTestSizeMb > 0 && maxMemRequired > maxTestSizeMb * 1024 * 1024) maxMemRequired = maxTestSizeMb * 1024 * 1024;
        maxMemRequired = (((maxMemRequired - 1) / hugePageSize) + 1) * hugePageSize;
        fprintf(stderr, "mmap-ing %lu bytes\n", maxMemRequired);
-       hugePagesArr = mmap(NULL, maxMemRequired, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
-       if (hugePagesArr == (void *)-1) { // on failure, mmap will return MAP_FAILED, or (void *)-1
+       int hugePagePolicy = PAGES_HUGETLB_2M;
+       hugePagesArr = pages_alloc(maxMemRequired, hugePagePolicy);
+       if (hugePagesArr == NULL) {
            fprintf(stderr, "Failed to mmap huge pages, errno %d = %s\nWill try to use madvise\n", errno, strerror(errno));
-           if (0 != posix_memalign((void **)(&hugePagesArr), 2 * 1024 * 1024, maxMemRequired)) {
+           hugePagePolicy = PAGES_THP;
+           hugePagesArr = pages_alloc(maxMemRequired, hugePagePolicy);
+           if (hugePagesArr == NULL) {
                fprintf(stderr, "Failed to allocate 2 MB aligned memory, will not use hugepages\n");
-           hugePagesArr = NULL;
                return 0;
            }
-
-           madvise(hugePagesArr, maxMemRequired, MADV_HUGEPAGE);
        }
+
+       ReportTestArr(hugePagesArr, maxMemRequired, hugePagePolicy);
     }
 #endif
 
     if (mlpTest) {
-        // allocate arr to hold results
-        float *results = (float *)malloc(testSizeCount * mlpTest * sizeof(float));
-        for (int size_idx = 0; size_idx < testSizeCount; size_idx++) {
+        // results are per-chain latency, ns per hop on each chain with all chains running
+        mlpTest = mlpChains;
+        uint64_t *mlpSizes = singleSize ? &singleSize : default_test_sizes;
+        int mlpSizeCount = singleSize ? 1 : testSizeCount;
+        float *results = (float *)malloc(mlpSizeCount * mlpTest * sizeof(float));
+        for (int size_idx = 0; size_idx < mlpSizeCount; size_idx++) {
             for (int parallelism = 0; parallelism < mlpTest; parallelism++) {
-                results[size_idx * mlpTest + parallelism] = RunMlpTest(default_test_sizes[size_idx], ITERATIONS, parallelism + 1);
-                printf("%d KB, %dx parallelism, %f MB/s\n", default_test_sizes[size_idx], parallelism + 1, results[size_idx * mlpTest + parallelism]);
+                float chainLatency = RunMlpTest(mlpSizes[size_idx], ITERATIONS, parallelism + 1, hugePagesArr);
+                float accessLatency = chainLatency / (parallelism + 1);
+                float bw = chainLatency > 0 ? 1e3 * CACHELINE_SIZE / accessLatency : 0;
+                results[size_idx * mlpTest + parallelism] = bw;
+                if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+                    struct result_record record;
+                    results_new_record(&record, testName, "bandwidth_mbps", bw);
+                    record.sizeKb = mlpSizes[size_idx];
+                    results_add_param(&record, "parallelism", parallelism + 1);
+                    results_add_param(&record, "chain_latency_ns", chainLatency);
+                    results_add_param(&record, "access_latency_ns", accessLatency);
+                    results_emit(&record);
+                } else printf("%lu KB, %dx parallelism, %f ns per chain, %f ns per access, %f MB/s\n",
+                    mlpSizes[size_idx], parallelism + 1, chainLatency, accessLatency, bw);
             }
         }
 
-        for (int size_idx = 0; size_idx < testSizeCount; size_idx++) {
-            printf(",%d", default_test_sizes[size_idx]);
+        if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+            free(results);
+            return 0;
+        }
+
+        // MB/s of 64B cachelines
+        for (int size_idx = 0; size_idx < mlpSizeCount; size_idx++) {
+            printf(",%lu", mlpSizes[size_idx]);
         }
 
         printf("\n");
 
         for (int parallelism = 0; parallelism < mlpTest; parallelism++) {
             printf("%d", parallelism + 1);
-            for (int size_idx = 0; size_idx < default_test_sizes[size_idx]; size_idx++) {
+            for (int size_idx = 0; size_idx < mlpSizeCount; size_idx++) {
                 printf(",%f", results[size_idx * mlpTest + parallelism]);
             }
             printf("\n");
         }
 
         free(results);
+    } else if (tlbSuite) {
+        RunTlbSuite();
+    } else if (pageSweep) {
+        if (singleSize) RunPageSizeSweep(&singleSize, 1);
+        else RunPageSizeSweep(default_test_sizes, testSizeCount);
+    } else if (swPrefetchTest) {
+        if (singleSize) RunSwPrefetchSweep(&singleSize, 1, hugePagesArr);
+        else RunSwPrefetchSweep(default_test_sizes, testSizeCount, hugePagesArr);
+    } else if (prefetchTest) {
+        if (singleSize) RunPrefetchSuite(&singleSize, 1, hugePagesArr);
+        else RunPrefetchSuite(default_test_sizes, testSizeCount, hugePagesArr);
+    } else if (threadCount > 0) {
+        if (singleSize) RunThreadedLatency(&singleSize, 1, threadCount, threadMode, sharedArr);
+        else RunThreadedLatency(default_test_sizes, testSizeCount, threadCount, threadMode, sharedArr);
+    } else if (disambig) {
+        RunDisambigTest(ITERATIONS);
+    } else if (stlfMatrix) {
+        RunStlfMatrix(ITERATIONS);
     } else if (stlf) {
         RunStlfTest(ITERATIONS, stlf, stlfPageEnd, stlfLoadDistance);
     } 
 #ifdef NUMA
     else if (numa) {
-        if (numa_available() == -1) {
-        fprintf(stderr, "NUMA is not available\n");
-        return 0;
-    }
-
-    int numaNodeCount = numa_max_node() + 1;
-    if (numaNodeCount > 64) {
-        fprintf(stderr, "Too many NUMA nodes. Go home.\n");
-        return 0;
+        RunNumaMatrix(singleSize, numaCores, hugePages);
     }
-
-    struct bitmask *nodeBitmask = numa_allocate_cpumask();
-    float *crossnodeLatencies = (float *)malloc(sizeof(float) * numaNodeCount * numaNodeCount);
-    memset(crossnodeLatencies, 0, sizeof(float) * numaNodeCount * numaNodeCount);
-        for (int cpuNode = 0; cpuNode < numaNodeCount; cpuNode++) {
-        numa_node_to_cpus(cpuNode, nodeBitmask);
-        int nodeCpuCount = numa_bitmask_weight(nodeBitmask);
-        if (nodeCpuCount == 0) {
-            fprintf(stderr, "Node %d has no cores\n", cpuNode);
-        continue;
+#endif
+    else {
+        testPoint.iterations = ITERATIONS;
+        testPoint.arr = hugePagesArr;
+        if (singleSize == 0) {
+        if (resultsFormat == RESULTS_FORMAT_DEFAULT) {
+            printf("Region,Latency (ns)");
+            if (samplingConfig.maxTrials > 1) printf(",Min,P99,Stddev,Trials");
+#ifndef __MINGW32__
+            if (pmon) append_perf_header();
+#endif
+            printf("\n");
         }
 
-            fprintf(stderr, "Node %d has %d cores\n", cpuNode, nodeCpuCount);
-        cpu_set_t cpuset;
-        memcpy(cpuset.__bits, nodeBitmask->maskp, nodeBitmask->size / 8);
-            // for (int i = 0; i < get_nprocs(); i++) 
-            //  if (numa_bitmask_isbitset(nodeBitmask, i)) CPU_SET(i, &cpuset); 
-
-        sched_setaffinity(gettid(), sizeof(cpu_set_t), &cpuset);
-
-        for (int memNode = 0; memNode < numaNodeCount; memNode++) {
-            uint64_t nodeMask = 1UL << memNode;
-        uint32_t *arr;
-            if (hugePagesArr) {
-            fprintf(stderr, "mbind-ing pre-allocated arr, size %lu bytes\n", hugePagesAllocatedBytes);
-            long mbind_rc = mbind(hugePagesArr, hugePagesAllocatedBytes, MPOL_BIND, &nodeMask, 64, MPOL_MF_STRICT | MPOL_MF_MOVE);
-            fprintf(stderr, "mbind returned %ld\n", mbind_rc);
-            if (mbind_rc != 0) {
-                fprintf(stderr, "errno: %d\n", errno);
+            for (int i = 0; i < testSizeCount; i++) {
+                testPoint.size_kb = default_test_sizes[i];
+                float latency = run_sampled(&samplingConfig, MeasureLatencyPoint, &testPoint, &pointStats);
+                PrintLatencyPoint(default_test_sizes[i], latency, &pointStats);
             }
-            arr = hugePagesArr;
         } else {
-                    arr = numa_alloc_onnode(singleSize * 1024, memNode);
-                    madvise(arr, singleSize * 1024, MADV_HUGEPAGE);
+            testPoint.size_kb = singleSize;
+            float latency = run_sampled(&samplingConfig, MeasureLatencyPoint, &testPoint, &pointStats);
+            PrintLatencyPoint(singleSize, latency, &pointStats);
         }
-            
-        float latency = testFunc(singleSize, ITERATIONS, arr);
-        crossnodeLatencies[cpuNode * numaNodeCount + memNode] = latency;
-        fprintf(stderr, "CPU node %d -> mem node %d: %f ns\n", cpuNode, memNode, latency);
-        if (!hugePages) numa_free(arr, singleSize * 1024);
+    }
+
+#ifndef __MINGW32__
+    if (pmon) close_perf_monitoring();
+#endif
+    return 0;
+}
+
+float MeasureLatencyPoint(void *param) {
+    struct LatencyTestPoint *point = (struct LatencyTestPoint *)param;
+    return testFunc(point->size_kb, point->iterations, point->arr);
+}
+
+// Patterns for the prefetcher suite. Strides are in 64B lines, so 64 and up cross a 4K page on every access.
+// streams:N interleaves N sequential streams through separate parts of the array
+const char *prefetch_patterns[] = { "random", "stride:1", "reverse:1", "stride:2", "stride:4", "stride:8", "stride:16", "stride:32",
+    "stride:64", "stride:65", "stride:128", "streams:2", "streams:4", "streams:8", "streams:16" };
+
+// Runs each prefetch pattern at every size, and compares latency against the random pattern
+// at the same size. Random is built to defeat prefetchers, so a ratio well under 1 means prefetchers are covering the pattern
+void RunPrefetchSuite(uint64_t *sizes, uint32_t sizeCount, uint32_t *arr) {
+    uint32_t patternCount = sizeof(prefetch_patterns) / sizeof(char *);
+    float *results = (float *)malloc(sizeof(float) * sizeCount * patternCount);
+    struct LatencyTestPoint point;
+    struct sample_stats stats;
+    char recordName[64];
+    point.iterations = ITERATIONS;
+    point.arr = arr;
+    for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++) {
+        point.size_kb = sizes[size_idx];
+        for (uint32_t patternIdx = 0; patternIdx < patternCount; patternIdx++) {
+            pattern_parse(prefetch_patterns[patternIdx], &accessPattern);
+            float latency = run_sampled(&samplingConfig, MeasureLatencyPoint, &point, &stats);
+            float baseline = results[size_idx * patternCount];
+            float ratio = patternIdx > 0 && baseline > 0 ? latency / baseline : 1.0f;
+            results[size_idx * patternCount + patternIdx] = latency;
+            if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+                struct result_record record;
+                snprintf(recordName, sizeof(recordName), "%s:%s", testName, prefetch_patterns[patternIdx]);
+                results_new_record(&record, recordName, "latency_ns", latency);
+                record.sizeKb = sizes[size_idx];
+                if (samplingConfig.maxTrials > 1) record.stats = &stats;
+                results_add_param(&record, "random_ratio", ratio);
+                results_emit(&record);
+            } else printf("%lu KB, %s, %f ns, %f of random\n", sizes[size_idx], prefetch_patterns[patternIdx], latency, ratio);
         }
     }
 
-    for (int memNode = 0; memNode < numaNodeCount; memNode++) {
-        printf(",%d", memNode);
+    pattern_default(&accessPattern);
+    if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+        free(results);
+        return;
     }
 
+    // latency in ns, one row per pattern
+    printf("Pattern");
+    for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++) printf(",%lu", sizes[size_idx]);
     printf("\n");
-    for (int cpuNode = 0; cpuNode < numaNodeCount; cpuNode++) {
-        printf("%d", cpuNode);
-        for (int memNode = 0; memNode < numaNodeCount; memNode++) {
-            printf(",%f", crossnodeLatencies[cpuNode * numaNodeCount + memNode]);
-        }
-
+    for (uint32_t patternIdx = 0; patternIdx < patternCount; patternIdx++) {
+        printf("%s", prefetch_patterns[patternIdx]);
+        for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++) printf(",%f", results[size_idx * patternCount + patternIdx]);
         printf("\n");
     }
 
-    free(crossnodeLatencies);
+    free(results);
+}
+
+// Prefetch distances in chain links for the software prefetch sweep. 0 = no prefetch
+const uint32_t swprefetch_distances[] = { 0, 1, 2, 3, 4, 6, 8, 12, 16, 20, 24, 32, 40, 48, 56, 64 };
+const char *swprefetch_hints[] = { "t0", "nta" };
+
+// Chases the chain in slot 0 of each cacheline, prefetching the node in slot 1 (distance links ahead) on every hop.
+// hint 0 = prefetch to all cache levels (prefetcht0, prfm pldl1keep), 1 = non-temporal (prefetchnta, prfm pldl1strm)
+float RunSwPrefetchTest(uint64_t *A, uint64_t scaled_iterations, uint32_t distance, int hint) {
+    uint64_t startTicks, sum = 0;
+    uint64_t *current = A;
+    start_test_timing(&startTicks);
+    if (distance == 0) {
+        for (uint64_t i = 0; i < scaled_iterations; i++) {
+            current = (uint64_t *)(uintptr_t)current[0];
+            sum += (uintptr_t)current;
+        }
+    } else if (hint == 0) {
+        for (uint64_t i = 0; i < scaled_iterations; i++) {
+            __builtin_prefetch((void *)(uintptr_t)current[1], 0, 3);
+            current = (uint64_t *)(uintptr_t)current[0];
+            sum += (uintptr_t)current;
+        }
+    } else {
+        for (uint64_t i = 0; i < scaled_iterations; i++) {
+            __builtin_prefetch((void *)(uintptr_t)current[1], 0, 0);
+            current = (uint64_t *)(uintptr_t)current[0];
+            sum += (uintptr_t)current;
+        }
     }
+    uint64_t time_diff_ns = end_test_timing(&startTicks);
+    if (sum == 0) printf("sum == 0 (?)\n");
+    return (float)time_diff_ns / (float)scaled_iterations;
+}
+
+// Software prefetch distance sweep. A pointer chase can't compute an address more than one link ahead,
+// so each 64B node carries a jump pointer to the node (distance) links further down the chain, like a
+// linked list scan loop would keep for prefetching. Reports ns per element for each distance and hint
+void RunSwPrefetchSweep(uint64_t *sizes, uint32_t sizeCount, uint32_t *arr) {
+    uint32_t distanceCount = sizeof(swprefetch_distances) / sizeof(uint32_t);
+    uint32_t hintCount = sizeof(swprefetch_hints) / sizeof(char *);
+    uint64_t node_elements = CACHELINE_SIZE / sizeof(uint64_t);
+    float *results = (float *)malloc(sizeof(float) * sizeCount * distanceCount * hintCount);
+    char recordName[64];
+    for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++) {
+        uint64_t size_kb = sizes[size_idx];
+        uint64_t list_size = size_kb * 1024 / sizeof(uint64_t);
+        uint64_t node_count = list_size / node_elements;
+        uint64_t *A, *order = (uint64_t *)malloc(sizeof(uint64_t) * node_count);
+        if (arr == NULL) {
+            if (NULL == (A = AllocTestArr(sizeof(uint64_t) * list_size))) {
+                fprintf(stderr, "Failed to allocate memory for %lu KB test\n", size_kb);
+                free(order);
+                continue;
+            }
+        } else A = (uint64_t *)arr;
+
+        // chain in slot 0, same as the asm latency test
+        memset(A, 0, sizeof(uint64_t) * list_size);
+        chain_random_order(order, node_count, chain_next_seed());
+        chain_link64(A, order, node_count, node_elements, 0);
+#if !defined(UNKNOWN_ARCH) && !defined(BITS_32)
+        preplatencyarr(A, list_size);
+#else
+        for (uint64_t i = 0; i < list_size; i++) A[i] = (uint64_t)(uintptr_t)(A + A[i]);
 #endif
-    else {
-        if (singleSize == 0) {
-        printf("Region,Latency (ns)\n");
-            for (int i = 0; i < testSizeCount; i++) {
-                if ((maxTestSizeMb == 0) || (default_test_sizes[i] <= maxTestSizeMb * 1024))
-                    printf("%d,%f\n", default_test_sizes[i], testFunc(default_test_sizes[i], ITERATIONS, hugePagesArr));
-                else {
-                    fprintf(stderr, "Test size %u KB exceeds max test size of %u KB\n", default_test_sizes[i], maxTestSizeMb * 1024);
-                    break;
-                }
+
+        uint64_t scaled_iterations = scale_iterations(size_kb, ITERATIONS);
+        uint32_t bestDistance[2] = { 0, 0 };
+        for (uint32_t distanceIdx = 0; distanceIdx < distanceCount; distanceIdx++) {
+            uint32_t distance = swprefetch_distances[distanceIdx];
+            for (uint64_t i = 0; i < node_count; i++) {
+                A[order[i] * node_elements + 1] = (uint64_t)(uintptr_t)(A + order[(i + distance) % node_count] * node_elements);
             }
-        } else {
-            printf("%d,%f\n", singleSize, testFunc(singleSize, ITERATIONS, hugePagesArr));
+
+            for (int hint = 0; hint < hintCount; hint++) {
+                float latency = RunSwPrefetchTest(A + order[0] * node_elements, scaled_iterations, distance, hint);
+                float *sizeResults = results + (size_idx * hintCount + hint) * distanceCount;
+                sizeResults[distanceIdx] = latency;
+                if (latency < sizeResults[bestDistance[hint]]) bestDistance[hint] = distanceIdx;
+                if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+                    struct result_record record;
+                    snprintf(recordName, sizeof(recordName), "%s:%s", testName, swprefetch_hints[hint]);
+                    results_new_record(&record, recordName, "latency_ns", latency);
+                    record.sizeKb = size_kb;
+                    results_add_param(&record, "distance", distance);
+                    results_emit(&record);
+                } else printf("%lu KB, distance %u, %s, %f ns\n", size_kb, distance, swprefetch_hints[hint], latency);
+            }
+        }
+
+        for (int hint = 0; hint < hintCount && resultsFormat == RESULTS_FORMAT_DEFAULT; hint++) {
+            float *sizeResults = results + (size_idx * hintCount + hint) * distanceCount;
+            printf("%lu KB, best %s distance %u, %f ns vs %f ns without prefetch\n", size_kb, swprefetch_hints[hint],
+                swprefetch_distances[bestDistance[hint]], sizeResults[bestDistance[hint]], sizeResults[0]);
+        }
+
+        free(order);
+        if (arr == NULL) FreeTestArr(A, sizeof(uint64_t) * list_size);
+    }
+
+    if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+        free(results);
+        return;
+    }
+
+    // ns per element, one table per hint with a row per distance
+    for (int hint = 0; hint < hintCount; hint++) {
+        printf("%s", swprefetch_hints[hint]);
+        for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++) printf(",%lu", sizes[size_idx]);
+        printf("\n");
+        for (uint32_t distanceIdx = 0; distanceIdx < distanceCount; distanceIdx++) {
+            printf("%u", swprefetch_distances[distanceIdx]);
+            for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++)
+                printf(",%f", results[(size_idx * hintCount + hint) * distanceCount + distanceIdx]);
+            printf("\n");
         }
     }
 
+    free(results);
+}
+
+// latency is the median if multiple trials were run
+void PrintLatencyPoint(uint64_t size_kb, float latency, struct sample_stats *stats) {
+    if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+        struct result_record record;
+        results_new_record(&record, testName, "latency_ns", latency);
+        record.sizeKb = size_kb;
+        if (samplingConfig.maxTrials > 1) record.stats = stats;
+#ifndef __MINGW32__
+        for (int evtIdx = 0; pmon && evtIdx < perf_default_set.eventCount; evtIdx++)
+            results_add_counter(&record, perf_default_set.events[evtIdx].description, perf_default_set.events[evtIdx].value);
+#endif
+        results_emit(&record);
+        return;
+    }
+
+    printf("%lu,%f", size_kb, latency);
+    if (samplingConfig.maxTrials > 1) printf(",%f,%f,%f,%d", stats->min, stats->p99, stats->stddev, stats->count);
+#ifndef __MINGW32__
+    if (pmon) append_perf_values(); // from the last trial
+#endif
+    printf("\n");
+}
+
+// keeps perf counters to the timed loop, leaving out array setup
+void start_test_timing(uint64_t *startTicks) {
+#ifndef __MINGW32__
+    if (pmon) start_perf_monitoring();
+#endif
+    start_timing_ns(startTicks);
+}
+
+uint64_t end_test_timing(uint64_t *startTicks) {
+    uint64_t time_diff_ns = end_timing_ns(startTicks);
+#ifndef __MINGW32__
+    if (pmon) stop_perf_monitoring();
+#endif
+    return time_diff_ns;
+}
+
+// total RAM, or 0 if it can't be determined
+uint64_t physical_memory_kb() {
+#ifdef _SC_PHYS_PAGES
+    long pages = sysconf(_SC_PHYS_PAGES), pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0) return (uint64_t)pages * (uint64_t)pageSize / 1024;
+#endif
     return 0;
 }
 
+// Test arrays go through the page size policy set with -pages
+void *AllocTestArr(uint64_t bytes) {
+    void *arr = pages_alloc(bytes, pagePolicy);
+    if (arr != NULL && pagePolicy != PAGES_DEFAULT) ReportTestArr(arr, bytes, pagePolicy);
+    return arr;
+}
+
+void FreeTestArr(void *arr, uint64_t bytes) {
+    pages_free(arr, bytes, pagePolicy);
+}
+
+// Prints what the kernel actually backed the array with, once per size since tests reallocate every trial
+void ReportTestArr(void *arr, uint64_t bytes, int policy) {
+    static uint64_t lastReportedBytes = 0;
+    static int lastReportedPolicy = PAGES_DEFAULT;
+    struct page_report report;
+    if (bytes == lastReportedBytes && policy == lastReportedPolicy) return;
+    lastReportedBytes = bytes;
+    lastReportedPolicy = policy;
+    if (pages_verify(arr, &report) != 0) {
+        fprintf(stderr, "Could not find %lu KB array in /proc/self/smaps\n", bytes / 1024);
+        return;
+    }
+
+    fprintf(stderr, "%lu KB array with %s pages: kernel page size %lu KB, %lu KB resident, %lu KB THP, %lu KB hugetlb\n", bytes / 1024,
+        pages_policy_name(policy), report.kernelPageKb, report.rssKb, report.anonHugeKb, report.hugetlbKb);
+    if (policy == PAGES_THP && report.anonHugeKb < bytes / 1024 / 2)
+        fprintf(stderr, "Less than half of the array is on transparent hugepages. Check /sys/kernel/mm/transparent_hugepage/enabled\n");
+}
+
+// Runs the latency test at every size with each page size policy, to show what larger pages buy
+void RunPageSizeSweep(uint64_t *sizes, uint32_t sizeCount) {
+    int policies[] = { PAGES_4K, PAGES_THP, PAGES_HUGETLB_2M, PAGES_HUGETLB_1G };
+    uint32_t policyCount = sizeof(policies) / sizeof(int);
+    float *results = (float *)malloc(sizeof(float) * sizeCount * policyCount);
+    struct LatencyTestPoint point;
+    struct sample_stats stats;
+    char recordName[64];
+    point.iterations = ITERATIONS;
+    point.arr = NULL;
+    for (uint32_t policyIdx = 0; policyIdx < policyCount; policyIdx++) {
+        pagePolicy = policies[policyIdx];
+
+        // skip the policy if nothing can be mapped with it, usually because no hugetlb pages are reserved
+        void *probe = pages_alloc(sizes[0] * 1024, pagePolicy);
+        if (probe == NULL) {
+            fprintf(stderr, "Skipping %s pages\n", pages_policy_name(pagePolicy));
+            for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++) results[size_idx * policyCount + policyIdx] = 0;
+            continue;
+        }
+
+        pages_free(probe, sizes[0] * 1024, pagePolicy);
+        for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++) {
+            point.size_kb = sizes[size_idx];
+            float latency = run_sampled(&samplingConfig, MeasureLatencyPoint, &point, &stats);
+            results[size_idx * policyCount + policyIdx] = latency;
+            if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+                struct result_record record;
+                snprintf(recordName, sizeof(recordName), "%s:%s", testName, pages_policy_name(pagePolicy));
+                results_new_record(&record, recordName, "latency_ns", latency);
+                record.sizeKb = sizes[size_idx];
+                if (samplingConfig.maxTrials > 1) record.stats = &stats;
+                results_emit(&record);
+            } else printf("%lu KB, %s pages, %f ns\n", sizes[size_idx], pages_policy_name(pagePolicy), latency);
+        }
+    }
+
+    pagePolicy = PAGES_DEFAULT;
+    if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+        free(results);
+        return;
+    }
+
+    printf("Region");
+    for (uint32_t policyIdx = 0; policyIdx < policyCount; policyIdx++) printf(",%s", pages_policy_name(policies[policyIdx]));
+    printf("\n");
+    for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++) {
+        printf("%lu", sizes[size_idx]);
+        for (uint32_t policyIdx = 0; policyIdx < policyCount; policyIdx++) printf(",%f", results[size_idx * policyCount + policyIdx]);
+        printf("\n");
+    }
+
+    free(results);
+}
+
 /// <summary>
 /// Heuristic to make sure test runs for enough time but not too long
 /// </summary>
 /// <param name="size_kb">Region size</param>
 /// <param name="iterations">base iterations</param>
 /// <returns>scaled iterations</returns>
-uint64_t scale_iterations(uint32_t size_kb, uint32_t iterations) {
+uint64_t scale_iterations(uint64_t size_kb, uint32_t iterations) {
     return 10 * iterations / pow(size_kb, 1.0 / 4.0);
 }
 
@@ -416,10 +955,11 @@ void FillPageByPage(uint32_t *pattern_arr, uint32_t list_size, uint32_t byte_inc
 
 // Fills an array so that traversal completes within one page before going to another
 // random page. Tries to avoid TLB penalties at the cost of not being completely random
-// list_size = size of pattern arr in 32-bit elements
-void FillPageByPage64(uint64_t *pattern_arr, uint32_t list_size, uint32_t byte_increment) {
-    uint32_t pageCount = list_size * sizeof(uint64_t) / PAGE_SIZE;
-    uint32_t page_element_count = PAGE_SIZE / sizeof(uint64_t);
+// list_size = size of pattern arr in 64-bit elements
+void FillPageByPage64(uint64_t *pattern_arr, uint64_t list_size, uint64_t byte_increment) {
+    uint64_t pageCount = list_size * sizeof(uint64_t) / PAGE_SIZE;
+    uint64_t page_element_count = PAGE_SIZE / sizeof(uint64_t);
+    uint64_t increment = byte_increment / sizeof(uint64_t);
     if (pageCount <= 2) {
         FillPatternArr64(pattern_arr, list_size, byte_increment);
         return;
@@ -429,17 +969,16 @@ void FillPageByPage64(uint64_t *pattern_arr, uint32_t list_size, uint32_t byte_i
     short extraPage = 0;
     if (pageCount * PAGE_SIZE / sizeof(uint64_t) < list_size) extraPage = 1;
 
-    uint32_t *pagePatternArr = malloc(sizeof(uint32_t) * (pageCount + extraPage));
-    FillPatternArr(pagePatternArr, pageCount + extraPage, 4);
-    for (uint32_t page_idx = 0; page_idx < pageCount; page_idx++)
+    uint64_t *pagePatternArr = malloc(sizeof(uint64_t) * (pageCount + extraPage));
+    chain_fill64(pagePatternArr, pageCount + extraPage, 1, 0);
+    for (uint64_t page_idx = 0; page_idx < pageCount; page_idx++)
     {
         uint64_t *page_base = pattern_arr + (page_element_count * page_idx);
-        FillPatternArr((uint32_t *)page_base, page_element_count, byte_increment);
+        chain_fill64(page_base, page_element_count / increment, increment, 0);
 
-        uint32_t page_last_element_index;
-        for (uint32_t page_element_idx = 0; page_element_idx < (PAGE_SIZE / sizeof(uint64_t)); page_element_idx += (byte_increment / sizeof(uint64_t))) {
+        for (uint64_t page_element_idx = 0; page_element_idx < page_element_count; page_element_idx += increment) {
             // element that points to 0 should be directed to the next page
-            if (page_base[page_element_idx] == 0) page_base[page_element_idx] = pagePatternArr[page_idx] * (PAGE_SIZE / sizeof(uint64_t));
+            if (page_base[page_element_idx] == 0) page_base[page_element_idx] = pagePatternArr[page_idx] * page_element_count;
 
             // otherwise make sure the offset is set relative to the start of the uber-array
             else page_base[page_element_idx] += page_element_count * page_idx;
@@ -450,183 +989,251 @@ void FillPageByPage64(uint64_t *pattern_arr, uint32_t list_size, uint32_t byte_i
     return;
 }
 
-// Fills an array using Sattolo's algo
+// Fills an array with a single random cycle, see Common/chain.c
 // pattern_arr = array to fill
 // list_size = size of pattern arr in 32-bit elements
 // byte_increment = one element per this many bytes
 void FillPatternArr(uint32_t *pattern_arr, uint32_t list_size, uint32_t byte_increment) {
     uint32_t increment = byte_increment / sizeof(uint32_t);
-    uint32_t element_count = list_size / increment;
-    for (int i = 0; i < element_count; i++) {
-        pattern_arr[i * increment] = i * increment;
-    }
-
-    int iter = element_count;
-    while (iter > 1) {
-        iter -= 1;
-        int j = iter - 1 == 0 ? 0 : rand() % (iter - 1);
-        uint32_t tmp = pattern_arr[iter * increment];
-        pattern_arr[iter * increment] = pattern_arr[j * increment];
-        pattern_arr[j * increment] = tmp;
-    }
+    chain_fill32(pattern_arr, list_size / increment, increment, 0);
 }
 
-// Same thing but with 64-bit elements
+// Same thing but with 64-bit elements, and a separate cycle through each element position in a cacheline
 // pattern_arr = array to fill
 // list_size = number of 64-bit elements in array
 // byte_increment = cacheline size, in bytes
 void FillPatternArr64(uint64_t *pattern_arr, uint64_t list_size, uint64_t byte_increment) {
-    uint32_t increment = byte_increment / sizeof(uint64_t); // number of 64-bit integers in a cacheline
-    uint32_t element_count = list_size / increment;
-    for (int increment_offset = 0; increment_offset < increment; increment_offset++) {
-        for (int i = 0; i < element_count; i++) {
-            pattern_arr[i * increment + increment_offset] = i * increment + increment_offset;
-        }
-
-        int iter = element_count;
-        while (iter > 1) {
-            iter -= 1;
-            int j = iter - 1 == 0 ? 0 : rand() % (iter - 1);
-            uint64_t tmp = pattern_arr[iter * increment + increment_offset];
-            pattern_arr[iter * increment + increment_offset] = pattern_arr[j * increment + increment_offset];
-            pattern_arr[j * increment + increment_offset] = tmp;
-        }
+    uint64_t increment = byte_increment / sizeof(uint64_t); // number of 64-bit integers in a cacheline
+    for (uint64_t increment_offset = 0; increment_offset < increment; increment_offset++) {
+        chain_fill64(pattern_arr, list_size / increment, increment, increment_offset);
     }
 }
 
-float RunTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedArr) {
-    struct timeval startTv, endTv;
-    struct timezone startTz, endTz;
-    uint32_t list_size = size_kb * 1024 / 4;
+float RunTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr) {
+    uint64_t startTicks;
+    uint64_t list_size = size_kb * 1024 / 4;
     uint32_t sum = 0, current;
 
+    // indices no longer fit in 32 bits past 16 GB
+    if (pattern_is_sequence(&accessPattern)) return RunSequenceTest(size_kb, iterations, preallocatedArr);
+    if (list_size > UINT32_MAX) return RunTest64(size_kb, iterations, (uint64_t *)preallocatedArr);
+
     // Fill list to create random access pattern
     uint32_t *A;
     if (preallocatedArr == NULL) {
-        if (0 != posix_memalign((void **)(&A), 64, sizeof(uint32_t) * list_size)) {
-            fprintf(stderr, "Failed to allocate memory for %u KB test\n", size_kb);
+        if (NULL == (A = AllocTestArr(sizeof(uint32_t) * list_size))) {
+            fprintf(stderr, "Failed to allocate memory for %lu KB test\n", size_kb);
+            return 0;
         }
     } else {
         A = (uint32_t *)preallocatedArr;
     }
 
-    if (!pageByPage) FillPatternArr(A, list_size, CACHELINE_SIZE);
+    if (!pageByPage) pattern_fill32(&accessPattern, A, list_size / (CACHELINE_SIZE / 4), CACHELINE_SIZE / 4, 0, CACHELINE_SIZE);
     else FillPageByPage(A, list_size, CACHELINE_SIZE);
 
-    uint32_t scaled_iterations = scale_iterations(size_kb, iterations);
+    uint64_t scaled_iterations = scale_iterations(size_kb, iterations);
 
     // Run test
-    gettimeofday(&startTv, &startTz);
+    start_test_timing(&startTicks);
     current = A[0];
-    for (int i = 0; i < scaled_iterations; i++) {
+    for (uint64_t i = 0; i < scaled_iterations; i++) {
         current = A[current];
         sum += current;
     }
-    gettimeofday(&endTv, &endTz);
-    uint64_t time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
-    float latency = 1e6 * (float)time_diff_ms / (float)scaled_iterations;
-    if (preallocatedArr == NULL) free(A);
+    uint64_t time_diff_ns = end_test_timing(&startTicks);
+    float latency = (float)time_diff_ns / (float)scaled_iterations;
+    if (preallocatedArr == NULL) FreeTestArr(A, sizeof(uint32_t) * list_size);
 
     if (sum == 0) printf("sum == 0 (?)\n");
     return latency;
 }
 
+// Same as RunTest, with 64-bit elements so it can index arrays past 16 GB
+float RunTest64(uint64_t size_kb, uint32_t iterations, uint64_t *preallocatedArr) {
+    uint64_t startTicks;
+    uint64_t list_size = size_kb * 1024 / 8;
+    uint64_t sum = 0, current;
+
+    uint64_t *A;
+    if (preallocatedArr == NULL) {
+        if (NULL == (A = AllocTestArr(sizeof(uint64_t) * list_size))) {
+            fprintf(stderr, "Failed to allocate memory for %lu KB test\n", size_kb);
+            return 0;
+        }
+    } else {
+        A = preallocatedArr;
+    }
+
+    if (!pageByPage) pattern_fill64(&accessPattern, A, list_size / (CACHELINE_SIZE / sizeof(uint64_t)), CACHELINE_SIZE / sizeof(uint64_t), 0, CACHELINE_SIZE);
+    else FillPageByPage64(A, list_size, CACHELINE_SIZE);
+
+    uint64_t scaled_iterations = scale_iterations(size_kb, iterations);
+
+    start_test_timing(&startTicks);
+    current = A[0];
+    for (uint64_t i = 0; i < scaled_iterations; i++) {
+        current = A[current];
+        sum += current;
+    }
+    uint64_t time_diff_ns = end_test_timing(&startTicks);
+    float latency = (float)time_diff_ns / (float)scaled_iterations;
+    if (preallocatedArr == NULL) FreeTestArr(A, sizeof(uint64_t) * list_size);
+
+    if (sum == 0) printf("sum == 0 (?)\n");
+    return latency;
+}
+
+// Skewed patterns (zipf, hotcold) revisit hot lines more often than cold ones, so they can't be
+// a pointer chasing cycle. Instead, walk a precomputed sequence of line indices. Each load's address
+// adds the previously loaded value, which is always 0, so loads still serialize on each other.
+// Loads from the sequence itself are sequential and should be covered by prefetchers
+float RunSequenceTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr) {
+    uint64_t startTicks;
+    uint64_t list_size = size_kb * 1024 / 4;
+    uint64_t line_count = list_size / (CACHELINE_SIZE / 4);
+    uint64_t sequence_length = line_count, j = 0;
+    uint32_t sum = 0, current = 0;
+    if (sequence_length < 4096) sequence_length = 4096;
+    if (sequence_length > (1 << 24)) sequence_length = 1 << 24;
+
+    uint32_t *A;
+    if (preallocatedArr == NULL) {
+        if (NULL == (A = AllocTestArr(sizeof(uint32_t) * list_size))) {
+            fprintf(stderr, "Failed to allocate memory for %lu KB test\n", size_kb);
+            return 0;
+        }
+    } else {
+        A = preallocatedArr;
+    }
+
+    uint64_t *sequence = pattern_sequence(&accessPattern, line_count, sequence_length);
+    if (sequence == NULL) {
+        if (preallocatedArr == NULL) FreeTestArr(A, sizeof(uint32_t) * list_size);
+        return 0;
+    }
+
+    memset(A, 0, sizeof(uint32_t) * list_size);
+    for (uint64_t i = 0; i < sequence_length; i++) sequence[i] *= CACHELINE_SIZE / 4;
+
+    uint64_t scaled_iterations = scale_iterations(size_kb, iterations);
+
+    start_test_timing(&startTicks);
+    for (uint64_t i = 0; i < scaled_iterations; i++) {
+        current = A[sequence[j] + current];
+        sum += current;
+        j++;
+        if (j == sequence_length) j = 0;
+    }
+    uint64_t time_diff_ns = end_test_timing(&startTicks);
+    float latency = (float)time_diff_ns / (float)scaled_iterations;
+    free(sequence);
+    if (preallocatedArr == NULL) FreeTestArr(A, sizeof(uint32_t) * list_size);
+
+    if (sum != 0) printf("sum != 0 (?)\n");
+    return latency;
+}
+
 // Test array of pointers
-float RunAopTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedArr) {
-    struct timeval startTv, endTv;
-    struct timezone startTz, endTz;
-    uint32_t element_count = size_kb * 1024 / 64;  // 64B cachelines
+float RunAopTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr) {
+    uint64_t startTicks;
+    uint64_t element_count = size_kb * 1024 / 64;  // 64B cachelines
     uint32_t sum = 0, current;
 
     // allocate pattern array
-    uint32_t *pattern_arr = (uint32_t *)malloc(element_count * sizeof(uint32_t));
+    uint64_t *pattern_arr = (uint64_t *)malloc(element_count * sizeof(uint64_t));
     uint32_t **pointer_arr = (uint32_t **)malloc(element_count * sizeof(uint32_t *));
-
-    for (int i = 0; i < element_count; i++) pattern_arr[i] = i;
-    
-    int iter = element_count;
-    while (iter > 1) {
-        iter -= 1;
-        int j = iter - 1 == 0 ? 0 : rand() % (iter - 1);
-        uint32_t tmp = pattern_arr[iter];
-        pattern_arr[iter] = pattern_arr[j];
-        pattern_arr[j] = tmp;
+    if (!pattern_arr || !pointer_arr) {
+        fprintf(stderr, "Failed to allocate memory for %lu KB test (pattern arrays)\n", size_kb);
+        free(pattern_arr);
+        free(pointer_arr);
+        return 0;
     }
 
+    chain_fill64(pattern_arr, element_count, 1, 0);
+
     uint32_t *A;
     if (preallocatedArr == NULL) {
-        if (0 != posix_memalign((void **)(&A), 64, 1024 * size_kb)) {
-            fprintf(stderr, "Failed to allocate memory for %u KB test\n", size_kb);
+        if (NULL == (A = AllocTestArr(1024 * size_kb))) {
+            fprintf(stderr, "Failed to allocate memory for %lu KB test\n", size_kb);
+            free(pattern_arr);
+            free(pointer_arr);
+            return 0;
         }
     } else {
         A = (uint32_t *)preallocatedArr;
     }
 
     // make pattern array actually pointers
-    for (int i = 0; i < element_count; i++) {
+    for (uint64_t i = 0; i < element_count; i++) {
         pointer_arr[i] = A + (pattern_arr[i] * (64 / sizeof(uint32_t)));
         *pointer_arr[i] = i + 1;
     }
     free(pattern_arr); 
 
-    uint32_t scaled_iterations = scale_iterations(size_kb, iterations);
-    gettimeofday(&startTv, &startTz);
-    for (int i = 0; i < scaled_iterations;) {
-        for (int pointer_idx = 0; (pointer_idx < element_count) && (i < scaled_iterations); pointer_idx++, i++)
+    uint64_t scaled_iterations = scale_iterations(size_kb, iterations);
+    start_test_timing(&startTicks);
+    for (uint64_t i = 0; i < scaled_iterations;) {
+        for (uint64_t pointer_idx = 0; (pointer_idx < element_count) && (i < scaled_iterations); pointer_idx++, i++)
             sum += *pointer_arr[pointer_idx]; 
     }
-    gettimeofday(&endTv, &endTz);
-    uint64_t time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
-    float latency = 1e6 * (float)time_diff_ms / (float)scaled_iterations;
+    uint64_t time_diff_ns = end_test_timing(&startTicks);
+    float latency = (float)time_diff_ns / (float)scaled_iterations;
     if (sum == 0) fprintf(stderr, "something is not right\n");
-    if (preallocatedArr == NULL) free(A);
+    if (preallocatedArr == NULL) FreeTestArr(A, 1024 * size_kb);
 
     free(pointer_arr);
     return latency;
 }
 
-// Tests memory level parallelism. Returns achieved BW in MB/s using specified number of
-// independent pointer chasing chains
-float RunMlpTest(uint32_t size_kb, uint32_t iterations, uint32_t parallelism) {
-    struct timeval startTv, endTv;
-    struct timezone startTz, endTz;
-    uint32_t list_size = size_kb * 1024 / 4;
-    uint32_t sum = 0, current;
+// Tests memory level parallelism with (parallelism) independent pointer chasing chains, all through
+// the same random cycle but starting from different cachelines. Chains live in registers in the asm kernels.
+// Past what fits in registers, chains are kept in a C array instead
+// returns ns per hop on each chain. divide by parallelism for effective per-access latency
+float RunMlpTest(uint64_t size_kb, uint32_t iterations, uint32_t parallelism, uint32_t *preallocatedArr) {
+    uint64_t startTicks;
+    uint64_t list_size = size_kb * 1024 / sizeof(uint64_t);
+    uint64_t line_size = CACHELINE_SIZE / sizeof(uint64_t);
+    uint64_t line_count = list_size / line_size;
+    uint64_t *chains[MLP_MAX_CHAINS];
+
+    if (parallelism < 1 || parallelism > MLP_MAX_CHAINS) return 0;
+    if (parallelism > line_count) return 0;
+
+    uint64_t *A;
+    if (preallocatedArr == NULL) {
+        if (NULL == (A = AllocTestArr(sizeof(uint64_t) * list_size))) {
+            fprintf(stderr, "Failed to allocate memory for %lu KB test\n", size_kb);
+            return 0;
+        }
+    } else {
+        A = (uint64_t *)preallocatedArr;
+    }
 
-    if (parallelism < 1) return 0;
+    if (!pageByPage) chain_fill64(A, line_count, line_size, 0);
+    else FillPageByPage64(A, list_size, CACHELINE_SIZE);
 
-    // Fill list to create random access pattern, and hold temporary data
-    uint32_t *A = (uint32_t *)malloc(sizeof(uint32_t) * list_size);
-    uint32_t *offsets = (uint32_t *)malloc(sizeof(uint32_t) * parallelism);
-    if (!A || !offsets) {
-        fprintf(stderr, "Failed to allocate memory for %u KB test\n", size_kb);
-        return 0;
-    }
+    // indices to pointers. only the first element in each line is part of the cycle
+    for (uint64_t i = 0; i < line_count; i++) A[i * line_size] = (uint64_t)(uintptr_t)(A + A[i * line_size]);
+    for (uint32_t i = 0; i < parallelism; i++) chains[i] = A + i * line_size;
 
-    FillPatternArr(A, list_size, CACHELINE_SIZE);
-    for (int i = 0; i < parallelism; i++) offsets[i] = i * (CACHELINE_SIZE / sizeof(uint32_t));
-    uint32_t scaled_iterations = scale_iterations(size_kb, iterations) / parallelism;
+    uint64_t scaled_iterations = scale_iterations(size_kb, iterations) / parallelism;
+    if (scaled_iterations == 0) scaled_iterations = 1;
 
     // Run test
-    gettimeofday(&startTv, &startTz);
-    for (uint32_t i = 0; i < scaled_iterations; i++) {
-        for (uint32_t j = 0; j < parallelism; j++)
-        {
-            offsets[j] = A[offsets[j]];
-        }
+    start_test_timing(&startTicks);
+#ifdef MLP_ASM_MAX_CHAINS
+    if (parallelism <= MLP_ASM_MAX_CHAINS) mlptestfuncs[parallelism - 1](scaled_iterations, chains);
+    else
+#endif
+    for (uint64_t i = 0; i < scaled_iterations; i++) {
+        for (uint32_t j = 0; j < parallelism; j++) chains[j] = (uint64_t *)(uintptr_t)*chains[j];
     }
-    gettimeofday(&endTv, &endTz);
-    uint64_t time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
-    double mbTransferred = (scaled_iterations * parallelism * sizeof(uint32_t))  / (double)1e6;
-    float bw = 1000 * mbTransferred / (double)time_diff_ms;
+    uint64_t time_diff_ns = end_test_timing(&startTicks);
+    float latency = (float)time_diff_ns / (float)scaled_iterations;
 
-    sum = 0;
-    for (uint32_t i = 0; i < parallelism; i++) sum += offsets[i];
-    if (sum == 0) printf("sum == 0 (?)\n");
-
-    free(A);
-    free (offsets);
-    return bw;
+    if (preallocatedArr == NULL) FreeTestArr(A, sizeof(uint64_t) * list_size);
+    return latency;
 }
 
 #ifdef __i686
@@ -638,17 +1245,20 @@ float RunMlpTest(uint32_t size_kb, uint32_t iterations, uint32_t parallelism) {
 #endif
 
 #ifndef UNKNOWN_ARCH
-float RunAsmTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedArr) {
-    struct timeval startTv, endTv;
-    struct timezone startTz, endTz;
+float RunAsmTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr) {
+    uint64_t startTicks;
     uint64_t list_size = size_kb * 1024 / POINTER_SIZE; // using 32-bit pointers
     uint32_t sum = 0, current;
 
+    // skewed patterns can't be a single cycle, so they only have the C sequence loop
+    if (pattern_is_sequence(&accessPattern)) return RunSequenceTest(size_kb, iterations, preallocatedArr);
+
     // Fill list to create random access pattern
     POINTER_INT *A;
     if (preallocatedArr == NULL) {
-        if (0 != posix_memalign((void **)(&A), 64, POINTER_SIZE * list_size)) {
-            fprintf(stderr, "Failed to allocate memory for %u KB test\n", size_kb);
+        if (NULL == (A = AllocTestArr(POINTER_SIZE * list_size))) {
+            fprintf(stderr, "Failed to allocate memory for %lu KB test\n", size_kb);
+            return 0;
         }
     } else {
         A = (POINTER_INT *)preallocatedArr;
@@ -657,29 +1267,31 @@ float RunAsmTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedAr
     memset(A, 0, POINTER_SIZE * list_size);
 
 #ifdef __i686
-    if (!pageByPage) FillPatternArr(A, list_size, CACHELINE_SIZE);
+    if (!pageByPage) pattern_fill32(&accessPattern, A, list_size / (CACHELINE_SIZE / 4), CACHELINE_SIZE / 4, 0, CACHELINE_SIZE);
     else FillPageByPage(A, list_size, CACHELINE_SIZE);
 #else
-    if (!pageByPage) FillPatternArr64(A, list_size, CACHELINE_SIZE);
+    if (!pageByPage) {
+        for (uint64_t offset = 0; offset < CACHELINE_SIZE / 8; offset++)
+            pattern_fill64(&accessPattern, A, list_size / (CACHELINE_SIZE / 8), CACHELINE_SIZE / 8, offset, CACHELINE_SIZE);
+    }
     else FillPageByPage64(A, list_size, CACHELINE_SIZE);
 #endif
 
     preplatencyarr(A, list_size);
 
-    uint32_t scaled_iterations = scale_iterations(size_kb, iterations);
+    uint64_t scaled_iterations = scale_iterations(size_kb, iterations);
 
     // Run test
-    gettimeofday(&startTv, &startTz);
+    start_test_timing(&startTicks);
     #ifdef LONGPATTERN
     if (longpattern)
         sum = longpatternlatencytest(scaled_iterations, A);
     else
-        sum = latencytest(scaled_iterations, A);
     #endif
-    gettimeofday(&endTv, &endTz);
-    uint64_t time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
-    float latency = 1e6 * (float)time_diff_ms / (float)scaled_iterations;
-    if (preallocatedArr == NULL) free(A);
+        sum = latencytest(scaled_iterations, A);
+    uint64_t time_diff_ns = end_test_timing(&startTicks);
+    float latency = (float)time_diff_ns / (float)scaled_iterations;
+    if (preallocatedArr == NULL) FreeTestArr(A, POINTER_SIZE * list_size);
 
     // if (sum == 0) printf("sum == 0 (?)\n");
     return latency;
@@ -689,81 +1301,71 @@ float RunAsmTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedAr
 // Tries to isolate virtual to physical address translation latency by accessing
 // one element per page, and checking latency difference between that and hitting the same amount of "hot"
 // cachelines using a normal latency test.. 4 KB pages are assumed.
-float RunTlbTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedArr) {
-    struct timeval startTv, endTv;
-    struct timezone startTz, endTz;
-    uint32_t element_count = size_kb / 4;
-    uint32_t list_size = size_kb * 1024 / 4;
-    uint32_t sum = 0, current;
+// Uses 64-bit elements so indices don't overflow past 32 GB
+float RunTlbTest(uint64_t size_kb, uint32_t iterations, uint32_t *preallocatedArr) {
+    uint64_t startTicks;
+    uint64_t element_count = size_kb / 4;
+    uint64_t list_size = size_kb * 1024 / sizeof(uint64_t);
+    uint64_t sum = 0, current;
 
     if (element_count == 0) element_count = 1;
 
     //fprintf(stderr, "Element count for size %u: %u\n", size_kb, element_count);
 
     // create access pattern first, then fill it into the test array spaced by page size
-    uint32_t *pattern_arr = (uint32_t*)malloc(sizeof(uint32_t) * element_count);
+    uint64_t *pattern_arr = (uint64_t*)malloc(sizeof(uint64_t) * element_count);
     if (!pattern_arr) {
-        fprintf(stderr, "Failed to allocate memory for %u KB test (offset array)\n", size_kb);
+        fprintf(stderr, "Failed to allocate memory for %lu KB test (offset array)\n", size_kb);
         return 0;
     }
 
-    for (int i = 0; i < element_count; i++) {
-        pattern_arr[i] = i;
-    }
-
-    int iter = element_count;
-    while (iter > 1) {
-        iter -= 1;
-        int j = iter - 1 == 0 ? 0 : rand() % (iter - 1);
-        uint32_t tmp = pattern_arr[iter];
-        pattern_arr[iter] = pattern_arr[j];
-        pattern_arr[j] = tmp;
-    }
+    chain_fill64(pattern_arr, element_count, 1, 0);
 
     // translate offsets and fill the test array
     // [offset-------page-------][offset-----page------....etc
-    uint32_t *A;
+    uint64_t *A;
     if (preallocatedArr == NULL) {
-        A = (uint32_t *)malloc(sizeof(uint32_t) * list_size);
+        A = (uint64_t *)AllocTestArr(sizeof(uint64_t) * list_size);
         if (!A) {
-            fprintf(stderr, "Failed to allocate memory for %u KB test (pointer array)\n", size_kb);
+            fprintf(stderr, "Failed to allocate memory for %lu KB test (pointer array)\n", size_kb);
+            free(pattern_arr);
+            return 0;
         }
     } else {
-        A = preallocatedArr;
+        A = (uint64_t *)preallocatedArr;
     }
 
     memset(A, INT_MAX, list_size); // catch any bad accesses immediately
-    int pageIncrement = PAGE_SIZE / sizeof(uint32_t);
-    for (int i = 0;i < element_count; i++) {
+    uint64_t pageIncrement = PAGE_SIZE / sizeof(uint64_t);
+    for (uint64_t i = 0;i < element_count; i++) {
         // offset each by i cachelines to avoid conflict misses. If we just use the first cacheline
         // in each page, the index bits for every VIPT access will be the same and we'll run into L1D misses
         // faster than we would like
-        int idx = i * pageIncrement + ((i * 16) & (pageIncrement - 1));
-        int target_idx = pattern_arr[i] * pageIncrement + ((pattern_arr[i] * 16) & (pageIncrement - 1));
+        uint64_t idx = i * pageIncrement + ((i * 8) & (pageIncrement - 1));
+        uint64_t target_idx = pattern_arr[i] * pageIncrement + ((pattern_arr[i] * 8) & (pageIncrement - 1));
         A[idx] = target_idx;
     }
 
     free(pattern_arr);  // don't need this anymore
 
-    uint32_t scaled_iterations = scale_iterations(size_kb, iterations);
+    uint64_t scaled_iterations = scale_iterations(size_kb, iterations);
 
     // Run test
-    gettimeofday(&startTv, &startTz);
+    start_test_timing(&startTicks);
     current = A[0];
-    for (int i = 0; i < scaled_iterations; i++) {
+    for (uint64_t i = 0; i < scaled_iterations; i++) {
         current = A[current];
         sum += current;
         //if (size_kb == 48) fprintf(stderr, "idx: %u\n", current);
     }
-    gettimeofday(&endTv, &endTz);
-    uint64_t time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
-    float latency = 1e6 * (float)time_diff_ms / (float)scaled_iterations;
-    if (preallocatedArr == NULL) free(A);
+    uint64_t time_diff_ns = end_test_timing(&startTicks);
+    float latency = (float)time_diff_ns / (float)scaled_iterations;
+    if (preallocatedArr == NULL) FreeTestArr(A, sizeof(uint64_t) * list_size);
 
     if (element_count > 1 && sum == 0) printf("sum == 0 (?)\n");
 
     // Get a reference timing for the size, to isolate TLB latency from cache latency
-    uint32_t memoryUsedKb = (element_count * CACHELINE_SIZE) / 1024;
+    uint64_t memoryUsedKb = (element_count * CACHELINE_SIZE) / 1024;
     if (memoryUsedKb == 0) memoryUsedKb = 1;
     float cacheLatency = RunTest(memoryUsedKb, iterations, preallocatedArr);
 
@@ -771,15 +1373,635 @@ float RunTlbTest(uint32_t size_kb, uint32_t iterations, uint32_t *preallocatedAr
     return latency - cacheLatency;
 }
 
+// Page strides and page counts for the TLB suite. Strides of 2 MB and 1 GB put every access in a different
+// page directory or page directory pointer table entry, so page walk caches for those levels miss too.
+// Past 512 accesses, 1 GB strides also cross into another PML4 entry
+const uint64_t tlb_suite_strides_kb[] = { 4, 64, 2048, 1048576 };
+const uint64_t tlb_suite_page_counts[] = { 8, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096,
+    6144, 8192, 12288, 16384, 24576, 32768, 65536 };
+
+// caps on the sparse mapping, and on page tables built under it, which take two 4K pages per access at 1 GB stride
+#define TLB_SUITE_MAX_VIRTUAL_GB (16 * 1024)
+#define TLB_SUITE_MAX_1G_PAGES 16384
+
+#ifdef __linux__
+// Chases one element per (strideKb) of virtual address space over pageCount strides. The mapping is sparse
+// and only touched 4K pages get backed, so huge strides don't need huge amounts of memory.
+// Returns ns per access, or 0 if the range couldn't be mapped
+float RunTlbStrideTest(uint64_t strideKb, uint64_t pageCount, uint32_t iterations) {
+    uint64_t startTicks, sum = 0;
+    uint64_t stride = strideKb * 1024, mappedBytes = stride * pageCount;
+    char *base = mmap(NULL, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Could not map %lu GB of address space for %lu KB stride, errno %d = %s\n", mappedBytes >> 30, strideKb, errno, strerror(errno));
+        return 0;
+    }
+
+    // keep it on 4K pages so strides line up with page table levels
+    madvise(base, mappedBytes, MADV_NOHUGEPAGE);
+    uint64_t *order = (uint64_t *)malloc(sizeof(uint64_t) * pageCount);
+    chain_random_order(order, pageCount, chain_next_seed());
+
+    // rotate through cachelines within each page like RunTlbTest, to avoid L1D conflict misses
+    for (uint64_t i = 0; i < pageCount; i++) {
+        uint64_t node = order[i], next = order[(i + 1) % pageCount];
+        uint64_t *element = (uint64_t *)(base + node * stride + ((node * CACHELINE_SIZE) & (PAGE_SIZE - 1)));
+        *element = (uint64_t)(uintptr_t)(base + next * stride + ((next * CACHELINE_SIZE) & (PAGE_SIZE - 1)));
+    }
+
+    free(order);
+    uint64_t scaled_iterations = scale_iterations(pageCount * 4, iterations);
+    uint64_t *current = (uint64_t *)(uintptr_t)*(uint64_t *)base;
+    start_test_timing(&startTicks);
+    for (uint64_t i = 0; i < scaled_iterations; i++) {
+        current = (uint64_t *)(uintptr_t)*current;
+        sum += (uintptr_t)current;
+    }
+    uint64_t time_diff_ns = end_test_timing(&startTicks);
+    munmap(base, mappedBytes);
+    if (sum == 0) printf("sum == 0 (?)\n");
+    return (float)time_diff_ns / (float)scaled_iterations;
+}
+#endif
+
+// Finds steps in translation overhead as page count increases, which should correspond to running out of
+// L1 DTLB entries, L2 TLB entries, and page walk cache/data cache coverage of page table entries.
+// A step is where overhead rises by more than 1 ns and 25% over the current plateau, and stays up at the next point
+void InferTlbSteps(uint64_t strideKb, uint64_t *pageCounts, float *overhead, uint32_t count) {
+    float plateau = overhead[0] > 0 ? overhead[0] : 0;
+    int steps = 0;
+    for (uint32_t i = 1; i < count; i++) {
+        float threshold = plateau + (plateau * 0.25f > 1.0f ? plateau * 0.25f : 1.0f);
+        float next = i + 1 < count ? overhead[i + 1] : overhead[i];
+        if (overhead[i] > threshold && next > threshold) {
+            float newPlateau = next > overhead[i] ? overhead[i] : next;
+            printf("%lu KB stride: coverage ends around %lu pages (%lu KB), ~%f ns more per access past that\n",
+                strideKb, pageCounts[i - 1], pageCounts[i - 1] * strideKb, newPlateau - plateau);
+            plateau = newPlateau;
+            steps++;
+        }
+    }
+
+    if (steps == 0) printf("%lu KB stride: no clear steps\n", strideKb);
+}
+
+// TLB and page walk suite. For each page stride, sweeps page count and subtracts the latency of chasing
+// the same number of cachelines packed together, leaving address translation overhead.
+// Also reports how many page table entries each level needs to cover the accessed range
+void RunTlbSuite() {
+#ifdef __linux__
+    uint32_t strideCount = sizeof(tlb_suite_strides_kb) / sizeof(uint64_t);
+    uint32_t countCount = sizeof(tlb_suite_page_counts) / sizeof(uint64_t);
+    float *overhead = (float *)malloc(sizeof(float) * strideCount * countCount);
+    uint64_t *pageCounts = (uint64_t *)malloc(sizeof(uint64_t) * countCount);
+    char recordName[64];
+    if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("Stride (KB),Pages,Latency (ns),Reference (ns),Translation (ns),PD entries,PDPT entries,PML4 entries\n");
+    for (uint32_t strideIdx = 0; strideIdx < strideCount; strideIdx++) {
+        uint64_t strideKb = tlb_suite_strides_kb[strideIdx];
+        uint32_t validCounts = 0;
+        for (uint32_t countIdx = 0; countIdx < countCount; countIdx++) {
+            uint64_t pageCount = tlb_suite_page_counts[countIdx];
+            if (pageCount * strideKb > (uint64_t)TLB_SUITE_MAX_VIRTUAL_GB * 1024 * 1024) break;
+            if (strideKb >= 1048576 && pageCount > TLB_SUITE_MAX_1G_PAGES) break;
+            float latency = RunTlbStrideTest(strideKb, pageCount, ITERATIONS);
+            if (latency == 0) break;
+
+            uint64_t referenceKb = pageCount * CACHELINE_SIZE / 1024;
+            float reference = RunTest(referenceKb > 0 ? referenceKb : 1, ITERATIONS, NULL);
+            uint64_t spanKb = pageCount * strideKb;
+            // page table entries touched at each level
+            uint64_t pdEntries = (spanKb + 2047) / 2048, pdptEntries = (spanKb + 1048575) / 1048576;
+            uint64_t pml4Entries = (spanKb + 536870911) / 536870912;
+            if (pdEntries > pageCount) pdEntries = pageCount;
+            if (pdptEntries > pageCount) pdptEntries = pageCount;
+            overhead[strideIdx * countCount + countIdx] = latency - reference;
+            pageCounts[countIdx] = pageCount;
+            validCounts++;
+            if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+                struct result_record record;
+                snprintf(recordName, sizeof(recordName), "%s:%luk", testName, strideKb);
+                results_new_record(&record, recordName, "latency_ns", latency);
+                record.sizeKb = spanKb;
+                results_add_param(&record, "pages", pageCount);
+                results_add_param(&record, "stride_kb", strideKb);
+                results_add_param(&record, "reference_ns", reference);
+                results_add_param(&record, "translation_ns", latency - reference);
+                results_add_param(&record, "pd_entries", pdEntries);
+                results_add_param(&record, "pdpt_entries", pdptEntries);
+                results_add_param(&record, "pml4_entries", pml4Entries);
+                results_emit(&record);
+            } else printf("%lu,%lu,%f,%f,%f,%lu,%lu,%lu\n", strideKb, pageCount, latency, reference, latency - reference, pdEntries, pdptEntries, pml4Entries);
+        }
+
+        if (resultsFormat == RESULTS_FORMAT_DEFAULT && validCounts > 1)
+            InferTlbSteps(strideKb, pageCounts, overhead + strideIdx * countCount, validCounts);
+    }
+
+    free(overhead);
+    free(pageCounts);
+#else
+    fprintf(stderr, "TLB suite needs Linux\n");
+#endif
+}
+
+#ifdef NUMA
+// Fraction of sampled pages that really are on node, via move_pages with no target nodes (query only)
+float NumaOnNodeFraction(void *arr, uint64_t bytes, int node) {
+    void *pages[64];
+    int status[64], samples = 0, onNode = 0;
+    uint64_t step = bytes / 64;
+    if (step < PAGE_SIZE) step = PAGE_SIZE;
+    for (uint64_t offset = 0; offset < bytes && samples < 64; offset += step) pages[samples++] = (char *)arr + offset;
+    if (move_pages(0, samples, pages, NULL, status, 0) != 0) return -1;
+    for (int i = 0; i < samples; i++) if (status[i] == node) onNode++;
+    return (float)onNode / samples;
+}
+
+// NUMA latency matrix. Pins to one core at a time, either the first core on each node or every core, and
+// tests memory on every node with memory, including ones without cpus (like CXL expanders).
+// Each test gets a fresh allocation bound to the target node before first touch, then checked with move_pages
+void RunNumaMatrix(uint64_t size_kb, int everyCore, int hugePages) {
+    if (numa_available() == -1) {
+        fprintf(stderr, "NUMA is not available\n");
+        return;
+    }
+
+    int nodeCount = numa_max_node() + 1, cpuCount = numa_num_configured_cpus();
+    uint64_t bytes = size_kb * 1024;
+    int policy = pagePolicy;
+    if (hugePages && policy == PAGES_DEFAULT) policy = PAGES_HUGETLB_2M;
+    if (nodeCount > 64) {
+        fprintf(stderr, "Too many NUMA nodes. Go home.\n");
+        return;
+    }
+
+    // rows are cpus, either one per node or all of them
+    int *rowCpus = (int *)malloc(sizeof(int) * cpuCount), rowCount = 0;
+    int *memNodes = (int *)malloc(sizeof(int) * nodeCount), memNodeCount = 0;
+    for (int node = 0; node < nodeCount; node++) {
+        long long freeBytes;
+        if (numa_node_size64(node, &freeBytes) > 0) memNodes[memNodeCount++] = node;
+        else continue;
+        if (!everyCore) {
+            for (int cpu = 0; cpu < cpuCount; cpu++) {
+                if (numa_node_of_cpu(cpu) == node) {
+                    rowCpus[rowCount++] = cpu;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int cpu = 0; cpu < cpuCount && everyCore; cpu++) {
+        if (numa_node_of_cpu(cpu) >= 0) rowCpus[rowCount++] = cpu;
+    }
+
+    for (int memIdx = 0; memIdx < memNodeCount; memIdx++) {
+        struct bitmask *nodeCpus = numa_allocate_cpumask();
+        numa_node_to_cpus(memNodes[memIdx], nodeCpus);
+        if (numa_bitmask_weight(nodeCpus) == 0) fprintf(stderr, "Node %d has memory but no cpus\n", memNodes[memIdx]);
+        numa_free_cpumask(nodeCpus);
+    }
+
+    float *latencies = (float *)malloc(sizeof(float) * rowCount * memNodeCount);
+    for (int row = 0; row < rowCount; row++) {
+        int cpu = rowCpus[row], cpuNode = numa_node_of_cpu(cpu);
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) {
+            fprintf(stderr, "Could not pin to cpu %d, skipping it\n", cpu);
+            for (int memIdx = 0; memIdx < memNodeCount; memIdx++) latencies[row * memNodeCount + memIdx] = 0;
+            continue;
+        }
+
+        for (int memIdx = 0; memIdx < memNodeCount; memIdx++) {
+            int memNode = memNodes[memIdx];
+            unsigned long nodeMask = 1UL << memNode;
+            uint32_t *arr;
+            if (policy == PAGES_DEFAULT) {
+                arr = numa_alloc_onnode(bytes, memNode);
+            } else {
+                arr = pages_map(bytes, policy);
+                if (arr != NULL && mbind(arr, bytes, MPOL_BIND, &nodeMask, sizeof(nodeMask) * 8, MPOL_MF_STRICT) != 0) {
+                    fprintf(stderr, "mbind to node %d failed, errno %d = %s\n", memNode, errno, strerror(errno));
+                    pages_unmap(arr, bytes, policy);
+                    arr = NULL;
+                }
+            }
+
+            if (arr == NULL) {
+                fprintf(stderr, "Could not allocate %lu KB on node %d\n", size_kb, memNode);
+                latencies[row * memNodeCount + memIdx] = 0;
+                continue;
+            }
+
+            float latency = testFunc(size_kb, ITERATIONS, arr);
+            float onNode = NumaOnNodeFraction(arr, bytes, memNode);
+            if (onNode >= 0 && onNode < 1) fprintf(stderr, "Only %.0f%% of sampled pages are on node %d\n", onNode * 100, memNode);
+            if (policy == PAGES_DEFAULT) numa_free(arr, bytes);
+            else pages_unmap(arr, bytes, policy);
+
+            latencies[row * memNodeCount + memIdx] = latency;
+            fprintf(stderr, "CPU %d (node %d) -> mem node %d: %f ns\n", cpu, cpuNode, memNode, latency);
+            if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+                struct result_record record;
+                results_new_record(&record, testName, "latency_ns", latency);
+                record.sizeKb = size_kb;
+                results_add_param(&record, "cpu", cpu);
+                results_add_param(&record, "cpu_node", cpuNode);
+                results_add_param(&record, "mem_node", memNode);
+                results_add_param(&record, "on_node_fraction", onNode);
+                results_emit(&record);
+            }
+        }
+    }
+
+    if (resultsFormat == RESULTS_FORMAT_DEFAULT) {
+        // node to node, or cpu to node with -numacores
+        printf("%s", everyCore ? "CPU" : "Node");
+        for (int memIdx = 0; memIdx < memNodeCount; memIdx++) printf(",%d", memNodes[memIdx]);
+        printf("\n");
+        for (int row = 0; row < rowCount; row++) {
+            printf("%d", everyCore ? rowCpus[row] : numa_node_of_cpu(rowCpus[row]));
+            for (int memIdx = 0; memIdx < memNodeCount; memIdx++) printf(",%f", latencies[row * memNodeCount + memIdx]);
+            printf("\n");
+        }
+    }
+
+    free(latencies);
+    free(rowCpus);
+    free(memNodes);
+}
+#endif
+
+struct ThreadedLatencyData {
+    pthread_t handle;
+    int cpu;
+    uint64_t size_kb;
+    uint64_t iterations;
+    uint64_t *arr;        // shared array, or NULL to allocate a private one
+    uint64_t *order;      // node order for a private array, drawn on the main thread so -seed is reproducible
+    uint64_t *privateArr; // private array, left for the main thread to report and free
+    uint64_t start;       // starting element in a shared array
+    pthread_barrier_t *barrier;
+    float latency;
+};
+
+// Chases a 64-bit index chain like RunTest64, after every thread is pinned and has its array ready
+void *ThreadedLatencyThread(void *param) {
+    struct ThreadedLatencyData *data = (struct ThreadedLatencyData *)param;
+    uint64_t startTicks, sum = 0, current;
+    uint64_t list_size = data->size_kb * 1024 / sizeof(uint64_t);
+    uint64_t *A = data->arr;
+#ifndef __MINGW32__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(data->cpu, &cpuset);
+    sched_setaffinity(0, sizeof(cpu_set_t), &cpuset);
+#endif
+
+    // private arrays are filled on the thread's own core, so first touch puts them on its NUMA node.
+    // linked serially, because helper threads would inherit this thread's single cpu affinity
+    if (A == NULL) {
+        A = (uint64_t *)pages_alloc(sizeof(uint64_t) * list_size, pagePolicy);
+        if (A != NULL) chain_link64_serial(A, data->order, list_size / (CACHELINE_SIZE / sizeof(uint64_t)), CACHELINE_SIZE / sizeof(uint64_t), 0);
+        else fprintf(stderr, "Failed to allocate memory for %lu KB test on cpu %d\n", data->size_kb, data->cpu);
+        data->privateArr = A;
+    }
+
+    pthread_barrier_wait(data->barrier);
+    if (A == NULL) {
+        data->latency = 0;
+        return NULL;
+    }
+
+    current = A[data->start];
+    start_timing_ns(&startTicks);
+    for (uint64_t i = 0; i < data->iterations; i++) {
+        current = A[current];
+        sum += current;
+    }
+    data->latency = (float)end_timing_ns(&startTicks) / (float)data->iterations;
+    if (sum == 0) printf("sum == 0 (?)\n");
+    return NULL;
+}
+
+// Runs latency tests on several pinned threads at once, each reporting its own latency. With shared = 0,
+// every thread chases its own array. Otherwise they all chase one random cycle through the same array,
+// starting evenly spaced along it so they aren't hitting lines another thread just brought in
+void RunThreadedLatency(uint64_t *sizes, uint32_t sizeCount, int threadCount, int threadMode, int shared) {
+    struct cpu_topology topo;
+    pthread_barrier_t barrier;
+    char recordName[64];
+    topology_init(&topo);
+    int *cpus = (int *)malloc(sizeof(int) * topo.cpuCount);
+    int cpuCount = topology_select_cpus(&topo, threadMode, -1, cpus, topo.cpuCount);
+    if (threadCount > cpuCount) {
+        fprintf(stderr, "Only %d cpus available, running %d threads\n", cpuCount, cpuCount);
+        threadCount = cpuCount;
+    }
+
+    fprintf(stderr, "Latency threads on cpus:");
+    for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) fprintf(stderr, " %d", cpus[threadIdx]);
+    fprintf(stderr, "\n");
+
+    struct ThreadedLatencyData *threadData = (struct ThreadedLatencyData *)malloc(sizeof(struct ThreadedLatencyData) * threadCount);
+    if (resultsFormat == RESULTS_FORMAT_DEFAULT) {
+        printf("Region,Mean (ns),Max (ns)");
+        for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) printf(",CPU %d", cpus[threadIdx]);
+        printf("\n");
+    }
+
+    for (uint32_t size_idx = 0; size_idx < sizeCount; size_idx++) {
+        uint64_t size_kb = sizes[size_idx];
+        uint64_t list_size = size_kb * 1024 / sizeof(uint64_t);
+        uint64_t node_elements = CACHELINE_SIZE / sizeof(uint64_t), node_count = list_size / node_elements;
+        uint64_t *sharedArr = NULL, *order = NULL;
+        if (shared) {
+            sharedArr = (uint64_t *)AllocTestArr(sizeof(uint64_t) * list_size);
+            order = (uint64_t *)malloc(sizeof(uint64_t) * node_count);
+            if (sharedArr == NULL || order == NULL) {
+                fprintf(stderr, "Failed to allocate memory for %lu KB test\n", size_kb);
+                FreeTestArr(sharedArr, sizeof(uint64_t) * list_size);
+                free(order);
+                continue;
+            }
+
+            chain_random_order(order, node_count, chain_next_seed());
+            chain_link64(sharedArr, order, node_count, node_elements, 0);
+        }
+
+        // each private chain gets its own order, drawn here in thread order so -seed gives the same chains every run
+        int setupFailed = 0;
+        for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
+            threadData[threadIdx].order = NULL;
+            threadData[threadIdx].privateArr = NULL;
+            if (shared) continue;
+            threadData[threadIdx].order = (uint64_t *)malloc(sizeof(uint64_t) * node_count);
+            if (threadData[threadIdx].order == NULL || chain_random_order(threadData[threadIdx].order, node_count, chain_next_seed()) != 0) setupFailed = 1;
+        }
+
+        if (setupFailed) {
+            fprintf(stderr, "Failed to allocate memory for %lu KB test\n", size_kb);
+            for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) free(threadData[threadIdx].order);
+            continue;
+        }
+
+        pthread_barrier_init(&barrier, NULL, threadCount);
+        for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
+            threadData[threadIdx].cpu = cpus[threadIdx];
+            threadData[threadIdx].size_kb = size_kb;
+            threadData[threadIdx].iterations = scale_iterations(size_kb, ITERATIONS);
+            threadData[threadIdx].arr = sharedArr;
+            threadData[threadIdx].start = shared ? order[threadIdx * node_count / threadCount] * node_elements : 0;
+            threadData[threadIdx].barrier = &barrier;
+            pthread_create(&(threadData[threadIdx].handle), NULL, ThreadedLatencyThread, (void *)(threadData + threadIdx));
+        }
+
+        float mean = 0, max = 0;
+        for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
+            pthread_join(threadData[threadIdx].handle, NULL);
+            mean += threadData[threadIdx].latency / threadCount;
+            if (threadData[threadIdx].latency > max) max = threadData[threadIdx].latency;
+        }
+
+        pthread_barrier_destroy(&barrier);
+        if (shared) {
+            FreeTestArr(sharedArr, sizeof(uint64_t) * list_size);
+            free(order);
+        } else {
+            // report what one thread's array was backed with, once, instead of every thread racing to print it
+            if (pagePolicy != PAGES_DEFAULT && threadData[0].privateArr != NULL)
+                ReportTestArr(threadData[0].privateArr, sizeof(uint64_t) * list_size, pagePolicy);
+            for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
+                if (threadData[threadIdx].privateArr != NULL) FreeTestArr(threadData[threadIdx].privateArr, sizeof(uint64_t) * list_size);
+                free(threadData[threadIdx].order);
+            }
+        }
+
+        if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+            snprintf(recordName, sizeof(recordName), "%s:%s", testName, shared ? "shared" : "private");
+            for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
+                struct result_record record;
+                results_new_record(&record, recordName, "latency_ns", threadData[threadIdx].latency);
+                record.sizeKb = size_kb;
+                record.threads = threadCount;
+                results_add_param(&record, "cpu", threadData[threadIdx].cpu);
+                results_add_param(&record, "mean_ns", mean);
+                results_add_param(&record, "max_ns", max);
+                results_emit(&record);
+            }
+        } else {
+            printf("%lu,%f,%f", size_kb, mean, max);
+            for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) printf(",%f", threadData[threadIdx].latency);
+            printf("\n");
+        }
+    }
+
+    free(threadData);
+    free(cpus);
+    topology_free(&topo);
+}
+
+// Core clock from a one add per clock dependency chain, or 0 if there's no kernel for it on this architecture
+float EstimateClockGhz() {
+#ifdef STLF_MATRIX
+    uint64_t startTicks, clockIterations = 200000000;
+    start_timing_ns(&startTicks);
+    clktest(clockIterations);
+    float clockGhz = (float)clockIterations / (float)end_timing_ns(&startTicks);
+    fprintf(stderr, "Estimated clock speed: %.2f GHz\n", clockGhz);
+    return clockGhz;
+#else
+    return 0;
+#endif
+}
+
+#define DISAMBIG_PATTERN_LENGTH 4096
+#define DISAMBIG_NOALIAS_OFFSET 64
+#define DISAMBIG_4K_OFFSET 4096
+
+// Load address patterns for the disambiguation test. aliasPeriod = every (period)th load aliases the store.
+// aliasPercent = loads alias randomly with this probability. aliasOffset = offset for loads that don't alias
+struct DisambigPattern {
+    const char *name;
+    uint32_t aliasPeriod;
+    uint32_t aliasPercent;
+    uint32_t otherOffset;
+};
+
+const struct DisambigPattern disambig_patterns[] = {
+    { "noalias", 0, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias", 1, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "4k_alias", 0, 0, DISAMBIG_4K_OFFSET },
+    { "alias_every_2", 2, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_every_4", 4, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_every_8", 8, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_every_16", 16, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_every_32", 32, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_every_64", 64, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_every_128", 128, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_every_256", 256, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_every_1024", 1024, 0, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_random_50", 0, 50, DISAMBIG_NOALIAS_OFFSET },
+    { "alias_random_12", 0, 12, DISAMBIG_NOALIAS_OFFSET },
+};
+
+// Memory disambiguation test. A store's address resolves late, and a following load with an early address
+// either aliases it or doesn't, following a pattern. Compares each pattern against never aliasing.
+// Periodic patterns show how quickly the alias predictor learns and forgets: penalty per aliasing load
+// should fall off once aliasing is frequent enough to keep loads waiting, and rise when it's sparse enough
+// that the predictor goes back to speculating
+void RunDisambigTest(uint32_t iterations) {
+#ifdef DISAMBIG_TEST
+    uint32_t patternCount = sizeof(disambig_patterns) / sizeof(struct DisambigPattern);
+    uint64_t startTicks;
+    uint32_t *offsets;
+    char *arr;
+    struct chain_rng rng;
+    if (0 != posix_memalign((void **)(&arr), 4096, DISAMBIG_4K_OFFSET + 4096) ||
+        0 != posix_memalign((void **)(&offsets), 64, sizeof(uint32_t) * DISAMBIG_PATTERN_LENGTH)) {
+        fprintf(stderr, "Could not allocate memory for disambiguation test\n");
+        return;
+    }
+
+    memset(arr, 0, DISAMBIG_4K_OFFSET + 4096);
+    float clockGhz = EstimateClockGhz();
+    float baselineNs = 0;
+    chain_rng_seed(&rng, chain_next_seed(), 0);
+    if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("Pattern,ns per iteration,clocks per iteration,penalty ns per aliasing load,penalty clocks per aliasing load\n");
+    for (uint32_t patternIdx = 0; patternIdx < patternCount; patternIdx++) {
+        const struct DisambigPattern *pattern = disambig_patterns + patternIdx;
+        uint32_t aliasCount = 0;
+        for (uint32_t i = 0; i < DISAMBIG_PATTERN_LENGTH; i++) {
+            int alias = 0;
+            if (pattern->aliasPeriod) alias = i % pattern->aliasPeriod == 0;
+            else if (pattern->aliasPercent) alias = chain_rng_bounded(&rng, 100) < pattern->aliasPercent;
+            offsets[i] = alias ? 0 : pattern->otherOffset;
+            aliasCount += alias;
+        }
+
+        disambigtest(iterations / 10, offsets, arr, DISAMBIG_PATTERN_LENGTH - 1);
+        start_test_timing(&startTicks);
+        disambigtest(iterations, offsets, arr, DISAMBIG_PATTERN_LENGTH - 1);
+        uint64_t time_diff_ns = end_test_timing(&startTicks);
+        float ns = (float)time_diff_ns / (float)iterations;
+        float clocks = ns * clockGhz;
+#ifndef __MINGW32__
+        if (pmon && get_perf_value("cycles") > 0) clocks = (float)get_perf_value("cycles") / (float)iterations;
+#endif
+        if (patternIdx == 0) baselineNs = ns;
+
+        // extra time per aliasing load, compared to never aliasing. 4K aliasing is charged to every load
+        float aliasFraction = aliasCount > 0 ? (float)aliasCount / DISAMBIG_PATTERN_LENGTH : 1.0f;
+        float penaltyNs = (ns - baselineNs) / aliasFraction;
+        float penaltyClocks = clockGhz > 0 ? penaltyNs * clockGhz : 0;
+        if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+            char recordName[64];
+            struct result_record record;
+            snprintf(recordName, sizeof(recordName), "%s:%s", testName, pattern->name);
+            results_new_record(&record, recordName, "latency_ns", ns);
+            results_add_param(&record, "clocks", clocks);
+            results_add_param(&record, "alias_fraction", aliasCount / (float)DISAMBIG_PATTERN_LENGTH);
+            results_add_param(&record, "penalty_ns", penaltyNs);
+            results_add_param(&record, "penalty_clocks", penaltyClocks);
+            results_emit(&record);
+        } else printf("%s,%f,%f,%f,%f\n", pattern->name, ns, clocks, penaltyNs, penaltyClocks);
+    }
+
+    free(offsets);
+    free(arr);
+#else
+    fprintf(stderr, "Memory disambiguation test is only implemented for x86-64 and aarch64\n");
+#endif
+}
+
+// Store to load forwarding matrix. For every store size and load size from 1 to 64 bytes, places the store
+// at each offset in a cacheline and the load at every offset that overlaps it, and times the store -> load
+// dependency chain. Output is one row per cell in core clocks, so it can go straight into a heat map.
+// Clocks come from the cycles perf counter with -pmon, otherwise from ns scaled by measured clock speed
+void RunStlfMatrix(uint32_t iterations) {
+#ifdef STLF_MATRIX
+    const int sizes[] = { 1, 2, 4, 8, 16, 32, 64 };
+    int sizeCount = sizeof(sizes) / sizeof(int);
+    uint64_t startTicks;
+    char *arr;
+
+    // arr[0] and arr[1] hold store and load offsets, test area starts at arr + 64 so loads can start before the store
+    if (0 != posix_memalign((void **)(&arr), 64, 256)) {
+        fprintf(stderr, "Could not obtain aligned memory\n");
+        return;
+    }
+
+    memset(arr, 0, 256);
+    float clockGhz = EstimateClockGhz();
+
+    // each cell is short, so use a fraction of base iterations. Kernels are unrolled 5x
+    uint64_t cellIterations = iterations / 1000;
+    if (cellIterations < 1000) cellIterations = 1000;
+    cellIterations -= cellIterations % 5;
+    int avx = __builtin_cpu_supports("avx"), avx512 = __builtin_cpu_supports("avx512f");
+    if (!avx512) fprintf(stderr, "No AVX-512, skipping 64B stores and loads\n");
+    if (!avx) fprintf(stderr, "No AVX, skipping 32B stores and loads\n");
+
+    float *cells = (float *)malloc(sizeof(float) * 64 * 127);
+    if (resultsFormat == RESULTS_FORMAT_DEFAULT) printf("Store size,Load size,Store offset,Load offset from store,Cycles\n");
+    for (int storeIdx = 0; storeIdx < sizeCount; storeIdx++) {
+        for (int loadIdx = 0; loadIdx < sizeCount; loadIdx++) {
+            int storeSize = sizes[storeIdx], loadSize = sizes[loadIdx];
+            if ((storeSize == 64 || loadSize == 64) && !avx512) continue;
+            if ((storeSize == 32 || loadSize == 32) && !avx) continue;
+            stlfmatrixfunc func = stlfmatrixfuncs[storeIdx * sizeCount + loadIdx];
+            float minCycles = 1e9f;
+            int cellCount = 0, fastCells = 0;
+            for (int storeOffset = 0; storeOffset < 64; storeOffset++) {
+                for (int loadDelta = 1 - loadSize; loadDelta < storeSize; loadDelta++) {
+                    ((uint32_t *)arr)[0] = 64 + storeOffset;
+                    ((uint32_t *)arr)[1] = 64 + storeOffset + loadDelta;
+                    func(100, arr);
+                    start_test_timing(&startTicks);
+                    func(cellIterations, arr);
+                    uint64_t time_diff_ns = end_test_timing(&startTicks);
+                    float cycles = (float)time_diff_ns * clockGhz / (float)cellIterations;
+#ifndef __MINGW32__
+                    if (pmon && get_perf_value("cycles") > 0) cycles = (float)get_perf_value("cycles") / (float)cellIterations;
+#endif
+                    cells[cellCount++] = cycles;
+                    if (cycles < minCycles) minCycles = cycles;
+                    if (resultsFormat != RESULTS_FORMAT_DEFAULT) {
+                        struct result_record record;
+                        results_new_record(&record, testName, "cycles", cycles);
+                        results_add_param(&record, "store_size", storeSize);
+                        results_add_param(&record, "load_size", loadSize);
+                        results_add_param(&record, "store_offset", storeOffset);
+                        results_add_param(&record, "load_offset", loadDelta);
+                        results_emit(&record);
+                    } else printf("%d,%d,%d,%d,%.2f\n", storeSize, loadSize, storeOffset, loadDelta, cycles);
+                }
+            }
+
+            for (int cellIdx = 0; cellIdx < cellCount; cellIdx++) if (cells[cellIdx] < minCycles * 1.5f) fastCells++;
+            fprintf(stderr, "%dB store, %dB load: fastest %.2f clocks, %d of %d overlapping placements within 1.5x of that\n",
+                storeSize, loadSize, minCycles, fastCells, cellCount);
+        }
+    }
+
+    free(cells);
+    free(arr);
+#else
+    fprintf(stderr, "Store to load forwarding matrix is only implemented for x86-64\n");
+#endif
+}
+
 // Run store to load forwarding test, as described in https://blog.stuffedcow.net/2014/01/x86-memory-disambiguation/
 // uses 4B loads and 8B stores to see when/if store forwarding can succeed when sizes are not matched
 // pageEnd = push test to the end of (pageEnd) sized page. 0 = just test cacheline
 // loadDistance = how far ahead to push the load (for testing aliasing)
 // cannot set both pageEnd and loadDistance
 void RunStlfTest(uint32_t iterations, int mode, int pageEnd, int loadDistance) {
-    struct timeval startTv, endTv;
-    struct timezone startTz, endTz;
-    uint64_t time_diff_ms;
+    uint64_t startTicks;
+    uint64_t time_diff_ns;
     float latency;
     float stlfResults[64][64];
     char *arr; 
@@ -817,11 +2039,10 @@ void RunStlfTest(uint32_t iterations, int mode, int pageEnd, int loadDistance) {
         for (int loadOffset = 0; loadOffset < 64; loadOffset++) {
             ((uint32_t *)(arr))[0] = storeOffset;
             ((uint32_t *)(arr))[1] = loadOffset + loadDistance;
-            gettimeofday(&startTv, &startTz);
+            start_test_timing(&startTicks);
             stlfFunc(iterations, arr);
-            gettimeofday(&endTv, &endTz);
-            time_diff_ms = 1e6 * (endTv.tv_sec - startTv.tv_sec) + (endTv.tv_usec - startTv.tv_usec);
-            latency = 1e3 * (float) time_diff_ms / (float) iterations;
+            time_diff_ns = end_test_timing(&startTicks);
+            latency = (float) time_diff_ns / (float) iterations;
             stlfResults[storeOffset][loadOffset] = latency;
             fprintf(stderr, "Store offset %d, load offset %d: %f ns\n", storeOffset, loadOffset, latency);
         }
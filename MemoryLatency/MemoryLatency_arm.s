@@ -3,18 +3,22 @@
 .global latencytest
 .global longpatternlatencytest
 .global preplatencyarr
+.global mlptestfuncs
 .global stlftest
 .global stlftest32
 .global stlftest128
 .global matchedstlftest
+.global disambigtest
 
 .global _latencytest
 .global _longpatternlatencytest
 .global _preplatencyarr
+.global _mlptestfuncs
 .global _stlftest
 .global _stlftest32
 .global _stlftest128
 .global _matchedstlftest
+.global _disambigtest
 
 .balign 4
 
@@ -27,11 +31,11 @@ preplatencyarr:
   stp x14, x15, [sp, #0x10]
   mov x15, 0
 preplatencyarr_loop:
-  ldr x14, [x0, w15, uxtw #3]
+  ldr x14, [x0, x15, lsl #3]
   lsl x14, x14, 3
   add x14, x14, x0
-  str x14, [x0, w15, uxtw #3]
-  add w15, w15, 1
+  str x14, [x0, x15, lsl #3]
+  add x15, x15, 1
   cmp x15, x1
   b.ne preplatencyarr_loop
   ldp x14, x15, [sp, #0x10]
@@ -97,6 +101,32 @@ longpatternlatencytest_loop_inc:
   ret
 
 
+/* Memory disambiguation test. Each iteration's store address comes out of a mul chain started by the
+   previous iteration's load, while the load's address is ready right away. A load predicted not to
+   alias runs ahead of the store, and has to be flushed and replayed if it actually aliases
+   x0 = iterations
+   x1 = ptr to array of 32-bit load offsets, one per iteration. 0 = same address as the store
+   x2 = test array, store always goes to offset 0
+   x3 = offset array length - 1, length has to be a power of 2 */
+_disambigtest:
+disambigtest:
+  mov x10, xzr
+  mov x11, xzr
+  mov x12, 1
+1:
+  mul x10, x10, x12
+  mul x10, x10, x12
+  mul x10, x10, x12
+  mul x10, x10, x12
+  str x10, [x2, x10]         /* store, address resolves late */
+  ldr w9, [x1, x11, lsl #2]  /* load offset, ready early */
+  ldr x10, [x2, x9]          /* load that may alias the store */
+  add x11, x11, 1
+  and x11, x11, x3
+  subs x0, x0, 1
+  b.gt 1b
+  ret
+
 /* x0 = iteration count
    x1 = ptr to arr. first 32-bit int = store offset, second = load offset */
 _stlftest:
@@ -216,3 +246,56 @@ matchedstlftest_loop:
   ldp x14, x15, [sp, #0x10]
   add sp, sp, #0x40
   ret
+
+/* Memory level parallelism kernels, see MemoryLatency_x86.s. mlptestN keeps N chains in registers,
+   up to 26 in x2-x17 and x19-x28. x18 is left alone since it's the platform register on some OSes
+   x0 = iterations
+   x1 = ptr to array of N start pointers
+   returns the first chain's final pointer */
+.macro mlpkernel n
+_mlptest\n:
+mlptest\n:
+  sub sp, sp, #0x50
+  stp x19, x20, [sp]
+  stp x21, x22, [sp, #0x10]
+  stp x23, x24, [sp, #0x20]
+  stp x25, x26, [sp, #0x30]
+  stp x27, x28, [sp, #0x40]
+  .set mlpidx, 0
+  .irp reg, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15, x16, x17, x19, x20, x21, x22, x23, x24, x25, x26, x27, x28
+  .if mlpidx < \n
+  ldr \reg, [x1, #(8 * mlpidx)]
+  .endif
+  .set mlpidx, mlpidx + 1
+  .endr
+1:
+  .set mlpidx, 0
+  .irp reg, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15, x16, x17, x19, x20, x21, x22, x23, x24, x25, x26, x27, x28
+  .if mlpidx < \n
+  ldr \reg, [\reg]
+  .endif
+  .set mlpidx, mlpidx + 1
+  .endr
+  sub x0, x0, 1
+  cbnz x0, 1b
+  mov x0, x2
+  ldp x19, x20, [sp]
+  ldp x21, x22, [sp, #0x10]
+  ldp x23, x24, [sp, #0x20]
+  ldp x25, x26, [sp, #0x30]
+  ldp x27, x28, [sp, #0x40]
+  add sp, sp, #0x50
+  ret
+.endm
+
+.irp n, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26
+mlpkernel \n
+.endr
+
+.data
+.balign 8
+_mlptestfuncs:
+mlptestfuncs:
+  .quad mlptest1, mlptest2, mlptest3, mlptest4, mlptest5, mlptest6, mlptest7, mlptest8, mlptest9
+  .quad mlptest10, mlptest11, mlptest12, mlptest13, mlptest14, mlptest15, mlptest16, mlptest17, mlptest18
+  .quad mlptest19, mlptest20, mlptest21, mlptest22, mlptest23, mlptest24, mlptest25, mlptest26
@@ -2,6 +2,7 @@
 
 .global latencytest
 .global preplatencyarr
+.global mlptestfuncs
 .global stlftest
 .global stlftest32
 .global stlftest128
@@ -132,3 +133,68 @@ matchedstlftest_loop:
   addi t3, t3, 5
   blt t3, a0, matchedstlftest_loop
   ret
+
+/* Memory level parallelism kernels, see MemoryLatency_x86.s. mlptestN keeps N chains in registers,
+   up to 25 in t0-t6, a2-a7 and s0-s11
+   a0 = iterations
+   a1 = ptr to array of N start pointers
+   returns the first chain's final pointer */
+.macro mlpkernel n
+mlptest\n:
+  addi sp, sp, -96
+  sd s0, 0(sp)
+  sd s1, 8(sp)
+  sd s2, 16(sp)
+  sd s3, 24(sp)
+  sd s4, 32(sp)
+  sd s5, 40(sp)
+  sd s6, 48(sp)
+  sd s7, 56(sp)
+  sd s8, 64(sp)
+  sd s9, 72(sp)
+  sd s10, 80(sp)
+  sd s11, 88(sp)
+  .set mlpidx, 0
+  .irp reg, t0, t1, t2, t3, t4, t5, t6, a2, a3, a4, a5, a6, a7, s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11
+  .if mlpidx < \n
+  ld \reg, (8 * mlpidx)(a1)
+  .endif
+  .set mlpidx, mlpidx + 1
+  .endr
+1:
+  .set mlpidx, 0
+  .irp reg, t0, t1, t2, t3, t4, t5, t6, a2, a3, a4, a5, a6, a7, s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11
+  .if mlpidx < \n
+  ld \reg, (\reg)
+  .endif
+  .set mlpidx, mlpidx + 1
+  .endr
+  addi a0, a0, -1
+  bnez a0, 1b
+  mv a0, t0
+  ld s0, 0(sp)
+  ld s1, 8(sp)
+  ld s2, 16(sp)
+  ld s3, 24(sp)
+  ld s4, 32(sp)
+  ld s5, 40(sp)
+  ld s6, 48(sp)
+  ld s7, 56(sp)
+  ld s8, 64(sp)
+  ld s9, 72(sp)
+  ld s10, 80(sp)
+  ld s11, 88(sp)
+  addi sp, sp, 96
+  ret
+.endm
+
+.irp n, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25
+mlpkernel \n
+.endr
+
+.data
+.balign 8
+mlptestfuncs:
+  .dword mlptest1, mlptest2, mlptest3, mlptest4, mlptest5, mlptest6, mlptest7, mlptest8, mlptest9
+  .dword mlptest10, mlptest11, mlptest12, mlptest13, mlptest14, mlptest15, mlptest16, mlptest17, mlptest18
+  .dword mlptest19, mlptest20, mlptest21, mlptest22, mlptest23, mlptest24, mlptest25
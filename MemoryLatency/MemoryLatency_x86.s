@@ -3,10 +3,14 @@
 .global latencytest
 .global longpatternlatencytest
 .global preplatencyarr
+.global mlptestfuncs
 .global stlftest
 .global stlftest32
 .global stlftest128
 .global matchedstlftest
+.global stlfmatrixfuncs
+.global clktest
+.global disambigtest
 
 /* ms_abi specified in source file, so
    rcx = ptr to arr
@@ -183,3 +187,200 @@ matchedstlftest_loop:
   pop %rdi
   pop %rsi
   ret
+
+/* Memory level parallelism kernels. mlptestN keeps N independent pointer chasing chains in registers,
+   so nothing but the chained loads touches memory in the loop. Up to 14 chains, since that's
+   every GPR other than rsp and the iteration counter
+   rcx = iterations
+   rdx = ptr to array of N start pointers. rdx is reused as the last chain
+   returns the first chain's final pointer */
+.macro mlpkernel n
+mlptest\n:
+  push %rbx
+  push %rbp
+  push %rsi
+  push %rdi
+  push %r12
+  push %r13
+  push %r14
+  push %r15
+  .set mlpidx, 0
+  .irp reg, r8, r9, r10, r11, rax, rbx, rbp, rsi, rdi, r12, r13, r14, r15, rdx
+  .if mlpidx < \n
+  mov (8 * mlpidx)(%rdx), %\reg
+  .endif
+  .set mlpidx, mlpidx + 1
+  .endr
+1:
+  .set mlpidx, 0
+  .irp reg, r8, r9, r10, r11, rax, rbx, rbp, rsi, rdi, r12, r13, r14, r15, rdx
+  .if mlpidx < \n
+  mov (%\reg), %\reg
+  .endif
+  .set mlpidx, mlpidx + 1
+  .endr
+  dec %rcx
+  jnz 1b
+  mov %r8, %rax
+  pop %r15
+  pop %r14
+  pop %r13
+  pop %r12
+  pop %rdi
+  pop %rsi
+  pop %rbp
+  pop %rbx
+  ret
+.endm
+
+.irp n, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14
+mlpkernel \n
+.endr
+
+
+/* Store to load forwarding matrix kernels. stlf_S_L does an S byte store, then an L byte load
+   whose result feeds the next store's data. 16B ops use VEX encoding in kernels that touch ymm/zmm
+   to avoid SSE/AVX transition penalties. When the store and load are in different register files,
+   a movq carries the dependency across, adding a fixed few cycles to every cell
+   rcx = iterations
+   rdx = ptr to array. first two 32-bit ints in array are store and load offsets respectively */
+.macro stlfstore st, vex
+.if \st == 1
+  mov %al, (%rsi)
+.elseif \st == 2
+  mov %ax, (%rsi)
+.elseif \st == 4
+  mov %eax, (%rsi)
+.elseif \st == 8
+  mov %rax, (%rsi)
+.elseif \st == 16
+.if \vex
+  vmovups %xmm0, (%rsi)
+.else
+  movups %xmm0, (%rsi)
+.endif
+.elseif \st == 32
+  vmovups %ymm0, (%rsi)
+.else
+  vmovups %zmm0, (%rsi)
+.endif
+.endm
+
+.macro stlfload ld, vex
+.if \ld == 1
+  movzbl (%rdi), %eax
+.elseif \ld == 2
+  movzwl (%rdi), %eax
+.elseif \ld == 4
+  mov (%rdi), %eax
+.elseif \ld == 8
+  mov (%rdi), %rax
+.elseif \ld == 16
+.if \vex
+  vmovups (%rdi), %xmm0
+.else
+  movups (%rdi), %xmm0
+.endif
+.elseif \ld == 32
+  vmovups (%rdi), %ymm0
+.else
+  vmovups (%rdi), %zmm0
+.endif
+.endm
+
+.macro stlfkernel st, ld
+stlf_\st\()_\ld:
+  push %rsi
+  push %rdi
+  mov (%rdx), %esi
+  mov 4(%rdx), %edi
+  add %rdx, %rsi     /* rsi = store ptr */
+  add %rdx, %rdi     /* rdi = load ptr */
+  xor %eax, %eax
+  .set stlfvex, (\st >= 32) || (\ld >= 32)
+1:
+  .rept 5
+  stlfstore \st, stlfvex
+  stlfload \ld, stlfvex
+  .if (\st <= 8) && (\ld >= 16)
+  .if stlfvex
+  vmovq %xmm0, %rax
+  .else
+  movq %xmm0, %rax
+  .endif
+  .elseif (\st >= 16) && (\ld <= 8)
+  .if stlfvex
+  vmovq %rax, %xmm0
+  .else
+  movq %rax, %xmm0
+  .endif
+  .endif
+  .endr
+  sub $5, %rcx
+  jg 1b
+  .if stlfvex
+  vzeroupper
+  .endif
+  pop %rdi
+  pop %rsi
+  ret
+.endm
+
+.irp st, 1, 2, 4, 8, 16, 32, 64
+.irp ld, 1, 2, 4, 8, 16, 32, 64
+stlfkernel \st, \ld
+.endr
+.endr
+
+/* Memory disambiguation test. Each iteration's store address comes out of a 12 clock imul chain started
+   by the previous iteration's load, while the load's address is ready right away. A load predicted not to
+   alias runs ahead of the store. If it actually aliases, the core has to flush and replay.
+   Loads predicted to alias wait for the store address, serializing iterations
+   rcx = iterations
+   rdx = ptr to array of 32-bit load offsets, one per iteration. 0 = same address as the store
+   r8 = test array, store always goes to offset 0
+   r9 = offset array length - 1, length has to be a power of 2 */
+disambigtest:
+  push %rsi
+  xor %r10, %r10
+  xor %r11, %r11
+1:
+  imul $1, %r10, %r10
+  imul $1, %r10, %r10
+  imul $1, %r10, %r10
+  imul $1, %r10, %r10
+  mov %r10, (%r8,%r10)     /* store, address resolves late */
+  mov (%rdx,%r11,4), %esi  /* load offset, ready early */
+  mov (%r8,%rsi), %r10     /* load that may alias the store */
+  inc %r11
+  and %r9, %r11
+  dec %rcx
+  jnz 1b
+  pop %rsi
+  ret
+
+/* one add per clock dependency chain, to convert ns to core clocks
+   rcx = iterations */
+clktest:
+  mov $1, %r8
+  mov $20, %r9
+  xor %rax, %rax
+1:
+  .rept 20
+  add %r8, %rax
+  .endr
+  sub %r9, %rcx
+  jg 1b
+  ret
+
+.data
+.balign 8
+mlptestfuncs:
+  .quad mlptest1, mlptest2, mlptest3, mlptest4, mlptest5, mlptest6, mlptest7
+  .quad mlptest8, mlptest9, mlptest10, mlptest11, mlptest12, mlptest13, mlptest14
+
+.balign 8
+stlfmatrixfuncs:
+  .irp st, 1, 2, 4, 8, 16, 32, 64
+  .quad stlf_\st\()_1, stlf_\st\()_2, stlf_\st\()_4, stlf_\st\()_8, stlf_\st\()_16, stlf_\st\()_32, stlf_\st\()_64
+  .endr
@@ -15,6 +15,7 @@
 #define SMALLKITTEN
 #endif
 #define gettid() ((pid_t)syscall(SYS_gettid))
+#include "../Common/threadpool.h"
 #else 
 #include <Windows.h>
 #define SMALLKITTEN
@@ -32,11 +33,20 @@ struct TestThreadData {
 };
 
 float measureFunction(uint64_t baseIterations, uint64_t (*testFunc)(uint64_t, void *) SMALLKITTEN, void *data);
-void *TestThread(void *param);
+float runThreads(struct TestThreadData *testData);
 
 int threadCount = 1;
 int *coreList = NULL;
 
+#ifndef _MSC_VER
+void TestThread(void *param);
+
+// pinned workers, created once so retries don't pay for thread creation
+struct thread_pool *testPool = NULL;
+#else
+DWORD WINAPI TestThread(LPVOID param);
+#endif
+
 #ifdef __aarch64__
 #include "arm_mt_instructionrate.c"
 #endif 
@@ -57,6 +67,7 @@ int *coreList = NULL;
 int main(int argc, char *argv[]) {
    char parseBuffer[512];
    int parseIndices[64];
+   int timingBackend = TIMING_AUTO;
 
    for (int argIdx = 1; argIdx < argc; argIdx++) {
       if (*(argv[argIdx]) == '-') {
@@ -91,12 +102,25 @@ int main(int argc, char *argv[]) {
           }
 
           fprintf(stderr, "\n");
+	} else if (strncmp(arg, "timer", 5) == 0) {
+	  argIdx++;
+	  timingBackend = timing_parse_backend(argv[argIdx]);
 	}
       }
    }
 
+   timing_init(timingBackend);
+#ifndef _MSC_VER
+   int *poolCores = (int *)malloc(sizeof(int) * threadCount);
+   for (int i = 0; i < threadCount; i++) poolCores[i] = coreList ? coreList[i] : i;
+   testPool = pool_create(threadCount, poolCores, 1);
+   free(poolCores);
+#endif
    RunTests();
 
+#ifndef _MSC_VER
+   pool_destroy(testPool);
+#endif
    free(coreList);
    return 0;
 }
@@ -105,7 +129,7 @@ int main(int argc, char *argv[]) {
 // test function must perform iterations ops
 float measureFunction(uint64_t baseIterations, uint64_t (*testFunc)(uint64_t, void *) SMALLKITTEN, void *data){
   int toleranceMet = 0, minTimeMet = 0;
-  unsigned int timeMs;
+  float timeMs;
   
   struct TestThreadData *testData = (struct TestThreadData *)malloc(threadCount * sizeof(struct TestThreadData));
   for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
@@ -116,43 +140,21 @@ float measureFunction(uint64_t baseIterations, uint64_t (*testFunc)(uint64_t, vo
     else testData[threadIdx].core = coreList[threadIdx];
   }
 
-#ifndef _MSC_VER
-  pthread_t* testThreads = (pthread_t*)malloc(threadCount * sizeof(pthread_t));
-#else
-  HANDLE* testThreads = (HANDLE*)malloc(threadCount * sizeof(HANDLE));
-#endif
-
   do {
-    start_timing();
-    for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
-#ifndef _MSC_VER
-      pthread_create(testThreads + threadIdx, NULL, TestThread, testData + threadIdx);
-#else
-      testThreads[threadIdx] = CreateThread(NULL, 0, TestThread, testData + threadIdx, CREATE_SUSPENDED, NULL, NULL);
-      SetThreadAffinityMask(testThreads[threadIdx], 1UL << testData[threadIdx].core);
-      ResumeThread(testThreads[threadIdx]);
-#endif
-    }
-
+    timeMs = runThreads(testData);
     float maxThreadTime = -1, minThreadTime = -1;
     for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
-#ifndef _MSC_VER
-      pthread_join(testThreads[threadIdx], NULL);
-#else
-      WaitForMultipleObjects((DWORD)threadCount, testThreads, TRUE, INFINITE);
-#endif
       fprintf(stderr, "Thread %d took %f ms\n", threadIdx, testData[threadIdx].timeMs);
       if (maxThreadTime < 0 || testData[threadIdx].timeMs > maxThreadTime) maxThreadTime = testData[threadIdx].timeMs;
       if (minThreadTime < 0 || testData[threadIdx].timeMs < minThreadTime) minThreadTime = testData[threadIdx].timeMs;
     }
 
-    timeMs = end_timing();
     minTimeMet = timeMs > 2000; // see if 2 seconds will work
     toleranceMet = ((maxThreadTime - minThreadTime) / minThreadTime) < 0.2f; // allow 10% variation?
 
     if (!minTimeMet) {
       // Increase iteration count with 3s target
-      baseIterations = scale_iterations_to_target(baseIterations, (float)timeMs, 3000.0f); 
+      baseIterations = scale_iterations_to_target(baseIterations, timeMs, 3000.0f); 
       for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
         testData[threadIdx].iterations = baseIterations;
       }
@@ -169,7 +171,7 @@ float measureFunction(uint64_t baseIterations, uint64_t (*testFunc)(uint64_t, vo
     }
   } while ((!toleranceMet) || (!minTimeMet));
 
-  fprintf(stderr, "time elapsed: %d ms\n", timeMs);
+  fprintf(stderr, "time elapsed: %f ms\n", timeMs);
 
   uint64_t totalIterations = 0;
   for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
@@ -177,29 +179,50 @@ float measureFunction(uint64_t baseIterations, uint64_t (*testFunc)(uint64_t, vo
   }
 
   free(testData);
-  free(testThreads);
 
   return (1000 * totalIterations / timeMs) / 1e9;
 }
 
-void *TestThread(void *param) {
-  struct TestThreadData *testData = (struct TestThreadData *)param;
-
 #ifndef _MSC_VER
-  if (testData->core >= 0) {
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(testData->core, &cpuset);
-    sched_setaffinity(gettid(), sizeof(cpu_set_t), &cpuset);
+// run every thread once and fill in per-thread times. returns ms from the first thread starting to the last one finishing
+float runThreads(struct TestThreadData *testData) {
+  pool_run(testPool, threadCount, NULL, TestThread, testData, sizeof(struct TestThreadData));
+  for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
+    testData[threadIdx].timeMs = pool_worker_time_ns(testPool, threadIdx) / 1e6f;
   }
-  
-  struct timeval start1;
-#else
-  struct timeb start1;
-#endif
-  start_timing_ts(&start1);
+
+  return pool_span_ns(testPool) / 1e6f;
+}
+
+// affinity is set when the pool is created, and the pool takes timestamps
+void TestThread(void *param) {
+  struct TestThreadData *testData = (struct TestThreadData *)param;
   testData->testfunc(testData->iterations, testData->testData);
-  testData->timeMs = end_timing_ts(&start1);
+}
+#else
+float runThreads(struct TestThreadData *testData) {
+  uint64_t startTicks;
+  HANDLE* testThreads = (HANDLE*)malloc(threadCount * sizeof(HANDLE));
+  start_timing_ns(&startTicks);
+  for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
+    testThreads[threadIdx] = CreateThread(NULL, 0, TestThread, testData + threadIdx, CREATE_SUSPENDED, NULL);
+    SetThreadAffinityMask(testThreads[threadIdx], 1ULL << testData[threadIdx].core);
+    ResumeThread(testThreads[threadIdx]);
+  }
 
-  return NULL;
+  WaitForMultipleObjects((DWORD)threadCount, testThreads, TRUE, INFINITE);
+  float timeMs = end_timing_ns(&startTicks) / 1e6f;
+  for (int threadIdx = 0; threadIdx < threadCount; threadIdx++) CloseHandle(testThreads[threadIdx]);
+  free(testThreads);
+  return timeMs;
 }
+
+DWORD WINAPI TestThread(LPVOID param) {
+  struct TestThreadData *testData = (struct TestThreadData *)param;
+  uint64_t startTicks;
+  start_timing_ns(&startTicks);
+  testData->testfunc(testData->iterations, testData->testData);
+  testData->timeMs = end_timing_ns(&startTicks) / 1e6f;
+  return 0;
+}
+#endif